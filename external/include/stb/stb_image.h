@@ -1,6 +1,10 @@
 /* stb_image - v2.21 - public domain image loader - http://nothings.org/stb
                                   no warranty implied; use at your own risk
 
+   LOCAL MODIFICATION (pixmap-ops): this copy adds stbi_load_jpeg_scaled(),
+   which decodes JPEGs at 1/2, 1/4 or 1/8 size by running a reduced IDCT
+   (stbi__idct_scaled) on each block. Every changed line is marked "agl:".
+
    Do this:
       #define STB_IMAGE_IMPLEMENTATION
    before you include this file in *one* C or C++ file to create the implementation.
@@ -373,6 +377,11 @@ STBIDEF stbi_uc *stbi_load_from_callbacks(stbi_io_callbacks const *clbk  , void
 STBIDEF stbi_uc *stbi_load            (char const *filename, int *x, int *y, int *channels_in_file, int desired_channels);
 STBIDEF stbi_uc *stbi_load_from_file  (FILE *f, int *x, int *y, int *channels_in_file, int desired_channels);
 // for stbi_load_from_file, file pointer is left pointing immediately after image
+
+// agl: like stbi_load, but JPEGs are decoded at 1/2^scale_shift of their size
+// (scale_shift 0..3) by running a reduced IDCT on the low frequency
+// coefficients of each block. Other formats load at full size.
+STBIDEF stbi_uc *stbi_load_jpeg_scaled(char const *filename, int *x, int *y, int *channels_in_file, int desired_channels, int scale_shift);
 #endif
 
 #ifndef STBI_NO_GIF
@@ -731,6 +740,8 @@ typedef struct
 
    stbi_uc *img_buffer, *img_buffer_end;
    stbi_uc *img_buffer_original, *img_buffer_original_end;
+
+   int jpeg_scale_shift; // agl: see stbi_load_jpeg_scaled
 } stbi__context;
 
 
@@ -741,6 +752,7 @@ static void stbi__start_mem(stbi__context *s, stbi_uc const *buffer, int len)
 {
    s->io.read = NULL;
    s->read_from_callbacks = 0;
+   s->jpeg_scale_shift = 0; // agl
    s->img_buffer = s->img_buffer_original = (stbi_uc *) buffer;
    s->img_buffer_end = s->img_buffer_original_end = (stbi_uc *) buffer+len;
 }
@@ -752,6 +764,7 @@ static void stbi__start_callbacks(stbi__context *s, stbi_io_callbacks *c, void *
    s->io_user_data = user;
    s->buflen = sizeof(s->buffer_start);
    s->read_from_callbacks = 1;
+   s->jpeg_scale_shift = 0; // agl
    s->img_buffer_original = s->buffer_start;
    stbi__refill_buffer(s);
    s->img_buffer_original_end = s->img_buffer_end;
@@ -1225,6 +1238,20 @@ STBIDEF stbi_uc *stbi_load(char const *filename, int *x, int *y, int *comp, int
    return result;
 }
 
+// agl: see the declaration above
+STBIDEF stbi_uc *stbi_load_jpeg_scaled(char const *filename, int *x, int *y, int *comp, int req_comp, int scale_shift)
+{
+   FILE *f = stbi__fopen(filename, "rb");
+   unsigned char *result;
+   stbi__context s;
+   if (!f) return stbi__errpuc("can't fopen", "Unable to open file");
+   stbi__start_file(&s,f);
+   s.jpeg_scale_shift = scale_shift < 0 ? 0 : scale_shift > 3 ? 3 : scale_shift;
+   result = stbi__load_and_postprocess_8bit(&s,x,y,comp,req_comp);
+   fclose(f);
+   return result;
+}
+
 STBIDEF stbi_uc *stbi_load_from_file(FILE *f, int *x, int *y, int *comp, int req_comp)
 {
    unsigned char *result;
@@ -1808,6 +1835,8 @@ typedef struct
    int scan_n, order[4];
    int restart_interval, todo;
 
+   int scale_shift; // agl: blocks decode to (8 >> scale_shift) pixels square
+
 // kernels
    void (*idct_block_kernel)(stbi_uc *out, int out_stride, short data[64]);
    void (*YCbCr_to_RGB_kernel)(stbi_uc *out, const stbi_uc *y, const stbi_uc *pcb, const stbi_uc *pcr, int count, int step);
@@ -2746,6 +2775,54 @@ static void stbi__jpeg_reset(stbi__jpeg *j)
    // since we don't even allow 1<<30 pixels
 }
 
+// agl: C(u) * cos((2x+1) u pi / 2k) for k = 2 and 4, indexed [x][u]
+static const float stbi__idct_scaled_2[2][2] = {
+   { 0.70710678f,  0.70710678f },
+   { 0.70710678f, -0.70710678f } };
+static const float stbi__idct_scaled_4[4][4] = {
+   { 0.70710678f,  0.92387953f,  0.70710678f,  0.38268343f },
+   { 0.70710678f,  0.38268343f, -0.70710678f, -0.92387953f },
+   { 0.70710678f, -0.38268343f, -0.70710678f,  0.92387953f },
+   { 0.70710678f, -0.92387953f,  0.70710678f, -0.38268343f } };
+
+// agl: k x k IDCT of the low k x k coefficients of a dequantized 8x8 block,
+// which approximates the 8x8 IDCT box filtered down by 8/k
+static void stbi__idct_scaled(stbi_uc *out, int out_stride, short data[64], int k)
+{
+   int x,y,u,v;
+   float t[4][4];
+   const float *table = k == 2 ? &stbi__idct_scaled_2[0][0] : &stbi__idct_scaled_4[0][0];
+   if (k == 1) {
+      out[0] = stbi__clamp((data[0] + 4 + 1024) >> 3);
+      return;
+   }
+   // rows of coefficients (vertical frequency v) to k columns
+   for (v=0; v < k; ++v)
+      for (x=0; x < k; ++x) {
+         float sum = 0;
+         for (u=0; u < k; ++u) sum += table[x*k+u] * data[v*8+u];
+         t[v][x] = sum;
+      }
+   for (y=0; y < k; ++y, out += out_stride)
+      for (x=0; x < k; ++x) {
+         float sum = 0;
+         for (v=0; v < k; ++v) sum += table[y*k+v] * t[v][x];
+         out[x] = stbi__clamp((int) (sum * 0.25f + 128.5f)); // negatives clamp to 0 either way
+      }
+}
+
+// agl: write one decoded block whose top left pixel is (x, y) at full size
+static void stbi__jpeg_idct(stbi__jpeg *z, int n, int x, int y, short data[64])
+{
+   int shift = z->scale_shift;
+   int stride = z->img_comp[n].w2 >> shift;
+   stbi_uc *out = z->img_comp[n].data + stride*(y >> shift) + (x >> shift);
+   if (shift == 0)
+      z->idct_block_kernel(out, stride, data);
+   else
+      stbi__idct_scaled(out, stride, data, 8 >> shift);
+}
+
 static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
 {
    stbi__jpeg_reset(z);
@@ -2764,7 +2841,7 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
             for (i=0; i < w; ++i) {
                int ha = z->img_comp[n].ha;
                if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               stbi__jpeg_idct(z, n, i*8, j*8, data); // agl
                // every data block is an MCU, so countdown the restart interval
                if (--z->todo <= 0) {
                   if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
@@ -2792,7 +2869,7 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                         int y2 = (j*z->img_comp[n].v + y)*8;
                         int ha = z->img_comp[n].ha;
                         if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-                        z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data);
+                        stbi__jpeg_idct(z, n, x2, y2, data); // agl
                      }
                   }
                }
@@ -2889,7 +2966,7 @@ static void stbi__jpeg_finish(stbi__jpeg *z)
             for (i=0; i < w; ++i) {
                short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
                stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               stbi__jpeg_idct(z, n, i*8, j*8, data); // agl
             }
          }
       }
@@ -3094,6 +3171,8 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
 
    if (!stbi__mad3sizes_valid(s->img_x, s->img_y, s->img_n, 0)) return stbi__err("too large", "Image too large to decode");
 
+   z->scale_shift = s->jpeg_scale_shift; // agl
+
    for (i=0; i < s->img_n; ++i) {
       if (z->img_comp[i].h > h_max) h_max = z->img_comp[i].h;
       if (z->img_comp[i].v > v_max) v_max = z->img_comp[i].v;
@@ -3124,7 +3203,7 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
       z->img_comp[i].coeff = 0;
       z->img_comp[i].raw_coeff = 0;
       z->img_comp[i].linebuf = NULL;
-      z->img_comp[i].raw_data = stbi__malloc_mad2(z->img_comp[i].w2, z->img_comp[i].h2, 15);
+      z->img_comp[i].raw_data = stbi__malloc_mad2(z->img_comp[i].w2 >> z->scale_shift, z->img_comp[i].h2 >> z->scale_shift, 15); // agl
       if (z->img_comp[i].raw_data == NULL)
          return stbi__free_jpeg_components(z, i+1, stbi__err("outofmem", "Out of memory"));
       // align blocks for idct using mmx/sse
@@ -3644,6 +3723,19 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
    // load a jpeg image from whichever source, but leave in YCbCr format
    if (!stbi__decode_jpeg_image(z)) { stbi__cleanup_jpeg(z); return NULL; }
 
+   // agl: from here on the planes hold the reduced size image
+   if (z->scale_shift) {
+      int k, shift = z->scale_shift, round = (1 << shift) - 1;
+      z->s->img_x = (z->s->img_x + round) >> shift;
+      z->s->img_y = (z->s->img_y + round) >> shift;
+      for (k=0; k < z->s->img_n; ++k) {
+         z->img_comp[k].x = (z->img_comp[k].x + round) >> shift;
+         z->img_comp[k].y = (z->img_comp[k].y + round) >> shift;
+         z->img_comp[k].w2 >>= shift;
+         z->img_comp[k].h2 >>= shift;
+      }
+   }
+
    // determine actual number of components to generate
    n = req_comp ? req_comp : z->s->img_n >= 3 ? 3 : 1;
 
@@ -0,0 +1,250 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the definitions for the bilateral filter.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#include "bilateral.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <vector>
+#include "histogram.h"
+#include "image.h"
+#include "parallel.h"
+#include "trace.h"
+
+namespace agl {
+
+namespace {
+
+// Empty cells around the occupied part of the grid, enough for the blur
+const int kPad = 2;
+
+// Below this spatial sigma the grid would be larger than the image
+const float kMinGridSigma = 2.0f;
+
+/**
+ * @brief Homogeneous (r, g, b, weight) samples over a (x, y, luma) lattice
+ */
+class BilateralGrid {
+ public:
+  BilateralGrid(int width, int height, float sigmaSpatial, float sigmaRange)
+      : mSpatial(sigmaSpatial), mRange(sigmaRange) {
+    mNx = (int) std::ceil((width - 1) / sigmaSpatial) + 1 + 2 * kPad;
+    mNy = (int) std::ceil((height - 1) / sigmaSpatial) + 1 + 2 * kPad;
+    mNz = (int) std::ceil(255 / sigmaRange) + 1 + 2 * kPad;
+    mCells.assign((long) mNx * mNy * mNz * 4, 0.0f);
+  }
+
+  /**
+   * @brief Accumulate every pixel into its nearest cell
+   *
+   * Work is split by grid row, so each thread owns the cells it writes.
+   */
+  void splat(const ConstImageView& src) {
+    parallelFor(0, mNy, [&](int gyBegin, int gyEnd) {
+      // one extra row on either side guards against rounding at the
+      // boundaries; the check below keeps only this chunk's rows
+      int rowBegin = std::max(0, (int) std::ceil((gyBegin - kPad - 0.5f) * mSpatial) - 1);
+      int rowEnd = std::min(src.height(), (int) std::ceil((gyEnd - kPad - 0.5f) * mSpatial) + 1);
+      for (int row = rowBegin; row < rowEnd; row++) {
+        int gy = nearest(row / mSpatial);
+        if (gy < gyBegin || gy >= gyEnd) continue;
+        const unsigned char* p = src.row(row);
+        for (int col = 0; col < src.width(); col++, p += src.pixelStride()) {
+          int gx = nearest(col / mSpatial);
+          int gz = nearest(luma(p[0], p[1], p[2]) / mRange);
+          float* cell = &mCells[index(gx, gy, gz)];
+          cell[0] += p[0];
+          cell[1] += p[1];
+          cell[2] += p[2];
+          cell[3] += 1;
+        }
+      }
+    });
+  }
+
+  /**
+   * @brief Blur the grid with a [1 4 6 4 1] / 16 kernel along each axis
+   */
+  void blur() {
+    const long sx = mNz * 4, sy = (long) mNx * mNz * 4, sz = 4;
+    // axis x: lines over (y, z)
+    parallelFor(0, mNy, [&](int b, int e) {
+      std::vector<float> line;
+      for (int y = b; y < e; y++)
+        for (int z = 0; z < mNz; z++) blurLine(y * sy + z * sz, sx, mNx, line);
+    });
+    // axis y: lines over (x, z)
+    parallelFor(0, mNx, [&](int b, int e) {
+      std::vector<float> line;
+      for (int x = b; x < e; x++)
+        for (int z = 0; z < mNz; z++) blurLine(x * sx + z * sz, sy, mNy, line);
+    });
+    // axis z: lines over (y, x)
+    parallelFor(0, mNy, [&](int b, int e) {
+      std::vector<float> line;
+      for (int y = b; y < e; y++)
+        for (int x = 0; x < mNx; x++) blurLine(y * sy + x * sx, sz, mNz, line);
+    });
+  }
+
+  /**
+   * @brief Read the grid back at every pixel with trilinear interpolation
+   */
+  void slice(const ConstImageView& src, const ImageView& dst) const {
+    parallelFor(0, src.height(), [&](int rowBegin, int rowEnd) {
+      for (int row = rowBegin; row < rowEnd; row++) {
+        float fy = row / mSpatial + kPad;
+        int y0 = (int) fy;
+        float wy = fy - y0;
+        const unsigned char* p = src.row(row);
+        unsigned char* q = dst.row(row);
+        for (int col = 0; col < src.width(); col++, p += src.pixelStride(), q += dst.pixelStride()) {
+          float fx = col / mSpatial + kPad;
+          float fz = luma(p[0], p[1], p[2]) / mRange + kPad;
+          int x0 = (int) fx, z0 = (int) fz;
+          float wx = fx - x0, wz = fz - z0;
+          float sum[4] = {0, 0, 0, 0};
+          for (int k = 0; k < 8; k++) {
+            int dx = k & 1, dy = (k >> 1) & 1, dz = k >> 2;
+            float weight = (dx ? wx : 1 - wx) * (dy ? wy : 1 - wy) * (dz ? wz : 1 - wz);
+            const float* cell = &mCells[index(x0 + dx, y0 + dy, z0 + dz)];
+            for (int c = 0; c < 4; c++) sum[c] += weight * cell[c];
+          }
+          if (sum[3] > 1e-6f) {
+            for (int c = 0; c < 3; c++) {
+              q[c] = (unsigned char) std::min(255.0f, sum[c] / sum[3] + 0.5f);
+            }
+          } else {
+            q[0] = p[0];
+            q[1] = p[1];
+            q[2] = p[2];
+          }
+        }
+      }
+    }, 8);
+  }
+
+ private:
+  int nearest(float v) const { return (int) (v + 0.5f) + kPad; }
+
+  long index(int x, int y, int z) const {
+    return (((long) y * mNx + x) * mNz + z) * 4;
+  }
+
+  void blurLine(long base, long stride, int n, std::vector<float>& line) {
+    line.assign((n + 4) * 4, 0.0f);
+    for (int i = 0; i < n; i++) {
+      for (int c = 0; c < 4; c++) line[(i + 2) * 4 + c] = mCells[base + i * stride + c];
+    }
+    for (int i = 0; i < n; i++) {
+      const float* l = &line[i * 4];
+      float* out = &mCells[base + i * stride];
+      for (int c = 0; c < 4; c++) {
+        out[c] = (l[c] + 4 * l[4 + c] + 6 * l[8 + c] + 4 * l[12 + c] + l[16 + c]) / 16;
+      }
+    }
+  }
+
+  float mSpatial;
+  float mRange;
+  int mNx, mNy, mNz;
+  std::vector<float> mCells;
+};
+
+/**
+ * @brief Direct bilateral filter for spatial sigmas too small for a grid
+ */
+void directBilateral(const ConstImageView& src, const ImageView& dst,
+                     float sigmaSpatial, float sigmaRange) {
+  int radius = std::max(1, (int) std::ceil(2 * sigmaSpatial));
+  int d = 2 * radius + 1;
+  std::vector<float> spatial(d * d), range(256);
+  for (int y = -radius; y <= radius; y++) {
+    for (int x = -radius; x <= radius; x++) {
+      spatial[(y + radius) * d + x + radius] =
+          std::exp(-(x * x + y * y) / (2 * sigmaSpatial * sigmaSpatial));
+    }
+  }
+  for (int i = 0; i < 256; i++) {
+    range[i] = std::exp(-(i * i) / (2 * sigmaRange * sigmaRange));
+  }
+  const int w = src.width(), h = src.height();
+  // dst may be src, so filter into rows of floats first
+  std::vector<float> out((long) w * h * 3);
+  parallelFor(0, h, [&](int rowBegin, int rowEnd) {
+    for (int row = rowBegin; row < rowEnd; row++) {
+      for (int col = 0; col < w; col++) {
+        const unsigned char* center = src.at(row, col);
+        int l0 = luma(center[0], center[1], center[2]);
+        float sum[3] = {0, 0, 0}, total = 0;
+        for (int y = std::max(0, row - radius); y <= std::min(h - 1, row + radius); y++) {
+          for (int x = std::max(0, col - radius); x <= std::min(w - 1, col + radius); x++) {
+            const unsigned char* p = src.at(y, x);
+            float weight = spatial[(y - row + radius) * d + x - col + radius] *
+                           range[std::abs(luma(p[0], p[1], p[2]) - l0)];
+            sum[0] += weight * p[0];
+            sum[1] += weight * p[1];
+            sum[2] += weight * p[2];
+            total += weight;
+          }
+        }
+        float* o = &out[((long) row * w + col) * 3];
+        for (int c = 0; c < 3; c++) o[c] = sum[c] / total;
+      }
+    }
+  }, 8);
+  for (int row = 0; row < h; row++) {
+    unsigned char* q = dst.row(row);
+    const float* o = &out[(long) row * w * 3];
+    for (int col = 0; col < w; col++, q += dst.pixelStride(), o += 3) {
+      for (int c = 0; c < 3; c++) q[c] = (unsigned char) std::min(255.0f, o[c] + 0.5f);
+    }
+  }
+}
+
+}  // namespace
+
+/**
+ * @brief Edge preserving smoothing of a view
+ * @param src Source RGB view
+ * @param dst Destination RGB view
+ * @param sigmaSpatial Spatial standard deviation in pixels
+ * @param sigmaRange Range standard deviation in luma levels
+ */
+void bilateralFilter(const ConstImageView& src, const ImageView& dst,
+                     float sigmaSpatial, float sigmaRange) {
+  assert(src.width() == dst.width() && src.height() == dst.height());
+  assert(src.channels() == 3 && dst.channels() == 3);
+  if (src.empty()) return;
+  sigmaRange = std::max(1.0f, sigmaRange);
+  if (sigmaSpatial < kMinGridSigma) {
+    directBilateral(src, dst, std::max(0.1f, sigmaSpatial), sigmaRange);
+    return;
+  }
+  BilateralGrid grid(src.width(), src.height(), sigmaSpatial, sigmaRange);
+  grid.splat(src);
+  grid.blur();
+  grid.slice(src, dst);
+}
+
+/**
+ * @brief Smooth the image while keeping edges sharp
+ * @param sigmaSpatial Spatial standard deviation in pixels
+ * @param sigmaRange Range standard deviation in luma levels (0-255)
+ * @return Filtered image
+ */
+Image Image::bilateral(float sigmaSpatial, float sigmaRange) const {
+  AGL_TRACE_SCOPE("Image::bilateral", (long long) mWidth * mHeight);
+  Image result(mWidth, mHeight);
+  bilateralFilter(view(), result.view(), sigmaSpatial, sigmaRange);
+  return result;
+}
+
+}  // namespace agl
@@ -0,0 +1,36 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the declarations for the edge preserving bilateral
+* filter.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#ifndef AGL_BILATERAL_H_
+#define AGL_BILATERAL_H_
+
+#include "image_view.h"
+
+namespace agl {
+
+/**
+ * @brief Edge preserving smoothing with a bilateral grid
+ * @param src Source RGB view
+ * @param dst Destination RGB view of the same size (may be src)
+ * @param sigmaSpatial Spatial standard deviation in pixels
+ * @param sigmaRange Range standard deviation in luma levels (0-255)
+ *
+ * Pixels are splatted into a 3D grid over (x, y, luma) whose cells are
+ * sigmaSpatial pixels wide and sigmaRange levels deep, the grid is blurred
+ * with separable 1D passes along each axis, and the result is read back
+ * with trilinear interpolation at every pixel's position and luma. The
+ * cost is linear in the pixel count plus the grid size, which shrinks as
+ * sigmaSpatial grows.
+ */
+void bilateralFilter(const ConstImageView& src, const ImageView& dst,
+                     float sigmaSpatial, float sigmaRange);
+
+}  // namespace agl
+#endif  // AGL_BILATERAL_H_
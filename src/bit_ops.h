@@ -0,0 +1,59 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains portable bit counting and scanning on 64-bit words,
+* for the bit-packed masks and hashes.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#ifndef AGL_BIT_OPS_H_
+#define AGL_BIT_OPS_H_
+
+#include <cstdint>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#pragma intrinsic(_BitScanForward64)
+#endif
+
+namespace agl {
+
+/**
+ * GCC and Clang get single instructions from their builtins. Other
+ * compilers fall back to plain C++ so every configuration in
+ * CMakeLists.txt builds; there is no MSVC popcount intrinsic here because
+ * __popcnt64 faults on CPUs without POPCNT.
+ */
+
+// Number of set bits
+inline int countBits(uint64_t x) {
+#if defined(__GNUC__)
+  return __builtin_popcountll(x);
+#else
+  x = x - ((x >> 1) & 0x5555555555555555ull);
+  x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+  x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+  return (int) ((x * 0x0101010101010101ull) >> 56);
+#endif
+}
+
+// Index of the lowest set bit (x must not be 0)
+inline int lowestBit(uint64_t x) {
+#if defined(__GNUC__)
+  return __builtin_ctzll(x);
+#elif defined(_MSC_VER) && defined(_M_X64)
+  unsigned long bit;
+  _BitScanForward64(&bit, x);
+  return (int) bit;
+#else
+  int bit = 0;
+  for (; !(x & 1); x >>= 1) bit++;
+  return bit;
+#endif
+}
+
+}  // namespace agl
+
+#endif  // AGL_BIT_OPS_H_
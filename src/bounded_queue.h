@@ -0,0 +1,193 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the bounded multi-producer multi-consumer queue that
+* connects pipeline stages.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#ifndef AGL_BOUNDED_QUEUE_H_
+#define AGL_BOUNDED_QUEUE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace agl {
+
+/**
+ * @brief Fixed capacity lock-free MPMC queue (Vyukov's bounded queue)
+ *
+ * Every cell carries a sequence number that tells producers and consumers
+ * whether it is free for the current lap, so tryPush() and tryPop() only
+ * need one compare-and-swap on the shared position. The blocking push()
+ * and pop() spin on the lock-free path and only fall back to a condition
+ * variable when the queue stays full or empty; that is what gives stages
+ * their backpressure. A sleeping thread makes its last attempt under the
+ * mutex, and a successful tryPush() or tryPop() that sees sleepers
+ * notifies under the same mutex, so no wakeup is lost.
+ *
+ * After close(), push() fails and pop() drains what is left and then fails.
+ */
+template <class T>
+class BoundedQueue {
+ public:
+  // Capacity is rounded up to a power of two
+  explicit BoundedQueue(size_t capacity) : mClosed(false), mWaiters(0) {
+    size_t size = 2;
+    while (size < capacity) size <<= 1;
+    mCells = std::vector<Cell>(size);
+    mMask = size - 1;
+    for (size_t i = 0; i < size; i++) {
+      mCells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    mEnqueue.store(0, std::memory_order_relaxed);
+    mDequeue.store(0, std::memory_order_relaxed);
+  }
+
+  BoundedQueue(const BoundedQueue&) = delete;
+  BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+  size_t capacity() const { return mMask + 1; }
+
+  // Add an item if there is room; value is left untouched on failure
+  bool tryPush(T& value) {
+    if (!pushOnce(value)) return false;
+    wakeWaiters();
+    return true;
+  }
+
+  // Remove the oldest item if there is one
+  bool tryPop(T& value) {
+    if (!popOnce(value)) return false;
+    wakeWaiters();
+    return true;
+  }
+
+  // Add an item, waiting while the queue is full; false (value untouched) if the queue was closed
+  bool push(T& value) {
+    return wait([&]() { return mClosed.load() ? Stop : (pushOnce(value) ? Done : Retry); });
+  }
+
+  // Remove the oldest item, waiting while the queue is empty; false once closed and drained
+  bool pop(T& value) {
+    return wait([&]() {
+      if (popOnce(value)) return Done;
+      if (!mClosed.load()) return Retry;
+      // items pushed before close() are still delivered
+      return popOnce(value) ? Done : Stop;
+    });
+  }
+
+  // Refuse new items and wake every waiting thread (call once producers are done)
+  void close() {
+    mClosed.store(true);
+    std::lock_guard<std::mutex> lock(mMutex);
+    mWake.notify_all();
+  }
+
+ private:
+  enum Outcome { Done, Retry, Stop };
+
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T value;
+
+    Cell() : sequence(0) {}
+    Cell(const Cell&) : sequence(0) {}
+    Cell& operator=(const Cell&) { return *this; }
+  };
+
+  bool pushOnce(T& value) {
+    size_t pos = mEnqueue.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell& cell = mCells[pos & mMask];
+      size_t seq = cell.sequence.load(std::memory_order_acquire);
+      ptrdiff_t diff = (ptrdiff_t) seq - (ptrdiff_t) pos;
+      if (diff == 0) {
+        if (mEnqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          cell.value = std::move(value);
+          cell.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;  // full
+      } else {
+        pos = mEnqueue.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool popOnce(T& value) {
+    size_t pos = mDequeue.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell& cell = mCells[pos & mMask];
+      size_t seq = cell.sequence.load(std::memory_order_acquire);
+      ptrdiff_t diff = (ptrdiff_t) seq - (ptrdiff_t) (pos + 1);
+      if (diff == 0) {
+        if (mDequeue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          value = std::move(cell.value);
+          cell.value = T();
+          cell.sequence.store(pos + mMask + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;  // empty
+      } else {
+        pos = mDequeue.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  template <class Attempt>
+  bool wait(Attempt attempt) {
+    for (int spin = 0; spin < 64; spin++) {
+      Outcome outcome = attempt();
+      if (outcome == Done) wakeWaiters();
+      if (outcome != Retry) return outcome == Done;
+    }
+    // register before the attempts under the lock: a thread whose change
+    // lands after our last attempt then sees us and notifies once we sleep
+    mWaiters.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::unique_lock<std::mutex> lock(mMutex);
+    Outcome outcome;
+    while ((outcome = attempt()) == Retry) {
+      mWake.wait(lock);
+    }
+    mWaiters.fetch_sub(1);
+    if (outcome == Done) mWake.notify_all();
+    return outcome == Done;
+  }
+
+  // Called after a successful push or pop, without the lock held
+  void wakeWaiters() {
+    // orders the change just published before the check for sleepers
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (mWaiters.load() > 0) {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mWake.notify_all();
+    }
+  }
+
+  std::vector<Cell> mCells;
+  size_t mMask;
+  // producers and consumers update different cache lines
+  char mPad0[64];
+  std::atomic<size_t> mEnqueue;
+  char mPad1[64];
+  std::atomic<size_t> mDequeue;
+  char mPad2[64];
+  std::atomic<bool> mClosed;
+  std::atomic<int> mWaiters;
+  std::mutex mMutex;
+  std::condition_variable mWake;
+};
+
+}  // namespace agl
+#endif  // AGL_BOUNDED_QUEUE_H_
@@ -0,0 +1,388 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the definitions for connected component labeling
+* and scanline flood fill.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#include "components.h"
+
+#include <algorithm>
+#include "bit_ops.h"
+#include "noise.h"
+#include "parallel.h"
+#include "trace.h"
+
+namespace agl {
+
+namespace {
+
+const int kMinBandRows = 32;  // fewer rows per band cost more in joins than they save
+
+/**
+ * @brief Columns [start, end) of one row that are all set
+ */
+struct Run {
+  int row;
+  int start;
+  int end;
+};
+
+/**
+ * @brief Runs of a band of rows and their union-find forest
+ */
+struct Band {
+  int firstRow;
+  int endRow;
+  std::vector<Run> runs;
+  std::vector<int> rowStart;  // first run of each row, plus one past the last run
+  std::vector<int> parent;
+};
+
+/**
+ * @brief Root of a run, halving the path on the way
+ */
+inline int findRoot(std::vector<int>& parent, int i) {
+  while (parent[i] != i) {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
+  }
+  return i;
+}
+
+/**
+ * @brief Join the trees of two runs under the smaller root
+ *
+ * Every run's parent therefore comes before it in scan order, and each
+ * root is the first run of its tree.
+ */
+inline void joinRuns(std::vector<int>& parent, int a, int b) {
+  a = findRoot(parent, a);
+  b = findRoot(parent, b);
+  if (a < b) {
+    parent[b] = a;
+  } else if (b < a) {
+    parent[a] = b;
+  }
+}
+
+/**
+ * @brief Join the runs [begin, end) to the touching runs [prevBegin, prevEnd) of the row above
+ * @param slack 1 to join diagonal neighbours, 0 otherwise
+ * @param aboveOffset Added to the indices of above to index parent
+ * @param belowOffset Added to the indices of below to index parent
+ */
+void joinRows(const std::vector<Run>& above, int prevBegin, int prevEnd,
+              const std::vector<Run>& below, int begin, int end, int slack,
+              std::vector<int>& parent, int aboveOffset, int belowOffset) {
+  int j = prevBegin;
+  for (int i = begin; i < end; i++) {
+    const Run& run = below[i];
+    while (j < prevEnd && above[j].end + slack <= run.start) j++;
+    for (int k = j; k < prevEnd && above[k].start < run.end + slack; k++) {
+      joinRuns(parent, belowOffset + i, aboveOffset + k);
+    }
+  }
+}
+
+/**
+ * @brief Append the runs of set bits in one mask row
+ */
+void findRuns(const uint64_t* bits, int words, int width, int row, std::vector<Run>& runs) {
+  int start = -1;
+  for (int j = 0; j < words; j++) {
+    uint64_t word = bits[j];
+    int pos = 0;
+    while (pos < 64) {
+      if (start < 0) {
+        uint64_t rest = word >> pos;
+        if (!rest) break;
+        pos += lowestBit(rest);
+        start = j * 64 + pos;
+      }
+      uint64_t clear = ~word >> pos;
+      if (!clear) break;  // the run continues into the next word
+      pos += lowestBit(clear);
+      runs.push_back(Run{row, start, j * 64 + pos});
+      start = -1;
+    }
+  }
+  if (start >= 0) runs.push_back(Run{row, start, width});
+}
+
+}  // namespace
+
+Components::Components() : mWidth(0), mHeight(0) {}
+
+/**
+ * @brief Label the connected components of a mask
+ * @param mask Pixels to label; clear pixels are background
+ * @param connectivity Whether diagonal neighbours connect
+ */
+Components::Components(const BitMask& mask, Connectivity connectivity)
+    : mWidth(mask.width()), mHeight(mask.height()) {
+  AGL_TRACE_SCOPE("Components", (long long) mWidth * mHeight);
+  mLabels.assign((size_t) mWidth * mHeight, 0);
+  if (mWidth <= 0 || mHeight <= 0) return;
+  int slack = connectivity == Connectivity::Eight ? 1 : 0;
+
+  // pass 1: runs and their forests, one band at a time
+  int bandRows = std::max(kMinBandRows, (mHeight + 4 * ThreadPool::global().size() - 1) /
+                                            (4 * ThreadPool::global().size()));
+  int bandCount = (mHeight + bandRows - 1) / bandRows;
+  std::vector<Band> bands(bandCount);
+  parallelFor(0, bandCount, [&](int begin, int end) {
+    for (int b = begin; b < end; b++) {
+      Band& band = bands[b];
+      band.firstRow = b * bandRows;
+      band.endRow = std::min(mHeight, band.firstRow + bandRows);
+      for (int row = band.firstRow; row < band.endRow; row++) {
+        int first = (int) band.runs.size();
+        band.rowStart.push_back(first);
+        findRuns(mask.row(row), mask.wordsPerRow(), mWidth, row, band.runs);
+        int last = (int) band.runs.size();
+        for (int i = first; i < last; i++) band.parent.push_back(i);
+        if (row > band.firstRow) {
+          joinRows(band.runs, band.rowStart[row - band.firstRow - 1], first,
+                   band.runs, first, last, slack, band.parent, 0, 0);
+        }
+      }
+      band.rowStart.push_back((int) band.runs.size());
+    }
+  });
+
+  // join the forests across band boundaries
+  std::vector<int> offset(bandCount + 1, 0);
+  for (int b = 0; b < bandCount; b++) offset[b + 1] = offset[b] + (int) bands[b].runs.size();
+  std::vector<int> parent(offset[bandCount]);
+  for (int b = 0; b < bandCount; b++) {
+    for (size_t i = 0; i < bands[b].parent.size(); i++) {
+      parent[offset[b] + i] = offset[b] + bands[b].parent[i];
+    }
+    std::vector<int>().swap(bands[b].parent);
+  }
+  for (int b = 1; b < bandCount; b++) {
+    const Band& above = bands[b - 1];
+    const Band& below = bands[b];
+    int rows = above.endRow - above.firstRow;
+    joinRows(above.runs, above.rowStart[rows - 1], above.rowStart[rows],
+             below.runs, below.rowStart[0], below.rowStart[1], slack,
+             parent, offset[b - 1], offset[b]);
+  }
+
+  // number the roots in scan order; a run's parent always comes before it
+  std::vector<int32_t> runLabel(parent.size());
+  std::vector<double> sumX, sumY;
+  for (int b = 0; b < bandCount; b++) {
+    for (size_t i = 0; i < bands[b].runs.size(); i++) {
+      const Run& run = bands[b].runs[i];
+      int index = offset[b] + (int) i;
+      int p = parent[index];
+      if (p == index) {
+        mComponents.push_back(Component());
+        sumX.push_back(0);
+        sumY.push_back(0);
+        runLabel[index] = (int32_t) mComponents.size();
+      } else {
+        runLabel[index] = runLabel[p];
+      }
+      int label = runLabel[index];
+      Component& c = mComponents[label - 1];
+      int length = run.end - run.start;
+      c.area += length;
+      c.bounds = unite(c.bounds, Rect{run.start, run.row, length, 1});
+      sumX[label - 1] += 0.5 * (run.start + run.end - 1) * length;
+      sumY[label - 1] += (double) run.row * length;
+    }
+  }
+  for (size_t i = 0; i < mComponents.size(); i++) {
+    mComponents[i].centroidX = sumX[i] / mComponents[i].area;
+    mComponents[i].centroidY = sumY[i] / mComponents[i].area;
+  }
+
+  // pass 2: write the label map
+  parallelFor(0, bandCount, [&](int begin, int end) {
+    for (int b = begin; b < end; b++) {
+      for (size_t i = 0; i < bands[b].runs.size(); i++) {
+        const Run& run = bands[b].runs[i];
+        int32_t* labels = &mLabels[(size_t) run.row * mWidth];
+        std::fill(labels + run.start, labels + run.end, runLabel[offset[b] + i]);
+      }
+    }
+  });
+}
+
+/**
+ * @brief Get the label of a pixel
+ * @param row The row
+ * @param col The column
+ * @return Component label, or 0 for background and pixels outside the mask
+ */
+int Components::label(int row, int col) const {
+  if (row < 0 || row >= mHeight || col < 0 || col >= mWidth) return 0;
+  return mLabels[(size_t) row * mWidth + col];
+}
+
+/**
+ * @brief Find the component with the largest area
+ * @return Its label (the first one on ties), or 0 if there are no components
+ */
+int Components::largest() const {
+  int best = 0;
+  for (int i = 0; i < count(); i++) {
+    if (!best || mComponents[i].area > mComponents[best - 1].area) best = i + 1;
+  }
+  return best;
+}
+
+/**
+ * @brief Get the pixels of one component
+ * @param label Component label (1 to count())
+ * @return Mask the size of the labeled mask; only the component's bounding box is scanned
+ */
+BitMask Components::mask(int label) const {
+  BitMask result(mWidth, mHeight);
+  if (label < 1 || label > count()) return result;
+  const Rect& box = mComponents[label - 1].bounds;
+  parallelFor(box.y, box.y + box.height, [&](int rowBegin, int rowEnd) {
+    for (int r = rowBegin; r < rowEnd; r++) {
+      const int32_t* labels = row(r);
+      uint64_t* bits = result.row(r);
+      for (int col = box.x; col < box.x + box.width; col++) {
+        if (labels[col] == label) bits[col >> 6] |= uint64_t(1) << (col & 63);
+      }
+    }
+  }, 16);
+  return result;
+}
+
+/**
+ * @brief Draw the labels in false color
+ * @return Image with background black and each component a color made from its label
+ */
+Image Components::toImage() const {
+  Image result(mWidth, mHeight);
+  ImageView out = result.view();
+  parallelFor(0, mHeight, [&](int rowBegin, int rowEnd) {
+    for (int r = rowBegin; r < rowEnd; r++) {
+      const int32_t* labels = row(r);
+      unsigned char* p = out.row(r);
+      for (int col = 0; col < mWidth; col++, p += 3) {
+        uint64_t color = labels[col] ? CounterRng::mix((uint64_t) labels[col]) | 0x404040 : 0;
+        p[0] = (unsigned char) (color >> 16);
+        p[1] = (unsigned char) (color >> 8);
+        p[2] = (unsigned char) color;
+      }
+    }
+  }, 16);
+  return result;
+}
+
+/**
+ * @brief Find the pixels connected to a seed whose color is close to the seed's
+ * @param view RGB view to search
+ * @param row Row of the seed
+ * @param col Column of the seed
+ * @param tolerance Largest color distance from the seed color, as in colorReplace()
+ * @param connectivity Neighbours that connect
+ * @return Mask of the region (nothing set if the seed is outside the view)
+ *
+ * Scanline fill: each seed taken off the stack is extended left and right
+ * into a span, and the rows above and below the span push one seed per
+ * run of matching pixels. Only the region and its border are visited.
+ */
+BitMask floodMask(const ConstImageView& view, int row, int col, int tolerance,
+                  Connectivity connectivity) {
+  AGL_TRACE_SCOPE("floodMask", 0);
+  int w = view.width(), h = view.height();
+  BitMask mask(w, h);
+  if (row < 0 || row >= h || col < 0 || col >= w) return mask;
+
+  // floor(sqrt(d2)) <= tolerance  <=>  d2 < (tolerance + 1)^2
+  long limit = tolerance < 0 ? 0 : (long) (tolerance + 1) * (tolerance + 1);
+  const unsigned char* seed = view.at(row, col);
+  const int color[3] = {seed[0], seed[1], seed[2]};
+  auto open = [&](int r, int c) {
+    if ((mask.row(r)[c >> 6] >> (c & 63)) & 1) return false;
+    const unsigned char* p = view.at(r, c);
+    int dr = p[0] - color[0], dg = p[1] - color[1], db = p[2] - color[2];
+    return dr * dr + dg * dg + db * db < limit;
+  };
+  int slack = connectivity == Connectivity::Eight ? 1 : 0;
+
+  std::vector<std::pair<int, int>> stack;
+  if (open(row, col)) stack.push_back(std::make_pair(row, col));
+  while (!stack.empty()) {
+    int r = stack.back().first, c = stack.back().second;
+    stack.pop_back();
+    if (!open(r, c)) continue;
+    int left = c, right = c;
+    while (left > 0 && open(r, left - 1)) left--;
+    while (right < w - 1 && open(r, right + 1)) right++;
+    uint64_t* bits = mask.row(r);
+    for (int x = left; x <= right; x++) bits[x >> 6] |= uint64_t(1) << (x & 63);
+
+    int from = std::max(0, left - slack), to = std::min(w - 1, right + slack);
+    for (int next = r - 1; next <= r + 1; next += 2) {
+      if (next < 0 || next >= h) continue;
+      bool inRun = false;
+      for (int x = from; x <= to; x++) {
+        bool matches = open(next, x);
+        if (matches && !inRun) stack.push_back(std::make_pair(next, x));
+        inRun = matches;
+      }
+    }
+  }
+  return mask;
+}
+
+/**
+ * @brief Recolor the region connected to a seed
+ * @param src Source RGB view
+ * @param dst Destination view of the same size (may be src)
+ * @param row Row of the seed
+ * @param col Column of the seed
+ * @param newColor Color of the filled pixels
+ * @param tolerance Largest color distance from the seed color
+ * @param connectivity Neighbours that connect
+ * @return Number of pixels filled
+ */
+long floodFill(const ConstImageView& src, const ImageView& dst, int row, int col,
+               const Pixel& newColor, int tolerance, Connectivity connectivity) {
+  BitMask mask = floodMask(src, row, col, tolerance, connectivity);
+  if (dst.data() != src.data()) copy(src, dst);
+  long filled = 0;
+  for (int r = 0; r < mask.height(); r++) {
+    const uint64_t* bits = mask.row(r);
+    for (int j = 0; j < mask.wordsPerRow(); j++) {
+      for (uint64_t word = bits[j]; word; word &= word - 1) {
+        unsigned char* p = dst.at(r, j * 64 + lowestBit(word));
+        p[0] = newColor.r;
+        p[1] = newColor.g;
+        p[2] = newColor.b;
+        filled++;
+      }
+    }
+  }
+  return filled;
+}
+
+/**
+ * @brief Recolor the pixels connected to a seed, leaving the rest of the image as is
+ * @param row Row of the seed
+ * @param col Column of the seed
+ * @param newColor Color of the filled pixels
+ * @param tolerance Largest color distance from the seed's color (see colorReplace())
+ * @return Filled image
+ */
+Image Image::floodFill(int row, int col, const Pixel& newColor, int tolerance) const {
+  AGL_TRACE_SCOPE("Image::floodFill", (long long) mWidth * mHeight);
+  Image result(mWidth, mHeight);
+  agl::floodFill(view(), result.view(), row, col, newColor, tolerance);
+  return result;
+}
+
+}  // namespace agl
@@ -0,0 +1,118 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the declarations for connected component labeling
+* and scanline flood fill.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#ifndef AGL_COMPONENTS_H_
+#define AGL_COMPONENTS_H_
+
+#include <cstdint>
+#include <vector>
+#include "image.h"
+#include "morphology.h"
+
+namespace agl {
+
+// Which neighbours connect: edge neighbours only, or edge and corner neighbours
+enum class Connectivity { Four, Eight };
+
+/**
+ * @brief Size and position of one connected component
+ */
+struct Component {
+  long long area = 0;          // pixels in the component
+  Rect bounds = {0, 0, 0, 0};  // bounding box
+  double centroidX = 0;        // mean column
+  double centroidY = 0;        // mean row
+};
+
+/**
+ * @brief Labels of the connected components of a binary mask
+ *
+ * Background pixels are labeled 0 and the components 1 to count(), in the
+ * order their first pixels appear in a row by row scan.
+ *
+ * Labeling is two pass and works on runs of set pixels rather than on
+ * single pixels. The mask is split into bands of rows. In parallel, each
+ * band finds its runs, 64 pixels per word, and joins the runs that touch
+ * in a union-find forest of its own. The forests are then joined across
+ * band boundaries. A single pass over the runs, which are far fewer than
+ * the pixels, numbers the components and sums their statistics. Finally
+ * the label map is written in parallel, band by band. Time is linear in
+ * the pixels.
+ */
+class Components {
+ public:
+  Components();
+
+  // Label the set pixels of a mask
+  explicit Components(const BitMask& mask, Connectivity connectivity = Connectivity::Eight);
+
+  int width() const { return mWidth; }
+  int height() const { return mHeight; }
+
+  // Number of components
+  int count() const { return (int) mComponents.size(); }
+
+  // Label of the pixel at (row, col), 0 for background or outside the mask
+  int label(int row, int col) const;
+
+  // Labels of the given row (unchecked)
+  const int32_t* row(int i) const { return &mLabels[(size_t) i * mWidth]; }
+
+  // Statistics of the component with the given label (1 to count())
+  const Component& component(int label) const { return mComponents[label - 1]; }
+
+  // Statistics of every component, the one labeled 1 first
+  const std::vector<Component>& components() const { return mComponents; }
+
+  // Label of the component with the largest area, 0 if there are none
+  int largest() const;
+
+  // Pixels of one component
+  BitMask mask(int label) const;
+
+  // Give each component a distinct color on black, to view the labels
+  Image toImage() const;
+
+ private:
+  int mWidth;
+  int mHeight;
+  std::vector<int32_t> mLabels;
+  std::vector<Component> mComponents;
+};
+
+/**
+ * @brief Pixels connected to a seed whose color is close to the seed's
+ * @param view RGB view to search
+ * @param row Row of the seed
+ * @param col Column of the seed
+ * @param tolerance Largest color distance from the seed color, as in colorReplace()
+ * @param connectivity Neighbours that connect
+ * @return Mask of the region, empty (no pixels set) if the seed is outside the view
+ */
+BitMask floodMask(const ConstImageView& view, int row, int col, int tolerance,
+                  Connectivity connectivity = Connectivity::Four);
+
+/**
+ * @brief Recolor the region connected to a seed (see floodMask())
+ * @param src Source RGB view
+ * @param dst Destination view of the same size (may be src)
+ * @param row Row of the seed
+ * @param col Column of the seed
+ * @param newColor Color of the filled pixels
+ * @param tolerance Largest color distance from the seed color
+ * @param connectivity Neighbours that connect
+ * @return Number of pixels filled
+ */
+long floodFill(const ConstImageView& src, const ImageView& dst, int row, int col,
+               const Pixel& newColor, int tolerance,
+               Connectivity connectivity = Connectivity::Four);
+
+}  // namespace agl
+#endif  // AGL_COMPONENTS_H_
@@ -0,0 +1,170 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the definitions for clipped blits and Porter-Duff
+* compositing.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#include "composite.h"
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+#include "fixed_point.h"
+#include "image.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define AGL_COMPOSITE_SSE2
+#endif
+
+namespace agl {
+
+namespace {
+
+using fixed::mulDiv255;
+
+#ifdef AGL_COMPOSITE_SSE2
+// fixed::mulDiv255 on eight 16-bit lanes
+inline __m128i mul255(__m128i a, __m128i b) {
+  __m128i t = _mm_add_epi16(_mm_mullo_epi16(a, b), _mm_set1_epi16(128));
+  return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+#endif
+
+/**
+ * @brief out[i] = min(255, src[i] * fa[i] / 255 + dst[i] * fb[i] / 255) for n samples
+ *
+ * out may be dst.
+ */
+void blendSamples(const unsigned char* src, const unsigned char* fa,
+                  const unsigned char* dst, const unsigned char* fb,
+                  unsigned char* out, int n) {
+  int i = 0;
+#ifdef AGL_COMPOSITE_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= n; i += 16) {
+    __m128i s = _mm_loadu_si128((const __m128i*) (src + i));
+    __m128i a = _mm_loadu_si128((const __m128i*) (fa + i));
+    __m128i d = _mm_loadu_si128((const __m128i*) (dst + i));
+    __m128i b = _mm_loadu_si128((const __m128i*) (fb + i));
+    __m128i lo = _mm_add_epi16(mul255(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(a, zero)),
+                               mul255(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(b, zero)));
+    __m128i hi = _mm_add_epi16(mul255(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(a, zero)),
+                               mul255(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(b, zero)));
+    _mm_storeu_si128((__m128i*) (out + i), _mm_packus_epi16(lo, hi));
+  }
+#endif
+  for (; i < n; i++) {
+    out[i] = fixed::addSat(mulDiv255(src[i], fa[i]), mulDiv255(dst[i], fb[i]));
+  }
+}
+
+/**
+ * @brief Porter-Duff factors for the given source and destination alpha
+ */
+inline void factors(CompositeOp op, int as, int ad, int& fa, int& fb) {
+  switch (op) {
+    case CompositeOp::Source: fa = 255;      fb = 0;        break;
+    case CompositeOp::Over:   fa = 255;      fb = 255 - as; break;
+    case CompositeOp::In:     fa = ad;       fb = 0;        break;
+    case CompositeOp::Out:    fa = 255 - ad; fb = 0;        break;
+    case CompositeOp::Atop:   fa = ad;       fb = 255 - as; break;
+    case CompositeOp::Xor:    fa = 255 - ad; fb = 255 - as; break;
+  }
+}
+
+}  // namespace
+
+/**
+ * @brief Default options: opaque source and destination drawn with Over
+ */
+CompositeOptions::CompositeOptions() : op(CompositeOp::Over), opacity(255) {}
+
+/**
+ * @brief Composite src onto dst with its top left corner at (x, y)
+ * @param src Source RGB view
+ * @param dst Destination RGB view
+ * @param x Destination column of the source's left edge
+ * @param y Destination row of the source's top edge
+ * @param options Operator, alpha planes, mask and opacity
+ */
+void composite(const ConstImageView& src, const ImageView& dst, int x, int y,
+               const CompositeOptions& options) {
+  const bool hasSrcAlpha = !options.srcAlpha.empty();
+  const bool hasDstAlpha = !options.dstAlpha.empty();
+  const bool hasMask = !options.mask.empty();
+  assert(!hasSrcAlpha || (options.srcAlpha.width() == src.width() &&
+                          options.srcAlpha.height() == src.height()));
+  assert(!hasMask || (options.mask.width() == src.width() &&
+                      options.mask.height() == src.height()));
+  assert(!hasDstAlpha || (options.dstAlpha.width() == dst.width() &&
+                          options.dstAlpha.height() == dst.height()));
+
+  // Clip once against the destination
+  int sx = std::max(0, -x), sy = std::max(0, -y);
+  int dx = std::max(0, x), dy = std::max(0, y);
+  int w = std::min(src.width() - sx, dst.width() - dx);
+  int h = std::min(src.height() - sy, dst.height() - dy);
+  if (w <= 0 || h <= 0) {
+    return;
+  }
+  ConstImageView s = src.subview(sx, sy, w, h);
+  ImageView d = dst.subview(dx, dy, w, h);
+  ConstImageView sa = hasSrcAlpha ? options.srcAlpha.subview(sx, sy, w, h) : ConstImageView();
+  ConstImageView mask = hasMask ? options.mask.subview(sx, sy, w, h) : ConstImageView();
+  ImageView da = hasDstAlpha ? options.dstAlpha.subview(dx, dy, w, h) : ImageView();
+
+  // Opaque pastes are plain row copies
+  bool srcOpaque = !hasSrcAlpha && !hasMask && options.opacity == 255;
+  bool copyRows = (options.op == CompositeOp::Source && !hasMask && options.opacity == 255) ||
+                  (options.op == CompositeOp::Over && srcOpaque);
+  if (copyRows) {
+    copy(s, d);
+    if (hasDstAlpha) {
+      if (hasSrcAlpha) {
+        copy(sa, da);
+      } else {
+        fill(da, Pixel(255, 255, 255));
+      }
+    }
+    return;
+  }
+
+  std::vector<unsigned char> fa(w * 3), fb(w * 3);
+  for (int row = 0; row < h; row++) {
+    const unsigned char* saRow = hasSrcAlpha ? sa.row(row) : NULL;
+    const unsigned char* maskRow = hasMask ? mask.row(row) : NULL;
+    unsigned char* daRow = hasDstAlpha ? da.row(row) : NULL;
+    for (int col = 0; col < w; col++) {
+      int k = options.opacity;
+      if (maskRow) {
+        k = mulDiv255(k, maskRow[col * mask.pixelStride()]);
+      }
+      int as = saRow ? mulDiv255(saRow[col * sa.pixelStride()], k) : k;
+      int ad = daRow ? daRow[col * da.pixelStride()] : 255;
+      int a = 255, b = 0;
+      factors(options.op, as, ad, a, b);
+      if (daRow) {
+        daRow[col * da.pixelStride()] = fixed::addSat(mulDiv255(as, a), mulDiv255(ad, b));
+      }
+      // the source color is premultiplied, so it carries the mask and
+      // opacity along with its alpha
+      a = mulDiv255(a, k);
+      fa[col * 3] = fa[col * 3 + 1] = fa[col * 3 + 2] = a;
+      fb[col * 3] = fb[col * 3 + 1] = fb[col * 3 + 2] = b;
+    }
+    if (s.packed() && d.packed()) {
+      blendSamples(s.row(row), fa.data(), d.row(row), fb.data(), d.row(row), w * 3);
+    } else {
+      for (int col = 0; col < w; col++) {
+        blendSamples(s.at(row, col), &fa[col * 3], d.at(row, col), &fb[col * 3], d.at(row, col), 3);
+      }
+    }
+  }
+}
+
+}  // namespace agl
@@ -0,0 +1,76 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the declarations for clipped blits and Porter-Duff
+* compositing.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#ifndef AGL_COMPOSITE_H_
+#define AGL_COMPOSITE_H_
+
+#include "image_view.h"
+
+namespace agl {
+
+/**
+ * @brief Porter-Duff operators
+ *
+ * With source alpha As and destination alpha Ad, every operator computes
+ *    result = src * Fa + dst * Fb
+ * on premultiplied colors and alpha alike, where
+ *    Source: Fa = 1,      Fb = 0
+ *    Over:   Fa = 1,      Fb = 1 - As
+ *    In:     Fa = Ad,     Fb = 0
+ *    Out:    Fa = 1 - Ad, Fb = 0
+ *    Atop:   Fa = Ad,     Fb = 1 - As
+ *    Xor:    Fa = 1 - Ad, Fb = 1 - As
+ */
+enum class CompositeOp { Source, Over, In, Out, Atop, Xor };
+
+/**
+ * @brief Operator and optional alpha planes for composite()
+ *
+ * Alpha planes and the mask are single channel views (for example
+ * image.view().channel(0)). An empty srcAlpha or dstAlpha means the layer
+ * is opaque; an empty mask means no mask. srcAlpha and mask are aligned
+ * with the source, dstAlpha with the destination. RGB colors are taken to
+ * be premultiplied by their alpha plane, which for opaque layers is the
+ * same as plain RGB.
+ */
+struct CompositeOptions {
+  CompositeOptions();
+
+  CompositeOp op;
+
+  // Coverage of the source
+  ConstImageView srcAlpha;
+
+  // Coverage of the destination, updated in place when present
+  ImageView dstAlpha;
+
+  // Additional coverage applied to the source before compositing
+  ConstImageView mask;
+
+  // Constant coverage applied to the source before compositing
+  unsigned char opacity;
+};
+
+/**
+ * @brief Composite src onto dst with its top left corner at (x, y)
+ * @param src Source RGB view
+ * @param dst Destination RGB view, modified in place
+ * @param x Destination column of the source's left edge (may be negative)
+ * @param y Destination row of the source's top edge (may be negative)
+ * @param options Operator, alpha planes, mask and opacity
+ *
+ * The source rectangle is clipped against dst once; opaque Source and Over
+ * pastes then copy whole rows.
+ */
+void composite(const ConstImageView& src, const ImageView& dst, int x, int y,
+               const CompositeOptions& options = CompositeOptions());
+
+}  // namespace agl
+#endif  // AGL_COMPOSITE_H_
@@ -0,0 +1,289 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the definitions for the fast Fourier transform and
+* FFT convolution of views with large kernels.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#include "fft.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "parallel.h"
+
+namespace agl {
+
+namespace {
+
+typedef std::complex<float> Complex;
+
+const double kPi = 3.14159265358979323846;  // M_PI is not standard C++
+
+/**
+ * @brief Bit reversal permutation and twiddle factors for one length
+ *
+ * Built once per transform size and shared read-only between threads.
+ */
+struct Plan {
+  explicit Plan(int n) : n(n), reversed(n), twiddle(n / 2) {
+    int bits = 0;
+    while ((1 << bits) < n) bits++;
+    for (int i = 0; i < n; i++) {
+      int r = 0;
+      for (int b = 0; b < bits; b++) {
+        if (i & (1 << b)) r |= 1 << (bits - 1 - b);
+      }
+      reversed[i] = r;
+    }
+    for (int i = 0; i < n / 2; i++) {
+      double angle = -2 * kPi * i / n;
+      twiddle[i] = Complex((float) std::cos(angle), (float) std::sin(angle));
+    }
+  }
+
+  int n;
+  std::vector<int> reversed;
+  std::vector<Complex> twiddle;  // exp(-2 pi i k / n)
+};
+
+/**
+ * @brief Iterative decimation in time transform, without the inverse scale
+ */
+void transform(const Plan& plan, Complex* data, bool inverse) {
+  int n = plan.n;
+  for (int i = 0; i < n; i++) {
+    int r = plan.reversed[i];
+    if (i < r) std::swap(data[i], data[r]);
+  }
+  for (int len = 2; len <= n; len <<= 1) {
+    int half = len / 2, step = n / len;
+    for (int start = 0; start < n; start += len) {
+      for (int k = 0; k < half; k++) {
+        Complex w = plan.twiddle[k * step];
+        if (inverse) w = std::conj(w);
+        Complex a = data[start + k];
+        Complex b = data[start + k + half] * w;
+        data[start + k] = a + b;
+        data[start + k + half] = a - b;
+      }
+    }
+  }
+}
+
+/**
+ * @brief 2D transform of a grid where only the first rows rows matter
+ *
+ * The forward transform treats rows past rows as zero padding and skips
+ * them; the inverse transform only finishes rows that are read back. The
+ * row and column passes are swapped accordingly. column is scratch of
+ * height values.
+ */
+void transform2d(const Plan& rowPlan, const Plan& columnPlan, Complex* data, int rows,
+                 bool inverse, Complex* column) {
+  int w = rowPlan.n, h = columnPlan.n;
+  if (!inverse) {
+    for (int row = 0; row < rows; row++) {
+      transform(rowPlan, data + (long) row * w, inverse);
+    }
+  }
+  for (int col = 0; col < w; col++) {
+    for (int row = 0; row < h; row++) column[row] = data[(long) row * w + col];
+    transform(columnPlan, column, inverse);
+    for (int row = 0; row < h; row++) data[(long) row * w + col] = column[row];
+  }
+  if (inverse) {
+    for (int row = 0; row < rows; row++) {
+      transform(rowPlan, data + (long) row * w, inverse);
+    }
+  }
+}
+
+int nextPowerOfTwo(int n) {
+  int p = 1;
+  while (p < n) p <<= 1;
+  return p;
+}
+
+/**
+ * @brief Transform size for a kernel width and image size
+ * @param cost Set to the transform work, in units of n^2 log2(n) per tile
+ *
+ * Tiles are n - kSize + 1 wide. Neighbouring tile outputs overlap by
+ * kSize - 1, so n >= 2 * kSize - 2 keeps the overlap within one tile and
+ * lets every other row of tiles run at once. Among the sizes allowed, the
+ * one with the least total transform work is chosen.
+ */
+int transformSize(int kSize, int width, int height, double* cost = NULL) {
+  int smallest = nextPowerOfTwo(std::max(2, 2 * kSize - 2));
+  int whole = nextPowerOfTwo(std::max(width, height) + kSize - 1);
+  int best = smallest;
+  double bestCost = -1;
+  for (int n = smallest; n <= std::max(smallest, std::min(whole, 1024)); n <<= 1) {
+    int tile = n - kSize + 1;
+    double tiles = (double) ((width + tile - 1) / tile) * ((height + tile - 1) / tile);
+    double work = tiles * n * n * std::log2((double) n);
+    if (bestCost < 0 || work < bestCost) {
+      best = n;
+      bestCost = work;
+    }
+  }
+  if (cost) *cost = bestCost;
+  return best;
+}
+
+}  // namespace
+
+/**
+ * @brief In place radix-2 transform of n complex values
+ * @param data n values, transformed in place
+ * @param n Length, a power of two
+ * @param inverse Compute the inverse transform (including the 1/n scale)
+ */
+void fft(std::complex<float>* data, int n, bool inverse) {
+  assert(n > 0 && (n & (n - 1)) == 0);
+  transform(Plan(n), data, inverse);
+  if (inverse) {
+    for (int i = 0; i < n; i++) data[i] /= (float) n;
+  }
+}
+
+/**
+ * @brief In place 2D transform of a row major width * height grid
+ * @param data width * height values
+ * @param width Power of two
+ * @param height Power of two
+ * @param inverse Compute the inverse transform (including the 1/(w*h) scale)
+ */
+void fft2d(std::complex<float>* data, int width, int height, bool inverse) {
+  assert(width > 0 && (width & (width - 1)) == 0);
+  assert(height > 0 && (height & (height - 1)) == 0);
+  std::vector<Complex> column(height);
+  transform2d(Plan(width), Plan(height), data, height, inverse, column.data());
+  if (inverse) {
+    float scale = 1.0f / ((float) width * height);
+    for (long i = 0; i < (long) width * height; i++) data[i] *= scale;
+  }
+}
+
+/**
+ * @brief Correlate a view with a square kernel through the FFT
+ * @param src Source RGB view
+ * @param kernel kSize * kSize weights, row major
+ * @param kSize Width of the kernel
+ * @param out Output of src.width() * src.height() * 3 floats
+ */
+void convolveFFT(const ConstImageView& src, const float* kernel, int kSize, float* out) {
+  int w = src.width(), h = src.height();
+  memset(out, 0, (long) w * h * 3 * sizeof(float));
+  if (w == 0 || h == 0) return;
+
+  int n = transformSize(kSize, w, h);
+  int tile = n - kSize + 1;
+  // output pixel (r, c) is full convolution sample (r + shift, c + shift)
+  int shift = kSize - 1 - (kSize - 1) / 2;
+  Plan plan(n);
+  std::vector<Complex> column(n);
+
+  // correlation is convolution with the kernel rotated half a turn
+  std::vector<Complex> spectrum((long) n * n);
+  for (int row = 0; row < kSize; row++) {
+    for (int col = 0; col < kSize; col++) {
+      spectrum[(long) row * n + col] = kernel[(kSize - 1 - row) * kSize + (kSize - 1 - col)];
+    }
+  }
+  transform2d(plan, plan, spectrum.data(), kSize, false, column.data());
+  // fold the inverse transform's 1 / n^2 into the kernel
+  float scale = 1.0f / ((float) n * n);
+  for (Complex& s : spectrum) s *= scale;
+
+  int tileRows = (h + tile - 1) / tile, tileCols = (w + tile - 1) / tile;
+  int stride = src.pixelStride();
+  // rows of tiles two apart never write the same output rows
+  for (int phase = 0; phase < 2; phase++) {
+    parallelFor(0, (tileRows - phase + 1) / 2, [&](int begin, int end) {
+      std::vector<Complex> rg((long) n * n), b((long) n * n), scratch(n);
+      for (int t = begin; t < end; t++) {
+        int y0 = (2 * t + phase) * tile;
+        int th = std::min(tile, h - y0);
+        for (int tc = 0; tc < tileCols; tc++) {
+          int x0 = tc * tile;
+          int tw = std::min(tile, w - x0);
+          std::fill(rg.begin(), rg.end(), Complex());
+          std::fill(b.begin(), b.end(), Complex());
+          for (int row = 0; row < th; row++) {
+            const unsigned char* in = src.row(y0 + row) + x0 * stride;
+            Complex* rgRow = rg.data() + (long) row * n;
+            Complex* bRow = b.data() + (long) row * n;
+            for (int col = 0; col < tw; col++) {
+              rgRow[col] = Complex(in[col * stride], in[col * stride + 1]);
+              bRow[col] = Complex(in[col * stride + 2], 0);
+            }
+          }
+          // the kernel is real, so red and green stay in separate parts
+          transform2d(plan, plan, rg.data(), th, false, scratch.data());
+          transform2d(plan, plan, b.data(), th, false, scratch.data());
+          for (long i = 0; i < (long) n * n; i++) {
+            rg[i] *= spectrum[i];
+            b[i] *= spectrum[i];
+          }
+          int rowStart = std::max(0, shift - y0), rowEnd = std::min(th + kSize - 1, h - y0 + shift);
+          transform2d(plan, plan, rg.data(), rowEnd, true, scratch.data());
+          transform2d(plan, plan, b.data(), rowEnd, true, scratch.data());
+
+          int colStart = std::max(0, shift - x0), colEnd = std::min(tw + kSize - 1, w - x0 + shift);
+          for (int row = rowStart; row < rowEnd; row++) {
+            float* o = out + ((long) (y0 + row - shift) * w + x0 - shift) * 3;
+            const Complex* rgRow = rg.data() + (long) row * n;
+            const Complex* bRow = b.data() + (long) row * n;
+            for (int col = colStart; col < colEnd; col++) {
+              o[col * 3 + 0] += rgRow[col].real();
+              o[col * 3 + 1] += rgRow[col].imag();
+              o[col * 3 + 2] += bRow[col].real();
+            }
+          }
+        }
+      }
+    });
+  }
+}
+
+/**
+ * @brief Estimated cost of convolveFFT() in direct kernel taps
+ * @param kSize Width of the kernel
+ * @param width Width of the view
+ * @param height Height of the view
+ * @return Cost comparable to width * height * kSize^2 taps of direct summation
+ *
+ * One unit of transform work (see transformSize) was measured at about ten
+ * direct kernel taps.
+ */
+double fftCost(int kSize, int width, int height) {
+  double work;
+  transformSize(kSize, width, height, &work);
+  return 10 * work;
+}
+
+/**
+ * @brief Whether convolveFFT() should beat direct convolution
+ * @param kSize Width of the kernel
+ * @param width Width of the view
+ * @param height Height of the view
+ * @return true when the estimated transform work is cheaper
+ *
+ * Direct taps that fall outside the view are skipped, so small views keep
+ * direct summation longer. Square images of a few hundred pixels cross
+ * over near kSize = 11.
+ */
+bool preferFFT(int kSize, int width, int height) {
+  if (kSize <= 1 || width <= 0 || height <= 0) return false;
+  double taps = (double) width * height * std::min(kSize, width) * std::min(kSize, height);
+  return fftCost(kSize, width, height) < taps;
+}
+
+}  // namespace agl
@@ -0,0 +1,59 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the declarations for the fast Fourier transform and
+* FFT convolution of views with large kernels.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#ifndef AGL_FFT_H_
+#define AGL_FFT_H_
+
+#include <complex>
+#include "image_view.h"
+
+namespace agl {
+
+/**
+ * @brief In place radix-2 transform of n complex values
+ * @param data n values, transformed in place
+ * @param n Length, a power of two
+ * @param inverse Compute the inverse transform (including the 1/n scale)
+ */
+void fft(std::complex<float>* data, int n, bool inverse);
+
+/**
+ * @brief In place 2D transform of a row major width * height grid
+ * @param data width * height values
+ * @param width Power of two
+ * @param height Power of two
+ * @param inverse Compute the inverse transform (including the 1/(w*h) scale)
+ */
+void fft2d(std::complex<float>* data, int width, int height, bool inverse);
+
+/**
+ * @brief Correlate a view with a square kernel through the FFT
+ * @param src Source RGB view
+ * @param kernel kSize * kSize weights, row major
+ * @param kSize Width of the kernel
+ * @param out Output of src.width() * src.height() * 3 floats
+ *
+ * Same result as the direct convolve() up to float rounding, pixels
+ * outside the view counting as black. Uses overlap-add: the view is cut
+ * into tiles that fit a fixed transform size next to the kernel, so memory
+ * stays at a few transform buffers however large the image is. Two color
+ * channels share one complex transform (as real and imaginary parts) since
+ * the kernel is real. Rows of tiles run in parallel.
+ */
+void convolveFFT(const ConstImageView& src, const float* kernel, int kSize, float* out);
+
+// Estimated cost of convolveFFT() in units of one direct kernel tap
+double fftCost(int kSize, int width, int height);
+
+// True when convolveFFT() is expected to beat direct convolution on a view of this size
+bool preferFFT(int kSize, int width, int height);
+
+}  // namespace agl
+#endif  // AGL_FFT_H_
@@ -0,0 +1,101 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains integer fixed-point arithmetic on 8-bit color samples:
+* saturating add and subtract, multiply-divide by 255 and Q8.8 / Q16.16
+* interpolation.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#ifndef AGL_FIXED_POINT_H_
+#define AGL_FIXED_POINT_H_
+
+#include <cstdint>
+
+namespace agl {
+namespace fixed {
+
+/**
+ * Every function here is pure integer arithmetic on non-negative
+ * operands, so results are bit-identical on every compiler and platform
+ * and loops over them vectorize. Rounding is always to nearest with ties
+ * up, matching std::round for the non-negative values involved.
+ *
+ * A weight in Q<Bits> is an integer in [0, 1 << Bits] standing for
+ * weight / 2^Bits. Q8 (Q8.8) keeps every intermediate of an 8-bit lerp
+ * below 2^16 so it fits 16-bit SIMD lanes; Q16 (Q16.16) is for sample
+ * positions that need finer steps.
+ */
+
+// Clamp v to [0, 255]
+constexpr int saturate(int v) {
+  return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+// a + b clipped at 255
+constexpr int addSat(int a, int b) {
+  return a + b > 255 ? 255 : a + b;
+}
+
+// a - b clipped at 0
+constexpr int subSat(int a, int b) {
+  return a > b ? a - b : 0;
+}
+
+/**
+ * @brief round(a * b / 255) for a, b in [0, 255]
+ *
+ * Exact for the whole range (Blinn's trick), so multiplying by 255 is the
+ * identity and by 0 gives 0.
+ */
+constexpr int mulDiv255(int a, int b) {
+  return ((a * b + 128) + ((a * b + 128) >> 8)) >> 8;
+}
+
+/**
+ * @brief Convert a real weight to Q<Bits>, clamped to [0, 1]
+ */
+template <int Bits>
+constexpr int toFixed(float w) {
+  return w <= 0 ? 0 : (w >= 1 ? 1 << Bits : (int) (w * (1 << Bits) + 0.5f));
+}
+
+/**
+ * @brief Interpolate from a to b by a Q<Bits> weight
+ * @param a Value at weight 0, in [0, 255]
+ * @param b Value at weight 1, in [0, 255]
+ * @param w Weight in [0, 1 << Bits]
+ * @return round(a + (b - a) * w / 2^Bits)
+ */
+template <int Bits>
+constexpr int lerp(int a, int b, int w) {
+  return (a * ((1 << Bits) - w) + b * w + (1 << (Bits - 1))) >> Bits;
+}
+
+constexpr int toQ8(float w) { return toFixed<8>(w); }
+constexpr int toQ16(float w) { return toFixed<16>(w); }
+constexpr int lerpQ8(int a, int b, int w) { return lerp<8>(a, b, w); }
+constexpr int lerpQ16(int a, int b, int w) { return lerp<16>(a, b, w); }
+
+/**
+ * @brief Convert a non-negative real scale to Q16.16, saturating at 2^15
+ *
+ * Larger scales push every non-zero sample past 255 anyway.
+ */
+constexpr int32_t toScaleQ16(float s) {
+  return s <= 0 ? 0 : (s >= 32768 ? INT32_MAX : (int32_t) (s * 65536 + 0.5f));
+}
+
+/**
+ * @brief round(v * s) clipped at 255 for v in [0, 255] and a Q16.16 scale s
+ */
+constexpr int scaleQ16(int v, int32_t s) {
+  return ((int64_t) v * s + 32768) >> 16 > 255 ? 255 : (int) (((int64_t) v * s + 32768) >> 16);
+}
+
+}  // namespace fixed
+}  // namespace agl
+
+#endif  // AGL_FIXED_POINT_H_
@@ -0,0 +1,832 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the definitions for the operation graph, which runs
+* many image operations derived from shared sources tile by tile.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#include "graph.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include "fixed_point.h"
+#include "noise.h"
+#include "parallel.h"
+#include "trace.h"
+
+namespace agl {
+
+namespace {
+
+const Rect kEmpty = {0, 0, 0, 0};
+
+// Rectangles a list of changes may hold before it is merged into one
+const int kMaxRects = 256;
+
+// Largest channel shift computed tile by tile. Each tile reads the union of
+// the three shifted tiles, so larger shifts run as a barrier instead.
+const int kMaxShiftHalo = 32;
+
+/**
+ * @brief Add a rectangle to a list of changed areas
+ *
+ * Rectangles already covered are dropped. A list that grows past
+ * kMaxRects collapses to its bounding box, so diamonds in the graph cannot
+ * multiply the list at every level.
+ */
+void addRect(std::vector<Rect>& rects, const Rect& rect) {
+  if (rect.empty()) return;
+  for (const Rect& r : rects) {
+    if (r.x <= rect.x && r.y <= rect.y && r.x + r.width >= rect.x + rect.width &&
+        r.y + r.height >= rect.y + rect.height) {
+      return;
+    }
+  }
+  rects.push_back(rect);
+  if ((int) rects.size() > kMaxRects) {
+    Rect all = kEmpty;
+    for (const Rect& r : rects) all = unite(all, r);
+    rects.assign(1, all);
+  }
+}
+
+/**
+ * @brief Whether two sets of per-node requests can be computed in one pass
+ *
+ * They can when no node's bounding box of both requests is larger than the
+ * two requests together, i.e. sharing never computes pixels nobody reads
+ * beyond what computing them apart would repeat.
+ */
+bool shareable(const std::vector<Rect>& a, const std::vector<Rect>& b,
+               const std::vector<Graph::Node>& order) {
+  for (Graph::Node node : order) {
+    const Rect& r = a[node];
+    const Rect& s = b[node];
+    if (r.empty() || s.empty()) continue;
+    Rect all = unite(r, s);
+    if ((long long) all.width * all.height >
+        (long long) r.width * r.height + (long long) s.width * s.height) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Builds the deduplication key of a node from its name, inputs and parameters
+ */
+class Key {
+ public:
+  explicit Key(const char* name) { mStream << name << std::hexfloat; }
+
+  template <class T>
+  Key& operator<<(const T& value) {
+    mStream << ' ' << value;
+    return *this;
+  }
+
+  std::string str() const { return mStream.str(); }
+
+ private:
+  std::ostringstream mStream;
+};
+
+}  // namespace
+
+/**
+ * @brief Pixels of one node for a rectangle of its output
+ */
+struct Graph::Tile {
+  Rect rect;
+  ConstImageView view;
+
+  // View of part of the tile, given in node coordinates and clipped to the tile
+  ConstImageView sub(const Rect& r) const {
+    if (rect.empty()) return ConstImageView();
+    return view.subview(r.x - rect.x, r.y - rect.y, r.width, r.height);
+  }
+};
+
+struct Graph::NodeData {
+  std::vector<Node> inputs;
+  int width;
+  int height;
+  TileFn run;        // tiled nodes
+  RegionFn region;   // input rectangle needed for an output rectangle
+  FootprintFn affected;  // output rectangle that depends on an input rectangle
+  WholeFn whole;     // barrier nodes
+  std::shared_ptr<const Image> image;  // sources and finished barriers
+  std::unique_ptr<Image> result;  // last render, when incremental (redrawn in place)
+  std::vector<Rect> stale;        // parts of result to redo
+
+  bool resolved() const { return image != nullptr; }
+};
+
+Graph::Graph() {}
+
+Graph::~Graph() {}
+
+/**
+ * @brief Return the node with this key, creating it if needed
+ */
+Graph::Node Graph::intern(const std::string& key, std::vector<Node> inputs, int width, int height,
+                          const TileFn& run, const RegionFn& region,
+                          const FootprintFn& affected) {
+  std::map<std::string, Node>::const_iterator it = mKeys.find(key);
+  if (it != mKeys.end()) return it->second;
+  std::unique_ptr<NodeData> node(new NodeData());
+  node->inputs = inputs;
+  node->width = width;
+  node->height = height;
+  node->run = run;
+  node->region = region;
+  node->affected = affected;
+  mNodes.push_back(std::move(node));
+  Node id = (Node) mNodes.size() - 1;
+  mKeys[key] = id;
+  return id;
+}
+
+/**
+ * @brief Node reading an image that the graph keeps alive
+ * @param image Image to read
+ * @return Node id
+ *
+ * Every call makes a new node. Sources are keyed by a count rather than
+ * the image's address, which update() replaces and the allocator may
+ * hand to a different image later.
+ */
+Graph::Node Graph::source(const std::shared_ptr<const Image>& image) {
+  assert(image);
+  std::string key = (Key("source") << mSources++).str();
+  Node id = intern(key, {}, image->width(), image->height(), TileFn(), RegionFn(),
+                   FootprintFn());
+  mNodes[id]->image = image;
+  return id;
+}
+
+/**
+ * @brief Node reading a copy of an image
+ * @param image Image to copy
+ * @return Node id
+ */
+Graph::Node Graph::source(const Image& image) {
+  return source(std::make_shared<const Image>(image));
+}
+
+/**
+ * @brief Node computing each output pixel from the input pixel at the same place
+ */
+Graph::Node Graph::pointwise(const std::string& key, Node in,
+                             const std::function<void(const ConstImageView&,
+                                                      const ImageView&)>& run) {
+  return intern(key, {in}, width(in), height(in),
+                [run](const std::vector<Tile>& inputs, const Rect& rect, const ImageView& out) {
+                  run(inputs[0].sub(rect), out);
+                },
+                [](const Rect& out, int) { return out; },
+                [](const Rect& in, int) { return in; });
+}
+
+/**
+ * @brief Node combining two inputs pixel by pixel; b is black where it is smaller than a
+ */
+Graph::Node Graph::binary(const std::string& key, Node a, Node b,
+                          const std::function<void(const ConstImageView&, const ConstImageView&,
+                                                   const ImageView&)>& run) {
+  return intern(key, {a, b}, width(a), height(a),
+                [run](const std::vector<Tile>& inputs, const Rect& rect, const ImageView& out) {
+                  run(inputs[0].sub(rect), inputs[1].sub(rect), out);
+                },
+                [](const Rect& out, int) { return out; },
+                [](const Rect& in, int) { return in; });
+}
+
+/**
+ * @brief Node running an Image method on the whole of its input
+ */
+Graph::Node Graph::barrier(const std::string& key, Node in, int width, int height,
+                           const WholeFn& run) {
+  Node id = intern(key, {in}, width, height, TileFn(), RegionFn(), FootprintFn());
+  mNodes[id]->whole = run;
+  return id;
+}
+
+Graph::Node Graph::invert(Node in) {
+  return pointwise((Key("invert") << in).str(), in,
+                   [](const ConstImageView& src, const ImageView& dst) { agl::invert(src, dst); });
+}
+
+Graph::Node Graph::grayscale(Node in) {
+  return pointwise((Key("grayscale") << in).str(), in,
+                   [](const ConstImageView& src, const ImageView& dst) {
+                     agl::grayscale(src, dst);
+                   });
+}
+
+Graph::Node Graph::gammaCorrect(Node in, float gamma) {
+  return pointwise((Key("gammaCorrect") << in << gamma).str(), in,
+                   [gamma](const ConstImageView& src, const ImageView& dst) {
+                     agl::gammaCorrect(src, dst, gamma);
+                   });
+}
+
+/**
+ * @brief Add one random color to every pixel, drawn now from a fresh seed
+ */
+Graph::Node Graph::colorJitter(Node in, int size) {
+  return colorJitter(in, size, CounterRng::freshSeed());
+}
+
+/**
+ * @brief Add one random color to every pixel, drawn from seed as Image::colorJitter does
+ */
+Graph::Node Graph::colorJitter(Node in, int size, uint64_t seed) {
+  CounterRng rng(seed);
+  Pixel delta = Pixel(rng.below(0, 255), rng.below(1, 255), rng.below(2, 255));
+  delta = (delta / 255.0) * size;
+  const int d[3] = {delta.r, delta.g, delta.b};
+  return pointwise((Key("colorJitter") << in << d[0] << d[1] << d[2]).str(), in,
+                   [d](const ConstImageView& src, const ImageView& dst) {
+                     for (int row = 0; row < dst.height(); row++) {
+                       const unsigned char* i = src.row(row);
+                       unsigned char* o = dst.row(row);
+                       for (int col = 0; col < dst.width() * 3; col++) {
+                         o[col] = fixed::addSat(i[col], d[col % 3]);
+                       }
+                     }
+                   });
+}
+
+/**
+ * @brief Per-sample noise; tiles draw by image position, so any tiling gives the same pixels
+ */
+Graph::Node Graph::pixelJitter(Node in, int amount, uint64_t seed) {
+  return intern((Key("pixelJitter") << in << amount << seed).str(), {in}, width(in), height(in),
+                [amount, seed](const std::vector<Tile>& inputs, const Rect& rect,
+                               const ImageView& out) {
+                  agl::pixelJitter(inputs[0].sub(rect), out, amount, seed, rect.x, rect.y);
+                },
+                [](const Rect& out, int) { return out; },
+                [](const Rect& in, int) { return in; });
+}
+
+Graph::Node Graph::filmGrain(Node in, float strength, uint64_t seed) {
+  return intern((Key("filmGrain") << in << strength << seed).str(), {in}, width(in), height(in),
+                [strength, seed](const std::vector<Tile>& inputs, const Rect& rect,
+                                 const ImageView& out) {
+                  agl::filmGrain(inputs[0].sub(rect), out, strength, seed, rect.x, rect.y);
+                },
+                [](const Rect& out, int) { return out; },
+                [](const Rect& in, int) { return in; });
+}
+
+Graph::Node Graph::colorReplace(Node in, const Pixel& oldColor, const Pixel& newColor,
+                                int tolerance) {
+  Key key("colorReplace");
+  key << in << (int) oldColor.r << (int) oldColor.g << (int) oldColor.b
+      << (int) newColor.r << (int) newColor.g << (int) newColor.b << tolerance;
+  return pointwise(key.str(), in, [=](const ConstImageView& src, const ImageView& dst) {
+    agl::colorReplace(src, dst, oldColor, newColor, tolerance);
+  });
+}
+
+/**
+ * @brief Displace each channel; tiles read a halo as wide as the largest shift
+ *
+ * Shifts beyond kMaxShiftHalo would make every tile read far more than a
+ * tile, so the whole image is shifted at once instead.
+ */
+Graph::Node Graph::channelShift(Node in, const int rShift[2], const int gShift[2],
+                                const int bShift[2]) {
+  Key key("channelShift");
+  key << in << rShift[0] << rShift[1] << gShift[0] << gShift[1] << bShift[0] << bShift[1];
+  std::vector<int> shifts = {rShift[0], rShift[1], gShift[0], gShift[1], bShift[0], bShift[1]};
+  int w = width(in), h = height(in);
+  int halo = 0;
+  for (int shift : shifts) halo = std::max(halo, std::abs(shift));
+  if (halo > kMaxShiftHalo) {
+    return barrier(key.str(), in, w, h, [shifts](const Image& image) {
+      int r[2] = {shifts[0], shifts[1]}, g[2] = {shifts[2], shifts[3]};
+      int b[2] = {shifts[4], shifts[5]};
+      return image.channelShift(r, g, b);
+    });
+  }
+  return intern(key.str(), {in}, w, h,
+                [shifts, w, h](const std::vector<Tile>& inputs, const Rect& rect,
+                               const ImageView& out) {
+                  const Tile& src = inputs[0];
+                  for (int c = 0; c < 3; c++) {
+                    int dx = shifts[2 * c], dy = shifts[2 * c + 1];
+                    for (int row = 0; row < rect.height; row++) {
+                      int srcRow = rect.y + row + dy;
+                      unsigned char* o = out.row(row) + c;
+                      for (int col = 0; col < rect.width; col++) {
+                        int srcCol = rect.x + col + dx;
+                        bool inside = srcRow >= 0 && srcRow < h && srcCol >= 0 && srcCol < w;
+                        o[col * 3] = inside ? src.view.at(srcRow - src.rect.y,
+                                                          srcCol - src.rect.x)[c] : 0;
+                      }
+                    }
+                  }
+                },
+                [shifts](const Rect& out, int) {
+                  Rect needed = kEmpty;
+                  for (int c = 0; c < 3; c++) {
+                    Rect shifted = {out.x + shifts[2 * c], out.y + shifts[2 * c + 1],
+                                    out.width, out.height};
+                    needed = unite(needed, shifted);
+                  }
+                  return needed;
+                },
+                [shifts](const Rect& in, int) {
+                  Rect changed = kEmpty;
+                  for (int c = 0; c < 3; c++) {
+                    Rect shifted = {in.x - shifts[2 * c], in.y - shifts[2 * c + 1],
+                                    in.width, in.height};
+                    changed = unite(changed, shifted);
+                  }
+                  return changed;
+                });
+}
+
+/**
+ * @brief Rotate a quarter turn; an output tile reads the transposed input tile
+ */
+Graph::Node Graph::rotate90(Node in) {
+  int h = height(in);
+  return intern((Key("rotate90") << in).str(), {in}, h, width(in),
+                [h](const std::vector<Tile>& inputs, const Rect& rect, const ImageView& out) {
+                  const Tile& src = inputs[0];
+                  for (int row = 0; row < rect.height; row++) {
+                    unsigned char* o = out.row(row);
+                    int srcCol = rect.y + row;
+                    for (int col = 0; col < rect.width; col++) {
+                      int srcRow = h - 1 - (rect.x + col);
+                      const unsigned char* p = src.view.at(srcRow - src.rect.y,
+                                                           srcCol - src.rect.x);
+                      o[col * 3 + 0] = p[0];
+                      o[col * 3 + 1] = p[1];
+                      o[col * 3 + 2] = p[2];
+                    }
+                  }
+                },
+                [h](const Rect& out, int) {
+                  return Rect{out.y, h - out.x - out.width, out.height, out.width};
+                },
+                [h](const Rect& in, int) {
+                  return Rect{h - in.y - in.height, in.x, in.height, in.width};
+                });
+}
+
+/**
+ * @brief Correlate with a kernel; tiles read a halo of the kernel radius
+ *
+ * Whether to use the separable passes is decided once from the kernel
+ * alone, and never FFT, so every tile rounds the same way.
+ */
+Graph::Node Graph::convolve(Node in, const Kernel& kernel) {
+  Key key("convolve");
+  key << in << kernel.size();
+  for (float weight : kernel.weights()) key << weight;
+  int size = kernel.size();
+  int low = (size - 1) / 2, high = size - 1 - low;
+  int w = width(in), h = height(in);
+  std::shared_ptr<const Kernel> k = std::make_shared<const Kernel>(kernel);
+  // 2 * rank 1D passes against size^2 direct taps
+  bool separable = size > 1 && 2 * kernel.rank() < size;
+  return intern(key.str(), {in}, w, h,
+                [k, separable, size, low, w, h](const std::vector<Tile>& inputs, const Rect& rect,
+                                                const ImageView& out) {
+                  Rect region = {rect.x - low, rect.y - low,
+                                 rect.width + size - 1, rect.height + size - 1};
+                  region = intersect(region, Rect{0, 0, w, h});
+                  ConstImageView src = inputs[0].sub(region);
+                  std::vector<float> values((size_t) region.width * region.height * 3);
+                  if (separable) {
+                    k->applySeparable(src, values.data());
+                  } else {
+                    convolveDirect(src, k->weights().data(), size, values.data());
+                  }
+                  int dx = rect.x - region.x, dy = rect.y - region.y;
+                  for (int row = 0; row < rect.height; row++) {
+                    const float* v = values.data() + ((size_t) (row + dy) * region.width + dx) * 3;
+                    unsigned char* o = out.row(row);
+                    for (int i = 0; i < rect.width * 3; i++) {
+                      o[i] = v[i] <= 0 ? 0 : v[i] >= 255 ? 255 : (unsigned char) (v[i] + 0.5f);
+                    }
+                  }
+                },
+                [size, low](const Rect& out, int) {
+                  return Rect{out.x - low, out.y - low, out.width + size - 1, out.height + size - 1};
+                },
+                [size, high](const Rect& in, int) {
+                  return Rect{in.x - high, in.y - high, in.width + size - 1, in.height + size - 1};
+                });
+}
+
+Graph::Node Graph::add(Node a, Node b) {
+  return binary((Key("add") << a << b).str(), a, b,
+                [](const ConstImageView& x, const ConstImageView& y, const ImageView& dst) {
+                  agl::add(x, y, dst);
+                });
+}
+
+Graph::Node Graph::lightest(Node a, Node b) {
+  return binary((Key("lightest") << a << b).str(), a, b,
+                [](const ConstImageView& x, const ConstImageView& y, const ImageView& dst) {
+                  agl::lightest(x, y, dst);
+                });
+}
+
+Graph::Node Graph::darkest(Node a, Node b) {
+  return binary((Key("darkest") << a << b).str(), a, b,
+                [](const ConstImageView& x, const ConstImageView& y, const ImageView& dst) {
+                  agl::darkest(x, y, dst);
+                });
+}
+
+Graph::Node Graph::alphaBlend(Node a, Node b, float alpha) {
+  return binary((Key("alphaBlend") << a << b << alpha).str(), a, b,
+                [alpha](const ConstImageView& x, const ConstImageView& y, const ImageView& dst) {
+                  agl::alphaBlend(x, y, dst, alpha);
+                });
+}
+
+Graph::Node Graph::sobel(Node in) {
+  return barrier((Key("sobel") << in).str(), in, width(in), height(in),
+                 [](const Image& image) { return image.sobel(); });
+}
+
+Graph::Node Graph::gaussianBlur(Node in, float sigma) {
+  return barrier((Key("gaussianBlur") << in << sigma).str(), in, width(in), height(in),
+                 [sigma](const Image& image) { return image.gaussianBlur(sigma); });
+}
+
+Graph::Node Graph::halftone(Node in, const int rShift[2], const int gShift[2],
+                            const int bShift[2]) {
+  Key key("halftone");
+  key << in << rShift[0] << rShift[1] << gShift[0] << gShift[1] << bShift[0] << bShift[1];
+  std::vector<int> s = {rShift[0], rShift[1], gShift[0], gShift[1], bShift[0], bShift[1]};
+  // the legacy halftone renders at 4x
+  return barrier(key.str(), in, 4 * width(in), 4 * height(in), [s](const Image& image) {
+    int r[2] = {s[0], s[1]}, g[2] = {s[2], s[3]}, b[2] = {s[4], s[5]};
+    return image.halftone(r, g, b);
+  });
+}
+
+Graph::Node Graph::resize(Node in, int width, int height) {
+  return barrier((Key("resize") << in << width << height).str(), in, width, height,
+                 [width, height](const Image& image) { return image.resize(width, height); });
+}
+
+int Graph::width(Node node) const {
+  return mNodes[node]->width;
+}
+
+int Graph::height(Node node) const {
+  return mNodes[node]->height;
+}
+
+/**
+ * @brief Run a barrier node on its whole input and keep the result
+ */
+void Graph::materialize(Node node) {
+  NodeData& data = *mNodes[node];
+  if (data.resolved()) return;
+  NodeData& input = *mNodes[data.inputs[0]];
+  if (input.resolved()) {
+    data.image = std::make_shared<const Image>(data.whole(*input.image));
+  } else {
+    data.image = std::make_shared<const Image>(data.whole(render(data.inputs[0])));
+  }
+}
+
+/**
+ * @brief Compute the given nodes
+ * @param outputs Nodes to return, in order (may repeat)
+ * @param tileSize Width and height of the output tiles
+ * @return One image per output
+ */
+std::vector<Image> Graph::render(const std::vector<Node>& outputs, int tileSize) {
+  std::vector<Image> images;
+  images.reserve(outputs.size());
+  if (mIncremental) {
+    refresh(outputs, tileSize);
+    for (Node output : outputs) images.push_back(result(output));
+    return images;
+  }
+  std::vector<Image*> targets;
+  for (Node output : outputs) {
+    images.emplace_back(width(output), height(output));
+    targets.push_back(&images.back());
+  }
+  renderInto(outputs, targets, tileSize);
+  return images;
+}
+
+/**
+ * @brief Bring the kept renders of the outputs up to date
+ * @param outputs Nodes to render (may repeat)
+ * @param tileSize Width and height of the output tiles
+ *
+ * Each output is drawn into the image kept for it, allocated by its first
+ * render; after that only the parts update() marked stale are redone.
+ */
+void Graph::refresh(const std::vector<Node>& outputs, int tileSize) {
+  assert(mIncremental);
+  std::vector<Image*> targets;
+  for (Node output : outputs) {
+    NodeData& data = *mNodes[output];
+    if (!data.result) {
+      data.result.reset(new Image(data.width, data.height));
+      data.stale.assign(1, Rect{0, 0, data.width, data.height});
+    }
+    targets.push_back(data.result.get());
+  }
+  renderInto(outputs, targets, tileSize);
+  for (Node output : outputs) mNodes[output]->stale.clear();
+}
+
+/**
+ * @brief Last render of an output
+ * @param output Node already passed to render() or refresh() in incremental mode
+ * @return The kept image, redrawn in place by later renders
+ */
+const Image& Graph::result(Node output) const {
+  assert(mNodes[output]->result);
+  return *mNodes[output]->result;
+}
+
+/**
+ * @brief Render outputs into images already allocated at their sizes
+ * @param outputs Nodes to render
+ * @param targets One image per output
+ * @param tileSize Width and height of the output tiles
+ *
+ * In incremental mode only the stale parts of each output are drawn,
+ * otherwise all of it.
+ */
+void Graph::renderInto(const std::vector<Node>& outputs, const std::vector<Image*>& targets,
+                       int tileSize) {
+  AGL_TRACE_SCOPE("Graph::render", (long long) outputs.size());
+  // barriers reachable without passing through another barrier run first
+  std::vector<bool> seen(mNodes.size(), false);
+  std::vector<Node> stack(outputs.begin(), outputs.end());
+  while (!stack.empty()) {
+    Node node = stack.back();
+    stack.pop_back();
+    if (seen[node]) continue;
+    seen[node] = true;
+    if (mNodes[node]->whole) continue;
+    for (Node in : mNodes[node]->inputs) stack.push_back(in);
+  }
+  for (Node node = 0; node < (Node) mNodes.size(); node++) {
+    if (seen[node] && mNodes[node]->whole) materialize(node);
+  }
+
+  mRenderedTiles = 0;
+  // one tile pass per output size
+  std::map<std::pair<int, int>, std::vector<int>> bySize;
+  for (int i = 0; i < (int) outputs.size(); i++) {
+    bySize[std::make_pair(width(outputs[i]), height(outputs[i]))].push_back(i);
+  }
+  for (const auto& group : bySize) {
+    std::vector<Node> nodes;
+    std::vector<Image*> images;
+    std::vector<std::vector<Rect>> regions;
+    for (int i : group.second) {
+      const NodeData& data = *mNodes[outputs[i]];
+      nodes.push_back(outputs[i]);
+      images.push_back(targets[i]);
+      if (mIncremental) {
+        regions.push_back(data.stale);
+      } else {
+        regions.push_back(std::vector<Rect>(1, Rect{0, 0, data.width, data.height}));
+      }
+    }
+    mRenderedTiles += renderTiles(nodes, images, regions, tileSize);
+  }
+}
+
+/**
+ * @brief Compute a single node
+ * @param output Node to compute
+ * @return Its pixels
+ */
+Image Graph::render(Node output) {
+  return render(std::vector<Node>(1, output))[0];
+}
+
+/**
+ * @brief Stop or start keeping rendered outputs
+ * @param incremental Keep outputs for update(); false also drops those kept
+ */
+void Graph::setIncremental(bool incremental) {
+  mIncremental = incremental;
+  if (incremental) return;
+  for (std::unique_ptr<NodeData>& node : mNodes) {
+    node->result.reset();
+    node->stale.clear();
+  }
+}
+
+/**
+ * @brief Replace the pixels of a source node
+ * @param source Node made by source()
+ * @param image New pixels, same size as before (read in place, not copied)
+ * @param changed Rectangles outside of which image matches the old pixels
+ *
+ * The changes are carried forward in id (topological) order: tiled nodes
+ * map each rectangle through their footprint, barriers fed by one are
+ * dropped to be rerun and count as changed everywhere. Kept renders are
+ * marked stale there.
+ */
+void Graph::update(Node source, const std::shared_ptr<const Image>& image,
+                   const std::vector<Rect>& changed) {
+  AGL_TRACE_SCOPE("Graph::update", (long long) changed.size());
+  NodeData& data = *mNodes[source];
+  assert(data.inputs.empty());
+  assert(image->width() == data.width && image->height() == data.height);
+  data.image = image;
+
+  int count = (int) mNodes.size();
+  std::vector<std::vector<Rect>> dirty(count);
+  for (const Rect& rect : changed) {
+    addRect(dirty[source], intersect(rect, Rect{0, 0, data.width, data.height}));
+  }
+  for (Node node = source + 1; node < count; node++) {
+    NodeData& n = *mNodes[node];
+    Rect bounds = {0, 0, n.width, n.height};
+    std::vector<Rect>& d = dirty[node];
+    for (int j = 0; j < (int) n.inputs.size(); j++) {
+      for (const Rect& in : dirty[n.inputs[j]]) {
+        addRect(d, n.whole ? bounds : intersect(n.affected(in, j), bounds));
+      }
+    }
+    if (!d.empty() && n.whole) n.image.reset();
+  }
+  for (Node node = source; node < count; node++) {
+    NodeData& n = *mNodes[node];
+    if (!n.result) continue;
+    for (const Rect& rect : dirty[node]) addRect(n.stale, rect);
+  }
+}
+
+/**
+ * @brief Replace the pixels of a source node with a copy of an image
+ * @param source Node made by source()
+ * @param image New pixels, same size as before
+ * @param changed Rectangle outside of which image matches the old pixels
+ */
+void Graph::update(Node source, const Image& image, const Rect& changed) {
+  update(source, std::make_shared<const Image>(image), std::vector<Rect>(1, changed));
+}
+
+/**
+ * @brief Replace the pixels of a source node with an edited image
+ * @param source Node made by source()
+ * @param image New pixels; only its dirtyRect() is recomputed downstream
+ */
+void Graph::update(Node source, const Image& image) {
+  update(source, image, image.dirtyRect());
+}
+
+/**
+ * @brief Evaluate outputs of one size tile by tile
+ * @param outputs Nodes of one size
+ * @param images Output images, already allocated; pixels outside regions are kept
+ * @param regions Rectangles of each output to compute
+ * @param tileSize Width and height of the tiles
+ * @return Number of tiles computed
+ *
+ * For each tile the rectangles each node must produce are found by walking
+ * from the outputs back to the sources (ids are in topological order), and
+ * then the nodes run forwards into per-thread tile buffers. Outputs whose
+ * requests overlap share a pass; the others run one after another so a node
+ * never computes the bounding box of far apart requests. Resolved nodes
+ * hand out views of their image instead of copying. Tiles that miss every
+ * output's region are skipped.
+ */
+int Graph::renderTiles(const std::vector<Node>& outputs, const std::vector<Image*>& images,
+                       const std::vector<std::vector<Rect>>& regions, int tileSize) {
+  int w = width(outputs[0]), h = height(outputs[0]);
+  if (w <= 0 || h <= 0) return 0;
+  tileSize = std::max(8, tileSize);
+
+  // nodes evaluated per tile: everything reachable up to resolved nodes
+  int count = (int) mNodes.size();
+  std::vector<bool> needed(count, false);
+  std::vector<Node> stack(outputs.begin(), outputs.end());
+  while (!stack.empty()) {
+    Node node = stack.back();
+    stack.pop_back();
+    if (needed[node]) continue;
+    needed[node] = true;
+    if (mNodes[node]->resolved()) continue;
+    for (Node in : mNodes[node]->inputs) stack.push_back(in);
+  }
+  std::vector<Node> order;
+  for (Node node = 0; node < count; node++) {
+    if (needed[node]) order.push_back(node);
+  }
+
+  int columns = (w + tileSize - 1) / tileSize, rows = (h + tileSize - 1) / tileSize;
+  // writable views are taken here, since taking one records a change
+  std::vector<ImageView> outputViews;
+  for (Image* image : images) outputViews.push_back(image->view());
+  std::atomic<int> rendered(0);
+  parallelFor(0, columns * rows, [&](int begin, int end) {
+    std::vector<Rect> requests(count, kEmpty);
+    std::vector<Tile> tiles(count);
+    std::vector<std::vector<unsigned char>> buffers(count);
+    for (int t = begin; t < end; t++) {
+      Rect rect = {(t % columns) * tileSize, (t / columns) * tileSize, 0, 0};
+      rect.width = std::min(tileSize, w - rect.x);
+      rect.height = std::min(tileSize, h - rect.y);
+
+      std::vector<int> active;
+      for (int i = 0; i < (int) outputs.size(); i++) {
+        for (const Rect& region : regions[i]) {
+          if (!intersect(region, rect).empty()) {
+            active.push_back(i);
+            break;
+          }
+        }
+      }
+      if (active.empty()) continue;
+      rendered++;
+
+      // outputs whose requests overlap share one pass; one that reads far
+      // from the rest (say through a rotation) gets its own, so no node
+      // computes the bounding box of distant rectangles
+      std::vector<std::vector<int>> groups;
+      std::vector<std::vector<Rect>> groupRequests;
+      for (int i : active) {
+        for (Node node : order) requests[node] = kEmpty;
+        requests[outputs[i]] = rect;
+        for (int k = (int) order.size() - 1; k >= 0; k--) {
+          const NodeData& data = *mNodes[order[k]];
+          const Rect& request = requests[order[k]];
+          if (request.empty() || data.resolved()) continue;
+          for (int j = 0; j < (int) data.inputs.size(); j++) {
+            Node in = data.inputs[j];
+            Rect bounds = {0, 0, width(in), height(in)};
+            requests[in] = unite(requests[in], intersect(data.region(request, j), bounds));
+          }
+        }
+        size_t g = 0;
+        while (g < groups.size() && !shareable(groupRequests[g], requests, order)) g++;
+        if (g == groups.size()) {
+          groups.emplace_back();
+          groupRequests.push_back(requests);
+        } else {
+          for (Node node : order) {
+            groupRequests[g][node] = unite(groupRequests[g][node], requests[node]);
+          }
+        }
+        groups[g].push_back(i);
+      }
+
+      for (size_t g = 0; g < groups.size(); g++) {
+        for (Node node : order) {
+          const NodeData& data = *mNodes[node];
+          const Rect& request = groupRequests[g][node];
+          Tile& tile = tiles[node];
+          tile.rect = request;
+          if (request.empty()) {
+            tile.view = ConstImageView();
+            continue;
+          }
+          if (data.resolved()) {
+            tile.view = data.image->view().subview(request.x, request.y,
+                                                   request.width, request.height);
+            continue;
+          }
+          std::vector<unsigned char>& buffer = buffers[node];
+          buffer.resize((size_t) request.width * request.height * 3);
+          ImageView target(buffer.data(), request.width, request.height, request.width * 3);
+          tile.view = target;
+          std::vector<Tile> inputs;
+          for (Node in : data.inputs) inputs.push_back(tiles[in]);
+          data.run(inputs, request, target);
+        }
+
+        for (int i : groups[g]) {
+          ImageView dst = outputViews[i].subview(rect.x, rect.y, rect.width, rect.height);
+          copy(tiles[outputs[i]].sub(rect), dst);
+        }
+      }
+    }
+  });
+  return rendered;
+}
+
+}  // namespace agl
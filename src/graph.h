@@ -0,0 +1,177 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the declarations for the operation graph, which runs
+* many image operations derived from shared sources tile by tile.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#ifndef AGL_GRAPH_H_
+#define AGL_GRAPH_H_
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "image.h"
+#include "kernel.h"
+
+namespace agl {
+
+/**
+ * @brief DAG of image operations executed tile by tile
+ *
+ * Every builder method returns a node id. Asking twice for the same
+ * operation on the same inputs returns the same node, so common
+ * subexpressions are computed once. render() splits the outputs into
+ * tiles and evaluates the whole graph for one tile at a time on the
+ * thread pool: each node only computes the rectangle its consumers need
+ * (the tile plus any halo, e.g. for channelShift), and intermediates live
+ * in small per-thread tile buffers instead of full images.
+ *
+ * Operations that need their whole input (sobel and gaussianBlur
+ * normalize by the image maximum, halftone and resize resample) are
+ * barriers, as is a channelShift whose halo would dwarf a tile: their
+ * input is rendered in full, the Image method runs once
+ * and its result is kept as a source for the rest of the graph. Every
+ * node gives the same pixels as the corresponding Image method.
+ *
+ * With setIncremental(true) rendered outputs are kept and redrawn in place
+ * (see refresh()). update() swaps in edited source pixels and maps the
+ * changed rectangle forward through each node's footprint (a kernel
+ * radius, a shift, a rotation), so the next render() only recomputes the
+ * output tiles it reaches. Barriers below a change are rerun in full.
+ */
+class Graph {
+ public:
+  typedef int Node;
+
+  Graph();
+  ~Graph();
+
+  Graph(const Graph&) = delete;
+  Graph& operator=(const Graph&) = delete;
+
+  // Leaf node reading an image (kept alive by the graph, never copied);
+  // every call makes a new node
+  Node source(const std::shared_ptr<const Image>& image);
+
+  // Leaf node reading a copy of an image
+  Node source(const Image& image);
+
+  // Tiled operations (see the Image methods of the same name)
+  Node invert(Node in);
+  Node grayscale(Node in);
+  Node gammaCorrect(Node in, float gamma);
+  Node colorJitter(Node in, int size);
+  Node colorJitter(Node in, int size, uint64_t seed);
+  Node pixelJitter(Node in, int amount, uint64_t seed);
+  Node filmGrain(Node in, float strength, uint64_t seed);
+  Node colorReplace(Node in, const Pixel& oldColor, const Pixel& newColor, int tolerance);
+  Node channelShift(Node in, const int rShift[2], const int gShift[2], const int bShift[2]);
+  Node rotate90(Node in);
+  // Correlate with a kernel, rounded and clipped to [0, 255], black outside
+  Node convolve(Node in, const Kernel& kernel);
+  Node add(Node a, Node b);
+  Node lightest(Node a, Node b);
+  Node darkest(Node a, Node b);
+  Node alphaBlend(Node a, Node b, float alpha);
+
+  // Barrier operations (see the Image methods of the same name)
+  Node sobel(Node in);
+  Node gaussianBlur(Node in, float sigma);
+  Node halftone(Node in, const int rShift[2], const int gShift[2], const int bShift[2]);
+  Node resize(Node in, int width, int height);
+
+  // Output size of a node
+  int width(Node node) const;
+  int height(Node node) const;
+
+  // Number of distinct nodes
+  int size() const { return (int) mNodes.size(); }
+
+  /**
+   * @brief Compute the given nodes
+   * @param outputs Nodes to return, in order (may repeat)
+   * @param tileSize Width and height of the output tiles
+   * @return One image per output
+   *
+   * Outputs of the same size share one pass over their tiles, so work
+   * they have in common is done once per tile while it is still in cache.
+   * Barrier results are kept for later calls.
+   */
+  std::vector<Image> render(const std::vector<Node>& outputs, int tileSize = 64);
+
+  // Compute a single node
+  Image render(Node output);
+
+  /**
+   * @brief Bring the kept renders of the outputs up to date, without copying them
+   * @param outputs Nodes to render (may repeat)
+   * @param tileSize Width and height of the output tiles
+   *
+   * Incremental mode only. Each output is redrawn in place, so read it
+   * with result() rather than taking a copy from render().
+   */
+  void refresh(const std::vector<Node>& outputs, int tileSize = 64);
+
+  // Last render of an output in incremental mode, redrawn in place by later renders
+  const Image& result(Node output) const;
+
+  // Output tiles computed by the last render(); incremental renders skip unchanged ones
+  int renderedTiles() const { return mRenderedTiles; }
+
+  // Keep rendered outputs so update() can limit the next render to what changed
+  void setIncremental(bool incremental);
+
+  /**
+   * @brief Replace the pixels of a source node
+   * @param source Node made by source()
+   * @param image New pixels, same size as before
+   * @param changed Rectangle outside of which image matches the old pixels
+   */
+  void update(Node source, const Image& image, const Rect& changed);
+
+  // update() with the changes recorded by the image itself (see Image::dirtyRect)
+  void update(Node source, const Image& image);
+
+  // update() reading the image in place, with several changed rectangles
+  void update(Node source, const std::shared_ptr<const Image>& image,
+              const std::vector<Rect>& changed);
+
+ private:
+  struct Tile;
+  struct NodeData;
+  typedef std::function<void(const std::vector<Tile>& inputs, const Rect& rect,
+                             const ImageView& out)> TileFn;
+  typedef std::function<Rect(const Rect& out, int input)> RegionFn;
+  typedef std::function<Image(const Image& in)> WholeFn;
+  typedef std::function<Rect(const Rect& in, int input)> FootprintFn;
+
+  Node intern(const std::string& key, std::vector<Node> inputs, int width, int height,
+              const TileFn& run, const RegionFn& region, const FootprintFn& affected);
+  Node barrier(const std::string& key, Node in, int width, int height, const WholeFn& run);
+  Node pointwise(const std::string& key, Node in,
+                 const std::function<void(const ConstImageView&, const ImageView&)>& run);
+  Node binary(const std::string& key, Node a, Node b,
+              const std::function<void(const ConstImageView&, const ConstImageView&,
+                                       const ImageView&)>& run);
+  void materialize(Node node);
+  void renderInto(const std::vector<Node>& outputs, const std::vector<Image*>& targets,
+                  int tileSize);
+  int renderTiles(const std::vector<Node>& outputs, const std::vector<Image*>& images,
+                  const std::vector<std::vector<Rect>>& regions, int tileSize);
+
+  std::vector<std::unique_ptr<NodeData>> mNodes;
+  std::map<std::string, Node> mKeys;
+  uint64_t mSources = 0;  // source nodes made so far, their dedup key
+  int mRenderedTiles = 0;
+  bool mIncremental = false;
+};
+
+}  // namespace agl
+#endif  // AGL_GRAPH_H_
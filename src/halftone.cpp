@@ -0,0 +1,244 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the method definitions for the halftone renderer.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#include "halftone.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace agl {
+
+namespace {
+
+const int kLevels = 64;
+const int kSupersample = 4;
+const float kPi = 3.14159265358979f;
+
+/**
+ * @brief Area of a disc of radius r clipped to the square [-h, h] x [-h, h]
+ */
+float discAreaInCell(float r, float h) {
+  if (r <= h) {
+    return kPi * r * r;
+  }
+  if (r >= h * std::sqrt(2.0f)) {
+    return 4 * h * h;
+  }
+  float segment = r * r * std::acos(h / r) - h * std::sqrt(r * r - h * h);
+  return kPi * r * r - 4 * segment;
+}
+
+/**
+ * @brief Radius of the dot that covers the given fraction of a cell
+ */
+float radiusForCoverage(float fraction, float cellSize) {
+  float h = cellSize / 2.0f;
+  float target = fraction * cellSize * cellSize;
+  float lo = 0;
+  float hi = h * std::sqrt(2.0f);
+  for (int i = 0; i < 24; i++) {
+    float mid = (lo + hi) / 2;
+    if (discAreaInCell(mid, h) < target) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  return hi;
+}
+
+}  // namespace
+
+/**
+ * @brief Default options: same-size output, 8px cells, classic screen angles
+ */
+HalftoneOptions::HalftoneOptions() {
+  scale = 1;
+  cellSize = 8;
+  angle[0] = 15;
+  angle[1] = 75;
+  angle[2] = 0;
+  for (int c = 0; c < 3; c++) {
+    offset[c][0] = 0;
+    offset[c][1] = 0;
+  }
+  modulateRadius = true;
+  antialias = true;
+}
+
+/**
+ * @brief Construct a renderer and precompute its dot stamps
+ * @param options Screen parameters
+ */
+HalftoneRenderer::HalftoneRenderer(const HalftoneOptions& options)
+    : mOptions(options) {
+  mOptions.cellSize = std::max(1, mOptions.cellSize);
+  if (mOptions.modulateRadius) {
+    mStamps.reserve(kLevels);
+    for (int level = 0; level < kLevels; level++) {
+      float fraction = (float) level / (kLevels - 1);
+      mStamps.push_back(makeStamp(radiusForCoverage(fraction, mOptions.cellSize)));
+    }
+  } else {
+    mStamps.push_back(makeStamp(mOptions.cellSize / 2.0f));
+  }
+}
+
+/**
+ * @brief Get the options this renderer was built with
+ * @return Screen parameters
+ */
+const HalftoneOptions& HalftoneRenderer::options() const { return mOptions; }
+
+/**
+ * @brief Rasterize a dot of the given radius centered on the top left corner of pixel (origin, origin)
+ * @param radius Dot radius in output pixels
+ * @return Stamp holding the coverage of every pixel touched by the dot
+ */
+HalftoneRenderer::Stamp HalftoneRenderer::makeStamp(float radius) const {
+  Stamp stamp;
+  stamp.origin = (int) std::ceil(radius);
+  stamp.size = 2 * stamp.origin;
+  stamp.coverage.assign(stamp.size * stamp.size, 0);
+  int samples = mOptions.antialias ? kSupersample : 1;
+  float r2 = radius * radius;
+  for (int y = 0; y < stamp.size; y++) {
+    for (int x = 0; x < stamp.size; x++) {
+      int inside = 0;
+      for (int sy = 0; sy < samples; sy++) {
+        for (int sx = 0; sx < samples; sx++) {
+          float dx = x - stamp.origin + (sx + 0.5f) / samples;
+          float dy = y - stamp.origin + (sy + 0.5f) / samples;
+          if (dx * dx + dy * dy <= r2) {
+            inside++;
+          }
+        }
+      }
+      stamp.coverage[y * stamp.size + x] = (255 * inside) / (samples * samples);
+    }
+  }
+  return stamp;
+}
+
+/**
+ * @brief Render the given image into a new image
+ * @param source Image to screen
+ * @return Halftoned image of size (scale * width, scale * height)
+ */
+Image HalftoneRenderer::render(const Image& source) const {
+  Image out((int) (source.width() * mOptions.scale), (int) (source.height() * mOptions.scale));
+  render(source, out);
+  return out;
+}
+
+/**
+ * @brief Render the given image into an existing output image
+ * @param source Image to screen
+ * @param out Destination image, overwritten completely
+ */
+void HalftoneRenderer::render(const Image& source, Image& out) const {
+  memset(out.data(), 0, out.width() * out.height() * 3);
+  for (int c = 0; c < 3; c++) {
+    renderChannel(source, c, out);
+  }
+}
+
+/**
+ * @brief Blit the dots of one channel's screen into the output
+ * @param source Image to screen
+ * @param channel Channel index (0 = red, 1 = green, 2 = blue)
+ * @param out Destination image
+ */
+void HalftoneRenderer::renderChannel(const Image& source, int channel, Image& out) const {
+  const float cell = (float) mOptions.cellSize;
+  const float theta = mOptions.angle[channel] * kPi / 180.0f;
+  const float ux = std::cos(theta), uy = std::sin(theta);
+  const float vx = -uy, vy = ux;
+  const int offX = mOptions.offset[channel][0];
+  const int offY = mOptions.offset[channel][1];
+  const int outW = out.width(), outH = out.height();
+  const int srcW = source.width(), srcH = source.height();
+  const unsigned char* src = source.data();
+  unsigned char* dst = out.data();
+
+  // Screen cells whose dots can touch the output, found by projecting the
+  // (margin-padded) output corners onto the screen axes
+  int margin = mStamps.back().origin + 1;
+  float cornersX[4] = {(float) -margin - offX, (float) outW + margin - offX,
+                       (float) -margin - offX, (float) outW + margin - offX};
+  float cornersY[4] = {(float) -margin - offY, (float) -margin - offY,
+                       (float) outH + margin - offY, (float) outH + margin - offY};
+  float minU = 1e30f, maxU = -1e30f, minV = 1e30f, maxV = -1e30f;
+  for (int k = 0; k < 4; k++) {
+    float u = cornersX[k] * ux + cornersY[k] * uy;
+    float v = cornersX[k] * vx + cornersY[k] * vy;
+    minU = std::min(minU, u);
+    maxU = std::max(maxU, u);
+    minV = std::min(minV, v);
+    maxV = std::max(maxV, v);
+  }
+  int i0 = (int) std::floor(minU / cell) - 1, i1 = (int) std::ceil(maxU / cell);
+  int j0 = (int) std::floor(minV / cell) - 1, j1 = (int) std::ceil(maxV / cell);
+
+  // Sample grid covering one cell's footprint in the source
+  float footprint = cell / mOptions.scale;
+  int taps = std::min(4, std::max(1, (int) std::lround(footprint)));
+
+  for (int j = j0; j <= j1; j++) {
+    for (int i = i0; i <= i1; i++) {
+      float px = ((i + 0.5f) * ux + (j + 0.5f) * vx) * cell;
+      float py = ((i + 0.5f) * uy + (j + 0.5f) * vy) * cell;
+
+      float sx0 = px / mOptions.scale - footprint / 2;
+      float sy0 = py / mOptions.scale - footprint / 2;
+      int sum = 0, count = 0;
+      for (int ty = 0; ty < taps; ty++) {
+        int sy = (int) std::floor(sy0 + (ty + 0.5f) * footprint / taps);
+        if (sy < 0 || sy >= srcH) continue;
+        for (int tx = 0; tx < taps; tx++) {
+          int sx = (int) std::floor(sx0 + (tx + 0.5f) * footprint / taps);
+          if (sx < 0 || sx >= srcW) continue;
+          sum += src[(sy * srcW + sx) * 3 + channel];
+          count++;
+        }
+      }
+      if (count == 0) continue;
+      int value = sum / count;
+
+      const Stamp* stamp;
+      int ink;
+      if (mOptions.modulateRadius) {
+        stamp = &mStamps[(value * (kLevels - 1) + 127) / 255];
+        ink = 255;
+      } else {
+        stamp = &mStamps[0];
+        ink = value;
+      }
+      if (ink == 0 || stamp->size == 0) continue;
+
+      int x0 = (int) std::lround(px) + offX - stamp->origin;
+      int y0 = (int) std::lround(py) + offY - stamp->origin;
+      int xStart = std::max(0, -x0), xEnd = std::min(stamp->size, outW - x0);
+      int yStart = std::max(0, -y0), yEnd = std::min(stamp->size, outH - y0);
+      for (int y = yStart; y < yEnd; y++) {
+        const unsigned char* coverage = &stamp->coverage[y * stamp->size];
+        unsigned char* row = dst + ((y0 + y) * outW + x0) * 3 + channel;
+        for (int x = xStart; x < xEnd; x++) {
+          unsigned char v = (unsigned char) ((coverage[x] * ink + 127) / 255);
+          if (v > row[x * 3]) {
+            row[x * 3] = v;
+          }
+        }
+      }
+    }
+  }
+}
+
+}  // namespace agl
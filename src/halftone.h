@@ -0,0 +1,83 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the declarations for the halftone (AM screening) renderer.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#ifndef AGL_HALFTONE_H_
+#define AGL_HALFTONE_H_
+
+#include <vector>
+#include "image.h"
+
+namespace agl {
+
+/**
+ * @brief Screen parameters for the halftone renderer
+ *
+ * Every channel is printed as its own screen of dots. Sizes and offsets are
+ * given in output pixels, angles in degrees.
+ */
+struct HalftoneOptions {
+  HalftoneOptions();
+
+  // Output size relative to the source image
+  float scale;
+
+  // Distance between neighbouring dots of a screen
+  int cellSize;
+
+  // Screen angle of the red, green and blue screens
+  float angle[3];
+
+  // Displacement {x, y} of the red, green and blue dots
+  int offset[3][2];
+
+  // true: dot area follows intensity (AM screening)
+  // false: fixed size dots tinted by intensity
+  bool modulateRadius;
+
+  // Use fractional coverage along the dot edges
+  bool antialias;
+};
+
+/**
+ * @brief Renders halftone screens directly into the output image
+ *
+ * Dot stamps are rasterized once per intensity level when the renderer is
+ * constructed. Rendering walks the (rotated) screen cells of each channel,
+ * samples the source under the cell and blits the matching stamp into that
+ * channel of the output, so no intermediate images are allocated.
+ */
+class HalftoneRenderer {
+ public:
+  explicit HalftoneRenderer(const HalftoneOptions& options);
+
+  // Return the options this renderer was built with
+  const HalftoneOptions& options() const;
+
+  // Render the given image into a new image of size (scale * width, scale * height)
+  Image render(const Image& source) const;
+
+  // Render the given image into out, which must already have the output size
+  void render(const Image& source, Image& out) const;
+
+ private:
+  struct Stamp {
+    int size;
+    int origin;
+    std::vector<unsigned char> coverage;
+  };
+
+  Stamp makeStamp(float radius) const;
+  void renderChannel(const Image& source, int channel, Image& out) const;
+
+  HalftoneOptions mOptions;
+  std::vector<Stamp> mStamps;
+};
+
+}  // namespace agl
+#endif  // AGL_HALFTONE_H_
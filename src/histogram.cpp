@@ -0,0 +1,381 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the definitions for image histograms, levels,
+* histogram equalization and CLAHE.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#include "histogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#include "image.h"
+#include "parallel.h"
+#include "trace.h"
+
+namespace agl {
+
+/**
+ * @brief Construct an empty histogram
+ */
+Histogram::Histogram() : total(0) {
+  memset(bins, 0, sizeof(bins));
+}
+
+/**
+ * @brief Add the counts of another histogram to this one
+ * @param other Histogram to add
+ */
+void Histogram::merge(const Histogram& other) {
+  for (int c = 0; c < 4; c++) {
+    for (int i = 0; i < 256; i++) {
+      bins[c][i] += other.bins[c][i];
+    }
+  }
+  total += other.total;
+}
+
+/**
+ * @brief Get the smallest value present in a channel
+ * @param channel Red, Green, Blue or Luma
+ * @return Smallest value, or 0 for an empty histogram
+ */
+int Histogram::min(int channel) const {
+  for (int i = 0; i < 256; i++) {
+    if (bins[channel][i]) return i;
+  }
+  return 0;
+}
+
+/**
+ * @brief Get the largest value present in a channel
+ * @param channel Red, Green, Blue or Luma
+ * @return Largest value, or 0 for an empty histogram
+ */
+int Histogram::max(int channel) const {
+  for (int i = 255; i >= 0; i--) {
+    if (bins[channel][i]) return i;
+  }
+  return 0;
+}
+
+/**
+ * @brief Get the mean value of a channel
+ * @param channel Red, Green, Blue or Luma
+ * @return Mean in [0, 255]
+ */
+float Histogram::mean(int channel) const {
+  if (total == 0) return 0;
+  double sum = 0;
+  for (int i = 0; i < 256; i++) {
+    sum += (double) i * bins[channel][i];
+  }
+  return (float) (sum / total);
+}
+
+/**
+ * @brief Get the value below which the given fraction of pixels fall
+ * @param channel Red, Green, Blue or Luma
+ * @param fraction Fraction in [0, 1]
+ * @return Smallest value v with cumulative count >= fraction * total
+ */
+int Histogram::percentile(int channel, float fraction) const {
+  double target = std::max(1.0, (double) fraction * total);
+  double cumulative = 0;
+  for (int i = 0; i < 256; i++) {
+    cumulative += bins[channel][i];
+    if (cumulative >= target) return i;
+  }
+  return 255;
+}
+
+/**
+ * @brief Compute the red, green, blue and luma histograms of a view
+ * @param view Source RGB view
+ * @return Histograms of every pixel in the view
+ */
+Histogram histogram(const ConstImageView& view) {
+  Histogram result;
+  std::mutex mergeMutex;
+  parallelFor(0, view.height(), [&](int rowBegin, int rowEnd) {
+    Histogram local;
+    for (int row = rowBegin; row < rowEnd; row++) {
+      const unsigned char* p = view.row(row);
+      for (int col = 0; col < view.width(); col++, p += view.pixelStride()) {
+        local.bins[0][p[0]]++;
+        local.bins[1][p[1]]++;
+        local.bins[2][p[2]]++;
+        local.bins[3][luma(p[0], p[1], p[2])]++;
+      }
+    }
+    local.total = (long) (rowEnd - rowBegin) * view.width();
+    std::lock_guard<std::mutex> lock(mergeMutex);
+    result.merge(local);
+  }, 16);
+  return result;
+}
+
+/**
+ * @brief Apply one lookup table per channel
+ * @param src Source RGB view
+ * @param dst Destination RGB view (may be src)
+ * @param lut Tables for red, green and blue
+ */
+void applyLut(const ConstImageView& src, const ImageView& dst, const unsigned char lut[3][256]) {
+  parallelFor(0, src.height(), [&](int rowBegin, int rowEnd) {
+    for (int row = rowBegin; row < rowEnd; row++) {
+      const unsigned char* in = src.row(row);
+      unsigned char* out = dst.row(row);
+      for (int col = 0; col < src.width(); col++) {
+        const unsigned char* p = in + col * src.pixelStride();
+        unsigned char* q = out + col * dst.pixelStride();
+        q[0] = lut[0][p[0]];
+        q[1] = lut[1][p[1]];
+        q[2] = lut[2][p[2]];
+      }
+    }
+  }, 16);
+}
+
+/**
+ * @brief Build a levels table
+ * @param black Input value mapped to 0
+ * @param white Input value mapped to 255
+ * @param gamma Midtone gamma
+ * @param lut Resulting table
+ */
+void levelsLut(int black, int white, float gamma, unsigned char lut[256]) {
+  white = std::max(white, black + 1);
+  for (int i = 0; i < 256; i++) {
+    float t = (float) (i - black) / (white - black);
+    t = std::min(1.0f, std::max(0.0f, t));
+    lut[i] = (unsigned char) std::lround(255 * std::pow(t, 1 / gamma));
+  }
+}
+
+/**
+ * @brief Estimate the gamma that brings the mean luma to mid gray
+ * @param hist Histogram of the image
+ * @return Gamma in [0.2, 5] for use with Image::gammaCorrect
+ */
+float estimateGamma(const Histogram& hist) {
+  float mean = hist.mean(Histogram::Luma) / 255.0f;
+  mean = std::min(0.99f, std::max(0.01f, mean));
+  float gamma = std::log(mean) / std::log(0.5f);
+  return std::min(5.0f, std::max(0.2f, gamma));
+}
+
+namespace {
+
+/**
+ * @brief Replace the luma of every pixel, scaling RGB to keep the chroma
+ * @param src Source RGB view
+ * @param dst Destination RGB view
+ * @param mapRow Called as mapRow(row, lumaIn, lumaOut) with one row of luma values
+ */
+template <typename F>
+void remapLuma(const ConstImageView& src, const ImageView& dst, F mapRow) {
+  int w = src.width();
+  parallelFor(0, src.height(), [&](int rowBegin, int rowEnd) {
+    std::vector<unsigned char> in(w), out(w);
+    for (int row = rowBegin; row < rowEnd; row++) {
+      const unsigned char* s = src.row(row);
+      for (int col = 0; col < w; col++, s += src.pixelStride()) {
+        in[col] = luma(s[0], s[1], s[2]);
+      }
+      mapRow(row, in.data(), out.data());
+      s = src.row(row);
+      unsigned char* d = dst.row(row);
+      for (int col = 0; col < w; col++, s += src.pixelStride(), d += dst.pixelStride()) {
+        int y = in[col], y2 = out[col];
+        if (y == 0) {
+          d[0] = d[1] = d[2] = y2;
+        } else {
+          d[0] = std::min(255, (s[0] * y2 + y / 2) / y);
+          d[1] = std::min(255, (s[1] * y2 + y / 2) / y);
+          d[2] = std::min(255, (s[2] * y2 + y / 2) / y);
+        }
+      }
+    }
+  }, 16);
+}
+
+/**
+ * @brief Turn a histogram into a clipped, equalizing lookup table
+ * @param bins 256 counts, clipped in place
+ * @param total Number of pixels counted
+ * @param clipLimit Largest bin height as a multiple of the average (<= 0 disables clipping)
+ * @param lut Resulting table
+ */
+void equalizingLut(unsigned int* bins, long total, float clipLimit, unsigned char lut[256]) {
+  if (total == 0) {
+    for (int i = 0; i < 256; i++) lut[i] = i;
+    return;
+  }
+  if (clipLimit > 0) {
+    unsigned int limit = std::max(1u, (unsigned int) (clipLimit * total / 256));
+    long excess = 0;
+    for (int i = 0; i < 256; i++) {
+      if (bins[i] > limit) {
+        excess += bins[i] - limit;
+        bins[i] = limit;
+      }
+    }
+    // hand the clipped counts back evenly
+    long share = excess / 256, rest = excess % 256;
+    for (int i = 0; i < 256; i++) {
+      bins[i] += share + (i < rest ? 1 : 0);
+    }
+  }
+  long cumulative = 0;
+  for (int i = 0; i < 256; i++) {
+    cumulative += bins[i];
+    lut[i] = (unsigned char) ((cumulative * 255 + total / 2) / total);
+  }
+}
+
+}  // namespace
+
+/**
+ * @brief Compute the red, green, blue and luma histograms of the image
+ * @return Histograms
+ */
+Histogram Image::histogram() const {
+  AGL_TRACE_SCOPE("Image::histogram", (long long) mWidth * mHeight);
+  return agl::histogram(view());
+}
+
+/**
+ * @brief Map the input range [black, white] to the full range with the given gamma
+ * @param black Input value that becomes 0
+ * @param white Input value that becomes 255
+ * @param gamma Midtone gamma (1 = linear)
+ * @return Adjusted image
+ */
+Image Image::levels(int black, int white, float gamma) const {
+  AGL_TRACE_SCOPE("Image::levels", (long long) mWidth * mHeight);
+  unsigned char lut[3][256];
+  levelsLut(black, white, gamma, lut[0]);
+  memcpy(lut[1], lut[0], 256);
+  memcpy(lut[2], lut[0], 256);
+  Image result(mWidth, mHeight);
+  applyLut(view(), result.view(), lut);
+  return result;
+}
+
+/**
+ * @brief Stretch the contrast so that the darkest and lightest pixels span the full range
+ * @param clip Fraction of pixels allowed to saturate at each end
+ * @param perChannel Stretch every channel separately (also corrects color casts)
+ * @return Adjusted image
+ */
+Image Image::autoLevels(float clip, bool perChannel) const {
+  AGL_TRACE_SCOPE("Image::autoLevels", (long long) mWidth * mHeight);
+  Histogram hist = agl::histogram(view());
+  unsigned char lut[3][256];
+  for (int c = 0; c < 3; c++) {
+    int channel = perChannel ? c : (int) Histogram::Luma;
+    levelsLut(hist.percentile(channel, clip), hist.percentile(channel, 1 - clip), 1, lut[c]);
+  }
+  Image result(mWidth, mHeight);
+  applyLut(view(), result.view(), lut);
+  return result;
+}
+
+/**
+ * @brief Gamma correct with the gamma that brings the mean luma to mid gray
+ * @return Corrected image
+ */
+Image Image::autoGamma() const {
+  AGL_TRACE_SCOPE("Image::autoGamma", (long long) mWidth * mHeight);
+  return gammaCorrect(estimateGamma(agl::histogram(view())));
+}
+
+/**
+ * @brief Equalize the luma histogram, keeping each pixel's chroma
+ * @return Equalized image
+ */
+Image Image::equalize() const {
+  AGL_TRACE_SCOPE("Image::equalize", (long long) mWidth * mHeight);
+  Histogram hist = agl::histogram(view());
+  unsigned char lut[256];
+  equalizingLut(hist.bins[Histogram::Luma], hist.total, 0, lut);
+  Image result(mWidth, mHeight);
+  remapLuma(view(), result.view(), [&](int, const unsigned char* in, unsigned char* out) {
+    for (int col = 0; col < mWidth; col++) {
+      out[col] = lut[in[col]];
+    }
+  });
+  return result;
+}
+
+/**
+ * @brief Contrast limited adaptive histogram equalization of the luma
+ * @param tiles Number of tiles along each axis
+ * @param clipLimit Largest histogram bin as a multiple of the average bin
+ * @return Equalized image
+ *
+ * Every tile gets its own clipped equalization table; pixels blend the
+ * tables of the four nearest tile centers bilinearly.
+ */
+Image Image::clahe(int tiles, float clipLimit) const {
+  AGL_TRACE_SCOPE("Image::clahe", (long long) mWidth * mHeight);
+  int tilesX = std::max(1, std::min(tiles, mWidth));
+  int tilesY = std::max(1, std::min(tiles, mHeight));
+  std::vector<unsigned char> luts(tilesX * tilesY * 256);
+  ConstImageView source = view();
+
+  parallelFor(0, tilesX * tilesY, [&](int tileBegin, int tileEnd) {
+    for (int t = tileBegin; t < tileEnd; t++) {
+      int tx = t % tilesX, ty = t / tilesX;
+      int x0 = tx * mWidth / tilesX, x1 = (tx + 1) * mWidth / tilesX;
+      int y0 = ty * mHeight / tilesY, y1 = (ty + 1) * mHeight / tilesY;
+      unsigned int bins[256] = {0};
+      for (int row = y0; row < y1; row++) {
+        const unsigned char* p = source.at(row, x0);
+        for (int col = x0; col < x1; col++, p += 3) {
+          bins[luma(p[0], p[1], p[2])]++;
+        }
+      }
+      equalizingLut(bins, (long) (x1 - x0) * (y1 - y0), clipLimit, &luts[t * 256]);
+    }
+  });
+
+  // per column tile pair and weight, shared by every row
+  float tileW = (float) mWidth / tilesX, tileH = (float) mHeight / tilesY;
+  std::vector<int> colTile0(mWidth), colTile1(mWidth);
+  std::vector<float> colWeight(mWidth);
+  for (int col = 0; col < mWidth; col++) {
+    float g = (col + 0.5f) / tileW - 0.5f;
+    int t0 = std::max(0, std::min(tilesX - 1, (int) std::floor(g)));
+    colTile0[col] = t0;
+    colTile1[col] = std::min(tilesX - 1, t0 + 1);
+    colWeight[col] = std::min(1.0f, std::max(0.0f, g - t0));
+  }
+
+  Image result(mWidth, mHeight);
+  remapLuma(source, result.view(), [&](int row, const unsigned char* in, unsigned char* out) {
+    float g = (row + 0.5f) / tileH - 0.5f;
+    int ty0 = std::max(0, std::min(tilesY - 1, (int) std::floor(g)));
+    int ty1 = std::min(tilesY - 1, ty0 + 1);
+    float fy = std::min(1.0f, std::max(0.0f, g - ty0));
+    const unsigned char* top = &luts[ty0 * tilesX * 256];
+    const unsigned char* bottom = &luts[ty1 * tilesX * 256];
+    for (int col = 0; col < mWidth; col++) {
+      int v = in[col];
+      float fx = colWeight[col];
+      float a = top[colTile0[col] * 256 + v] * (1 - fx) + top[colTile1[col] * 256 + v] * fx;
+      float b = bottom[colTile0[col] * 256 + v] * (1 - fx) + bottom[colTile1[col] * 256 + v] * fx;
+      out[col] = (unsigned char) (a * (1 - fy) + b * fy + 0.5f);
+    }
+  });
+  return result;
+}
+
+}  // namespace agl
@@ -0,0 +1,79 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the declarations for image histograms and the tone
+* adjustments built on them (levels, equalization and CLAHE).
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#ifndef AGL_HISTOGRAM_H_
+#define AGL_HISTOGRAM_H_
+
+#include "image_view.h"
+
+namespace agl {
+
+/**
+ * @brief 256 bin histograms of the red, green, blue and luma values of an image
+ */
+struct Histogram {
+  enum Channel { Red = 0, Green = 1, Blue = 2, Luma = 3 };
+
+  Histogram();
+
+  // Add the counts of another histogram to this one
+  void merge(const Histogram& other);
+
+  // Smallest and largest value that occurs in the channel
+  int min(int channel) const;
+  int max(int channel) const;
+
+  // Mean value of the channel
+  float mean(int channel) const;
+
+  // Smallest value v such that at least fraction of the pixels are <= v
+  int percentile(int channel, float fraction) const;
+
+  unsigned int bins[4][256];
+  long total;
+};
+
+// Integer BT.601 luma of an RGB color
+inline int luma(int r, int g, int b) { return (77 * r + 150 * g + 29 * b + 128) >> 8; }
+
+/**
+ * @brief Compute the histograms of an RGB view in one read pass
+ *
+ * Rows are split across the thread pool; every chunk counts into its own
+ * private bins, which are merged once the chunk is done.
+ */
+Histogram histogram(const ConstImageView& view);
+
+/**
+ * @brief Apply one 256 entry lookup table per channel
+ * @param src Source RGB view
+ * @param dst Destination RGB view of the same size (may be src)
+ * @param lut Tables for red, green and blue
+ */
+void applyLut(const ConstImageView& src, const ImageView& dst, const unsigned char lut[3][256]);
+
+/**
+ * @brief Build a levels table mapping [black, white] to [0, 255] with the given gamma
+ * @param black Input value that becomes 0
+ * @param white Input value that becomes 255
+ * @param gamma Midtone gamma (1 = linear)
+ * @param lut Resulting table
+ */
+void levelsLut(int black, int white, float gamma, unsigned char lut[256]);
+
+/**
+ * @brief Gamma that maps the mean luma of the histogram to mid gray
+ *
+ * The result can be passed straight to Image::gammaCorrect().
+ */
+float estimateGamma(const Histogram& hist);
+
+}  // namespace agl
+#endif  // AGL_HISTOGRAM_H_
@@ -8,19 +8,78 @@
 */
 
 #include "image.h"
+#include "composite.h"
+#include "fixed_point.h"
+#include "halftone.h"
+#include "kernel.h"
+#include "noise.h"
+#include "pyramid.h"
+#include "trace.h"
 
 #include <cassert>
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb/stb_image_write.h"
+// no global failure string, so images can be decoded on several threads at once
+#define STBI_NO_FAILURE_STRINGS
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb/stb_image.h"
 #include <cstring>
 #include <string>
 #include <cmath>
-#include <time.h>
+#include <limits>
+#include <new>
 
 namespace agl {
 
+namespace {
+
+const unsigned char kBlack[3] = {0, 0, 0};
+
+/**
+ * @brief Bytes of a width x height RGB buffer
+ *
+ * Computed in size_t, so a size whose int product would wrap fails with
+ * std::bad_array_new_length instead of allocating a smaller buffer.
+ */
+size_t pixelBytes(int width, int height) {
+  if (width < 0 || height < 0 ||
+      (width > 0 && (size_t) height > std::numeric_limits<size_t>::max() / 3 / width)) {
+    throw std::bad_array_new_length();
+  }
+  return (size_t) width * height * 3;
+}
+
+/**
+ * @brief Bilinear sample of packed RGB data at (y, x) pixels from the top left
+ * @param out The r, g, b samples written
+ *
+ * The arithmetic of Image::get_rel(): Q16.16 weights, and corners whose
+ * flat index falls outside the data read as black like Image::get().
+ */
+void sampleBilinear(const unsigned char* data, int width, int height, float y, float x,
+                    unsigned char* out) {
+  float x1 = std::floor(x), x2 = std::ceil(x);
+  float y1 = std::floor(y), y2 = std::ceil(y);
+  long long size = (long long) width * height * 3;
+  auto at = [=](float row, float col) {
+    long long i = ((long long) row * width + (int) col) * 3;
+    return i < 0 || i >= size ? kBlack : data + i;
+  };
+  const unsigned char* q11 = at(y1, x1);
+  const unsigned char* q12 = at(y1, x2);
+  const unsigned char* q21 = at(y2, x1);
+  const unsigned char* q22 = at(y2, x2);
+  // a zero weight reproduces the first sample exactly
+  int wx = fixed::toQ16(x - x1);
+  int wy = fixed::toQ16(y - y1);
+  for (int c = 0; c < 3; c++) {
+    out[c] = fixed::lerpQ16(fixed::lerpQ16(q11[c], q12[c], wx),
+                            fixed::lerpQ16(q21[c], q22[c], wx), wy);
+  }
+}
+
+}  // namespace
+
 /**
 * @brief Instantiate a new Pixel object with all channels set to 0
 */
@@ -64,39 +123,54 @@ bool Pixel::operator==(const Pixel& other){
 }
 
 /**
- * @brief Multiply two Pixel objects together using dot product
+ * @brief Multiply two Pixel objects together channel by channel
  * @param other The Pixel object to multiply by
- * @return A new Pixel object with the values of the two multiplied together (r1 * r2, g1 * g2, b1 * b2)
+ * @return A new Pixel object with channels round(c1 * c2 / 255), so white is the identity
  */
 Pixel Pixel::operator*(const Pixel& other){
-  return Pixel(this->r * other.r, this->g * other.g, this->b * other.b);
+  return Pixel(fixed::mulDiv255(this->r, other.r), fixed::mulDiv255(this->g, other.g),
+               fixed::mulDiv255(this->b, other.b));
 }
 
 /**
  * @brief Multiply a Pixel object by a scalar value
- * @param operand scalar value to multiply by
+ * @param operand scalar value to multiply by (negative counts as 0)
  * @return Pixel object with each channel multiplied by the scalar value
+ * in Q16.16, rounded and clipped to [0, 255]
  */
 Pixel Pixel::operator*(const float& operand) const{
-  return Pixel(std::round(this->r * operand), std::round(this->g * operand), std::round(this->b * operand));
+  int32_t s = fixed::toScaleQ16(operand);
+  return Pixel(fixed::scaleQ16(this->r, s), fixed::scaleQ16(this->g, s), fixed::scaleQ16(this->b, s));
 }
 
 /**
  * @brief Divide a Pixel object by a scalar value
  * @param operand scalar value to divide by
- * @return Pixel object with each channel divided by the scalar value
+ * @return Pixel object with each channel multiplied by 1 / operand
+ * in Q16.16, rounded and clipped to [0, 255]
  */
 Pixel Pixel::operator/(const float& operand){
-  return Pixel(std::round(this->r / operand), std::round(this->g / operand), std::round(this->b / operand));
+  return *this * (1 / operand);
 }
 
 /**
  * @brief Add two Pixel objects together
  * @param other The Pixel object to add
- * @return A new Pixel object with the values of the two added together (r1 + r2, g1 + g2, b1 + b2)
+ * @return A new Pixel object with the values of the two added together, clipped at 255
  */
 Pixel Pixel::operator+(const Pixel& other){
-  return Pixel(std::min(255, this->r + other.r), std::min(255, this->g + other.g), std::min(255, this->b + other.b));
+  return Pixel(fixed::addSat(this->r, other.r), fixed::addSat(this->g, other.g),
+               fixed::addSat(this->b, other.b));
+}
+
+/**
+ * @brief Subtract one Pixel object from another
+ * @param other The Pixel object to subtract
+ * @return A new Pixel object with the differences, clipped at 0
+ */
+Pixel Pixel::operator-(const Pixel& other){
+  return Pixel(fixed::subSat(this->r, other.r), fixed::subSat(this->g, other.g),
+               fixed::subSat(this->b, other.b));
 }
 
 /**
@@ -127,7 +201,9 @@ Image::Image(int width, int height) {
   if(mData != NULL){
     delete[] mData;
   }
-  mData = new unsigned char[width * height * mChannels];
+  mData = new unsigned char[pixelBytes(width, height)];
+  trace::recordAllocation(pixelBytes(width, height));
+  mDirty = Rect{0, 0, mWidth, mHeight};
 }
 
 /**
@@ -141,8 +217,24 @@ Image::Image(const Image& orig) {
   if(mData != NULL){
     delete[] mData;
   }
-  mData = new unsigned char[mWidth * mHeight * mChannels];
-  memcpy(mData, orig.data(), mWidth * mHeight * mChannels);
+  mData = new unsigned char[pixelBytes(mWidth, mHeight)];
+  trace::recordAllocation(pixelBytes(mWidth, mHeight));
+  memcpy(mData, orig.data(), pixelBytes(mWidth, mHeight));
+  mDirty = orig.mDirty;
+}
+
+/**
+ * @brief Construct a new Image object by copying the pixels of a view
+ * @param view The RGB view to copy
+ */
+Image::Image(const ConstImageView& view) {
+  mWidth = view.width();
+  mHeight = view.height();
+  mChannels = 3;
+  mData = new unsigned char[pixelBytes(mWidth, mHeight)];
+  trace::recordAllocation(pixelBytes(mWidth, mHeight));
+  copy(view, rawView());
+  mDirty = Rect{0, 0, mWidth, mHeight};
 }
 
 /**
@@ -152,14 +244,20 @@ Image::Image(const Image& orig) {
  */
 Image& Image::operator=(const Image& orig) {
   if (this != &orig) {
-    mWidth = orig.mWidth;
-    mHeight = orig.mHeight;
     mChannels = orig.mChannels;
-    if(mData != NULL){
-      delete[] mData;
+    // keep the buffer when the pixel count matches
+    size_t bytes = pixelBytes(orig.mWidth, orig.mHeight);
+    if (mData == NULL || bytes != pixelBytes(mWidth, mHeight)) {
+      if(mData != NULL){
+        delete[] mData;
+      }
+      mData = new unsigned char[bytes];
+      trace::recordAllocation(bytes);
     }
-    mData = new unsigned char[mWidth * mHeight * mChannels];
-    memcpy(mData, orig.data(), mWidth * mHeight * mChannels);
+    mWidth = orig.mWidth;
+    mHeight = orig.mHeight;
+    memcpy(mData, orig.data(), bytes);
+    invalidate();
   }
   return *this;
 }
@@ -185,11 +283,71 @@ int Image::width() const { return mWidth; }
  */
 int Image::height() const { return mHeight; }
 
+/**
+ * @brief Get the image data as an array of unsigned chars, to write
+ * @return The image data as an array of unsigned chars
+ */
+unsigned char* Image::data() {
+  invalidate();
+  return mData;
+}
+
 /**
  * @brief Get the image data as an array of unsigned chars
  * @return The image data as an array of unsigned chars
  */
-unsigned char* Image::data() const { return mData; }
+const unsigned char* Image::data() const { return mData; }
+
+/**
+ * @brief Get a writable view of the whole image, marking it all changed
+ * @return View sharing this image's memory
+ */
+ImageView Image::view() {
+  invalidate();
+  return rawView();
+}
+
+/**
+ * @brief Get a view of the whole image, to read
+ * @return View sharing this image's memory
+ */
+ConstImageView Image::view() const {
+  return rawView();
+}
+
+/**
+ * @brief Drop the cached pyramid after the pixels change
+ */
+void Image::invalidate() {
+  mGeneration++;
+  mPyramid.reset();
+  mDirty = Rect{0, 0, mWidth, mHeight};
+}
+
+/**
+ * @brief Drop the cached pyramid after some pixels change
+ * @param region Changed rectangle (clipped to the image)
+ */
+void Image::invalidate(const Rect& region) {
+  mGeneration++;
+  mPyramid.reset();
+  mDirty = unite(mDirty, intersect(region, Rect{0, 0, mWidth, mHeight}));
+}
+
+/**
+ * @brief Get the bounding box of the pixels changed since the last clearDirty()
+ * @return Changed rectangle, empty if nothing changed
+ */
+Rect Image::dirtyRect() const {
+  return mDirty;
+}
+
+/**
+ * @brief Forget the changes recorded so far
+ */
+void Image::clearDirty() {
+  mDirty = Rect{0, 0, 0, 0};
+}
 
 /**
  * @brief Replace the image data with new data
@@ -198,12 +356,30 @@ unsigned char* Image::data() const { return mData; }
  * @param data 
  */
 void Image::set(int width, int height, unsigned char* data) {
+  pixelBytes(width, height);  // throws before taking ownership of data
   mWidth = width;
   mHeight = height;
   if(mData != NULL){
     delete[] mData;
   }
   mData = data;
+  invalidate();
+}
+
+/**
+ * @brief Move pixels decoded by stb into image memory
+ *
+ * stb allocates with malloc, so the rows are copied into memory the Image
+ * destructor can delete[] and the stb buffer is freed. Flipping here
+ * instead of through stb's global flag keeps loading thread-safe.
+ */
+static void copyDecoded(unsigned char* pixels, int width, int height, bool flip,
+                        unsigned char* out) {
+  for (int row = 0; row < height; row++) {
+    int from = flip ? height - 1 - row : row;
+    memcpy(out + (size_t) row * width * 3, pixels + (size_t) from * width * 3, width * 3);
+  }
+  stbi_image_free(pixels);
 }
 
 /**
@@ -213,20 +389,74 @@ void Image::set(int width, int height, unsigned char* data) {
  * @return true if the image was loaded successfully, false otherwise
  */
 bool Image::load(const std::string& filename, bool flip) {
+  trace::Scope scope("Image::load");
   int width, height, channels;
-  stbi_set_flip_vertically_on_load(flip);
-  if(mData != NULL){
-    delete[] mData;
+  unsigned char* pixels = stbi_load(filename.c_str(), &width, &height, &channels, 3);
+  if (pixels == NULL || mData == NULL ||
+      pixelBytes(width, height) != pixelBytes(mWidth, mHeight)) {
+    if(mData != NULL){
+      delete[] mData;
+      mData = NULL;
+    }
+    mWidth = 0;
+    mHeight = 0;
+    mChannels = 3;
+    invalidate();
+    if (pixels == NULL) {
+      return false;
+    }
+    mData = new unsigned char[pixelBytes(width, height)];
+    trace::recordAllocation(pixelBytes(width, height));
   }
-  mData = stbi_load(filename.c_str(), &width, &height, &channels, 3);
+  // an image of the same size (e.g. the previous frame) keeps its buffer
   mWidth = width;
   mHeight = height;
-  mChannels = channels;
-  if (mData != NULL) {
-    return true;
-  } else {
+  scope.setPixels((long long) width * height);
+  copyDecoded(pixels, width, height, flip, mData);
+  invalidate();
+  return true;
+}
+
+/**
+ * @brief Load an image from a file at a given size
+ * @param filename Path to source file
+ * @param width Target width
+ * @param height Target height
+ * @param flip Whether to flip the image vertically
+ * @return true if the image was loaded successfully, false otherwise
+ */
+bool Image::load(const std::string& filename, int width, int height, bool flip) {
+  trace::Scope scope("Image::load");
+  int fileWidth, fileHeight, channels;
+  if (!stbi_info(filename.c_str(), &fileWidth, &fileHeight, &channels)) {
+    return load(filename, flip);
+  }
+  // largest JPEG scale (1/2^shift) that still covers the target
+  int shift = 0;
+  while (shift < 3 &&
+         ((fileWidth + (2 << shift) - 1) >> (shift + 1)) >= width &&
+         ((fileHeight + (2 << shift) - 1) >> (shift + 1)) >= height) {
+    shift++;
+  }
+
+  if(mData != NULL){
+    delete[] mData;
+    mData = NULL;
+  }
+  mWidth = 0;
+  mHeight = 0;
+  mChannels = 3;
+  invalidate();
+  int w, h;
+  unsigned char* pixels = stbi_load_jpeg_scaled(filename.c_str(), &w, &h, &channels, 3, shift);
+  if (pixels == NULL) {
     return false;
   }
+  scope.setPixels((long long) w * h);
+  Image decoded(w, h);
+  copyDecoded(pixels, w, h, flip, decoded.mData);
+  *this = (w == width && h == height) ? decoded : decoded.resize(width, height);
+  return true;
 }
 
 /**
@@ -236,8 +466,12 @@ bool Image::load(const std::string& filename, bool flip) {
  * @return true if the image was saved successfully, false otherwise
  */
 bool Image::save(const std::string& filename, bool flip) const {
+  AGL_TRACE_SCOPE("Image::save", (long long) mWidth * mHeight);
+  // stb's flip flag is global, so flip a copy to keep save thread-safe
+  if (flip) {
+    return flipVertical().save(filename, false);
+  }
   std::string ext = filename.substr(filename.find_last_of(".") + 1);
-  stbi_flip_vertically_on_write(flip);
   for (int i = 0; i < ext.length(); i++) {
     ext[i] = std::tolower(ext[i]);
   }
@@ -269,8 +503,8 @@ bool Image::save(const std::string& filename, bool flip) const {
  * @return The pixel at the given row and column
  */
 Pixel Image::get(int row, int col) const {
-  int i = (row * mWidth + col) * 3;
-  if(i < 0 || i >= mWidth * mHeight * 3){
+  long long i = ((long long) row * mWidth + col) * 3;
+  if(i < 0 || i >= (long long) mWidth * mHeight * 3){
     return Pixel{0, 0, 0};
   }
   return Pixel{mData[i], mData[i + 1], mData[i + 2]};
@@ -289,39 +523,9 @@ Pixel Image::get_rel(float yPercent, float xPercent, std::string method) const {
     return get(row, col);
   }
   else if(method == "bilinear"){
-    float y = yPercent * mHeight;
-    float x = xPercent * mWidth;
-
-    float x1 = std::floor(x);
-    float x2 = std::ceil(x);
-    float y1 = std::floor(y);
-    float y2 = std::ceil(y);
-
-    Pixel Q11 = get(y1, x1);
-    Pixel Q12 = get(y1, x2);
-    Pixel Q21 = get(y2, x1);
-    Pixel Q22 = get(y2, x2);
-
-    Pixel P1;
-    Pixel P2;
-    if(x1 == x2){
-      P1 = Q11;
-      P2 = Q21;
-    }
-    else {
-      P1 = (Q11 * (x2 - x)) + (Q12 * (x - x1));
-      P2 = (Q21 * (x2 - x)) + (Q22 * (x - x1));
-    }
-
-    Pixel P;
-    if(y1 == y2){
-      P = P1;
-    }
-    else {
-      P = (P1 * (y2 - y)) + (P2 * (y - y1));
-    }
-
-    return P;
+    unsigned char out[3];
+    sampleBilinear(mData, mWidth, mHeight, yPercent * mHeight, xPercent * mWidth, out);
+    return Pixel(out[0], out[1], out[2]);
   }
   else {
     std::cerr << "Error: \"" << method << "\" is not a sampling method" << std::endl;
@@ -336,7 +540,12 @@ Pixel Image::get_rel(float yPercent, float xPercent, std::string method) const {
  * @param color The color to set the pixel to
  */
 void Image::set(int row, int col, const Pixel& color) {
-  int i = (row * mWidth + col) * 3;
+  // inside the recorded change with no pyramid to drop there is nothing new
+  // to record, so loops of set() only pay for it about once per row
+  if (mPyramid || !mDirty.contains(col, row)) {
+    invalidate(Rect{col, row, 1, 1});
+  }
+  size_t i = ((size_t) row * mWidth + col) * 3;
   mData[i] = color.r;
   mData[i + 1] = color.g;
   mData[i + 2] = color.b;
@@ -365,13 +574,26 @@ void Image::set(int i, const Pixel& c) {
  * @param w 
  * @param h 
  * @return Image 
+ *
+ * When shrinking by half or more, sampling starts from the smallest pyramid
+ * level that is still at least w x h instead of the full resolution image.
  */
 Image Image::resize(int w, int h) const {
+  AGL_TRACE_SCOPE("Image::resize", (long long) mWidth * mHeight);
+  const Image* source = this;
+  std::shared_ptr<const ImagePyramid> levels;
+  if (2 * w <= mWidth && 2 * h <= mHeight) {
+    levels = pyramid();
+    int i = levels->nearestLevel(w, h);
+    if (i > 0) source = &levels->level(i);
+  }
   Image result(w, h);
+  int sw = source->width(), sh = source->height();
   for(int row = 0; row < h; row++){
+    PixelSpan out = result.row(row);
+    float y = (float) row / h * sh;
     for(int col = 0; col < w; col++){
-      Pixel p = get_rel((float) row / h, (float) col / w, "bilinear");
-      result.set(row, col, p);
+      sampleBilinear(source->data(), sw, sh, y, (float) col / w * sw, out[col]);
     }
   }
   return result;
@@ -382,10 +604,13 @@ Image Image::resize(int w, int h) const {
  * @return Image 
  */
 Image Image::flipHorizontal() const {
+  AGL_TRACE_SCOPE("Image::flipHorizontal", (long long) mWidth * mHeight);
   Image result(mWidth, mHeight);
   for(int row = 0; row < mHeight; row++){
+    ConstPixelSpan in = this->row(row);
+    PixelSpan out = result.row(row);
     for(int col = 0; col < mWidth; col++){
-      result.set(row, col, get(row, mWidth - col - 1));
+      memcpy(out[col], in[mWidth - col - 1], 3);
     }
   }
   return result;
@@ -396,11 +621,10 @@ Image Image::flipHorizontal() const {
  * @return Image 
  */
 Image Image::flipVertical() const {
+  AGL_TRACE_SCOPE("Image::flipVertical", (long long) mWidth * mHeight);
   Image result(mWidth, mHeight);
-  for(int col = 0; col < mWidth; col++){
-    for(int row = 0; row < mHeight; row++){
-      result.set(row, col, get(mHeight - row - 1, col));
-    }
+  for(int row = 0; row < mHeight; row++){
+    memcpy(result.row(row).data(), this->row(mHeight - row - 1).data(), mWidth * 3);
   }
   return result;
 }
@@ -411,31 +635,41 @@ Image Image::flipVertical() const {
  * @return Image 
  */
 Image Image::rotate90() const {
+  AGL_TRACE_SCOPE("Image::rotate90", (long long) mWidth * mHeight);
   Image result(mHeight, mWidth);
+  ImageView out = result.rawView();  // result is new, so already dirty all over
   for(int row = 0; row < mHeight; row++){
+    ConstPixelSpan in = this->row(row);
     for(int col = 0; col < mWidth; col++){
-      result.set(col, mHeight - row - 1, get(row, col));
+      memcpy(out.at(col, mHeight - row - 1), in[col], 3);
     }
   }
   return result;
 }
 
 /**
- * @brief Extract a subimage from the image starting at the given position and with the given width and height
+ * @brief Get a view of the region starting at the given position and with the given width and height
  * @param startx 
  * @param starty 
  * @param w 
  * @param h 
- * @return Image 
+ * @return View of the region, clipped to the image
  */
-Image Image::subimage(int startx, int starty, int w, int h) const {
-  Image sub(w, h);
-  for(int row = starty; row < starty + h; row++){
-    for(int col = startx; col < startx + w; col++){
-      sub.set(row - starty, col - startx, get(row, col));
-    }
-  }
-  return sub;
+ConstImageView Image::subimage(int startx, int starty, int w, int h) const {
+  return view().subview(startx, starty, w, h);
+}
+
+/**
+ * @brief Get a writable view of a region, marking it changed
+ * @param startx 
+ * @param starty 
+ * @param w 
+ * @param h 
+ * @return View of the region, clipped to the image
+ */
+ImageView Image::subimage(int startx, int starty, int w, int h) {
+  invalidate(Rect{startx, starty, w, h});
+  return rawView().subview(startx, starty, w, h);
 }
 
 /**
@@ -445,14 +679,32 @@ Image Image::subimage(int startx, int starty, int w, int h) const {
  * @param starty 
  */
 void Image::replace(const Image& image, int startx, int starty) {
-  for(int row = starty; row < starty + image.mHeight; row++){
-    for(int col = startx; col < startx + image.mWidth; col++){
-      set(row, col, image.get(row - starty, col - startx));
-    }
-  }
+  Rect area = intersect(Rect{startx, starty, image.width(), image.height()},
+                        Rect{0, 0, mWidth, mHeight});
+  AGL_TRACE_SCOPE("Image::replace", (long long) area.width * area.height);
+  CompositeOptions options;
+  options.op = CompositeOp::Source;
+  agl::composite(image.view(), rawView(), startx, starty, options);
+  invalidate(area);
+}
+
+/**
+ * @brief Composite the given image onto this one starting at the given position
+ * @param image The source image
+ * @param startx 
+ * @param starty 
+ * @param options Porter-Duff operator, alpha planes, mask and opacity
+ */
+void Image::composite(const Image& image, int startx, int starty, const CompositeOptions& options) {
+  Rect area = intersect(Rect{startx, starty, image.width(), image.height()},
+                        Rect{0, 0, mWidth, mHeight});
+  AGL_TRACE_SCOPE("Image::composite", (long long) area.width * area.height);
+  agl::composite(image.view(), rawView(), startx, starty, options);
+  invalidate(area);
 }
 
 Image Image::swirl() const {
+  AGL_TRACE_SCOPE("Image::swirl", (long long) mWidth * mHeight);
   Image result(0, 0);
   return result;
 }
@@ -464,71 +716,44 @@ Image Image::swirl() const {
  * @return Sum of the two images
  */
 Image Image::add(const Image& other) const {
+  AGL_TRACE_SCOPE("Image::add", (long long) mWidth * mHeight);
   Image result(width(), height());
-  for(int row = 0; row < height(); row++){
-    for(int col = 0; col < width(); col++){
-      Pixel p1 = get(row, col);
-      Pixel p2 = other.get(row, col);
-      Pixel p3 = p1 + p2;
-      result.set(row, col, p3);
-    }
-  }
+  agl::add(view(), other.view(), result.view());
   return result;
 }
 
 Image Image::subtract(const Image& other) const {
+  AGL_TRACE_SCOPE("Image::subtract", (long long) mWidth * mHeight);
   Image result(0, 0);
 
   return result;
 }
 
 Image Image::multiply(const Image& other) const {
+  AGL_TRACE_SCOPE("Image::multiply", (long long) mWidth * mHeight);
   Image result(0, 0);
 
   return result;
 }
 
 Image Image::difference(const Image& other) const {
+  AGL_TRACE_SCOPE("Image::difference", (long long) mWidth * mHeight);
   Image result(0, 0);
 
   return result;
 }
 
 Image Image::lightest(const Image& other) const {
+  AGL_TRACE_SCOPE("Image::lightest", (long long) mWidth * mHeight);
   Image result(mWidth, mHeight);
-  for(int row = 0; row < mHeight; row++){
-    for(int col = 0; col < mWidth; col++){
-      Pixel p1 = get(row, col);
-      Pixel p2 = other.get(row, col);
-      float v1 = sqrt((int)p1.r * p1.r + (int)p1.g * p1.g + (int)p1.b * p1.b);
-      float v2 = sqrt((int)p2.r * p2.r + (int)p2.g * p2.g + (int)p2.b * p2.b);
-      if(v2 > v1){
-        result.set(row, col, p2);
-      }
-      else {
-        result.set(row, col, p1);
-      }
-    }
-  }
+  agl::lightest(view(), other.view(), result.view());
   return result;
 }
 
 Image Image::darkest(const Image& other) const {
+  AGL_TRACE_SCOPE("Image::darkest", (long long) mWidth * mHeight);
   Image result(mWidth, mHeight);
-  for(int row = 0; row < mHeight; row++){
-    for(int col = 0; col < mWidth; col++){
-      Pixel p1 = get(row, col);
-      Pixel p2 = other.get(row, col);
-      float v1 = sqrt((int)p1.r * p1.r + (int)p1.g * p1.g + (int)p1.b * p1.b);
-      float v2 = sqrt((int)p2.r * p2.r + (int)p2.g * p2.g + (int)p2.b * p2.b);
-      if(v2 < v1){
-        result.set(row, col, p2);
-      }
-      else {
-        result.set(row, col, p1);
-      }
-    }
-  }
+  agl::darkest(view(), other.view(), result.view());
   return result;
 }
 
@@ -538,22 +763,9 @@ Image Image::darkest(const Image& other) const {
  * @return Corrected image 
  */
 Image Image::gammaCorrect(float gamma) const {
+  AGL_TRACE_SCOPE("Image::gammaCorrect", (long long) mWidth * mHeight);
   Image result(mWidth, mHeight);
-  for(int row = 0; row < mHeight; row++){
-    for(int col = 0; col < mWidth; col++){
-      Pixel p = get(row, col);
-      float r_tmp = p.r / 255.0;
-      float g_tmp = p.g / 255.0;
-      float b_tmp = p.b / 255.0;
-      r_tmp = std::pow(r_tmp, 1/gamma);
-      g_tmp = std::pow(g_tmp, 1/gamma);
-      b_tmp = std::pow(b_tmp, 1/gamma);
-      p.r = r_tmp * 255.0;
-      p.g = g_tmp * 255.0;
-      p.b = b_tmp * 255.0;
-      result.set(row, col, p);
-    }
-  }
+  agl::gammaCorrect(view(), result.view(), gamma);
   return result;
 }
 
@@ -564,15 +776,9 @@ Image Image::gammaCorrect(float gamma) const {
  * @return Blended image 
  */
 Image Image::alphaBlend(const Image& other, float alpha) const {
+  AGL_TRACE_SCOPE("Image::alphaBlend", (long long) mWidth * mHeight);
   Image result(mWidth, mHeight);
-  for(int row = 0; row < mHeight; row++){
-    for(int col = 0; col < mWidth; col++){
-      Pixel p1 = get(row, col);
-      Pixel p2 = other.get(row, col);
-      p1 = p1 * (1 - alpha) + p2 * alpha;
-      result.set(row, col, p1);
-    }
-  }
+  agl::alphaBlend(view(), other.view(), result.view(), alpha);
   return result;
 }
 
@@ -582,16 +788,9 @@ Image Image::alphaBlend(const Image& other, float alpha) const {
  * @return Inverted image 
  */
 Image Image::invert() const {
+  AGL_TRACE_SCOPE("Image::invert", (long long) mWidth * mHeight);
   Image result(mWidth, mHeight);
-  for(int row = 0; row < mHeight; row++){
-    for(int col = 0; col < mWidth; col++){
-      Pixel p = get(row, col);
-      p.r = 255 - p.r;
-      p.g = 255 - p.g;
-      p.b = 255 - p.b;
-      result.set(row, col, p);
-    }
-  }
+  agl::invert(view(), result.view());
   return result;
 }
 
@@ -600,17 +799,9 @@ Image Image::invert() const {
  * @return Grayscale image 
  */
 Image Image::grayscale() const {
+  AGL_TRACE_SCOPE("Image::grayscale", (long long) mWidth * mHeight);
   Image result(mWidth, mHeight);
-  for(int row = 0; row < mHeight; row++){
-    for(int col = 0; col < mWidth; col++){
-      Pixel p = get(row, col);
-      float value = 0.3 * p.r + 0.59 * p.g + 0.11 * p.b;
-      p.r = value;
-      p.g = value;
-      p.b = value;
-      result.set(row, col, p);
-    }
-  }
+  agl::grayscale(view(), result.view());
   return result;
 }
 
@@ -621,18 +812,26 @@ Image Image::grayscale() const {
  * @return Jittered image 
  */
 Image Image::colorJitter(int size) const {
-  Image image(mWidth, mHeight);
-  srand(time(NULL));
-  Pixel delta = Pixel((rand() % 255), (rand() % 255), (rand() % 255));
+  return colorJitter(size, CounterRng::freshSeed());
+}
+
+/**
+ * @brief Color jitter the image by an amount drawn from a seed
+ * @param size Degree of jitter
+ * @param seed Noise seed; the same seed gives the same image
+ * @return Jittered image
+ */
+Image Image::colorJitter(int size, uint64_t seed) const {
+  AGL_TRACE_SCOPE("Image::colorJitter", (long long) mWidth * mHeight);
+  CounterRng rng(seed);
+  Pixel delta = Pixel(rng.below(0, 255), rng.below(1, 255), rng.below(2, 255));
   delta = (delta / 255.0) * size;
-  for(int row = 0; row < mHeight; row++){
-    for(int col = 0; col < mWidth; col++){
-      Pixel p = get(row, col);
-      p = p + delta;
-      image.set(row, col, p);
-    }
-  }
-  return image;
+  const unsigned char d[3] = {delta.r, delta.g, delta.b};
+  return transform([d](const unsigned char* in, unsigned char* out) {
+    out[0] = fixed::addSat(in[0], d[0]);
+    out[1] = fixed::addSat(in[1], d[1]);
+    out[2] = fixed::addSat(in[2], d[2]);
+  });
 }
 
 // Part 2: Operator 4
@@ -644,16 +843,9 @@ Image Image::colorJitter(int size) const {
  * @return Shifted image 
  */
 Image Image::channelShift(int rShift[2], int gShift[2], int bShift[2]) const {
+  AGL_TRACE_SCOPE("Image::channelShift", (long long) mWidth * mHeight);
   Image result(mWidth, mHeight);
-  for(int col = 0; col < mWidth; col++){
-    for(int row = 0; row < mHeight; row++){
-      Pixel rSource = get(row + rShift[1], col + rShift[0]);
-      Pixel gSource = get(row + gShift[1], col + gShift[0]);
-      Pixel bSource = get(row + bShift[1], col + bShift[0]);
-      Pixel p = Pixel(rSource.r, gSource.g, bSource.b);
-      result.set(row, col, p);
-    }
-  }
+  agl::channelShift(view(), result.view(), rShift, gShift, bShift);
   return result;
 }
 
@@ -666,30 +858,30 @@ Image Image::channelShift(int rShift[2], int gShift[2], int bShift[2]) const {
  * @return Halftoned image 
  */
 Image Image::halftone(int rShift[2], int gShift[2], int bShift[2]) const {
-  int scale_factor = 2;
-  int enlarge_factor = 4;
-  Image downsampled = resize(mWidth / scale_factor, mHeight / scale_factor);
-  Image dots(mWidth * enlarge_factor, mHeight * enlarge_factor);
-  for(int col = 0; col < dots.width(); col++){
-    for(int row = 0; row < dots.height(); row++){
-      Pixel p = Pixel(0, 0, 0);
-      dots.set(row, col, p);
-    }
-  }
-  for(int col = 0; col < downsampled.width(); col++){
-    for(int row = 0; row < downsampled.height(); row++){
-      Pixel p = downsampled.get(row, col);
-      int r = (scale_factor * enlarge_factor) / 2;
-      for(int x = 0; x < scale_factor * enlarge_factor; x++){
-        for(int y = 0; y < scale_factor * enlarge_factor; y++){
-          if((x - r) * (x - r) + (y - r) * (y - r) <= r * r){
-            dots.set(row * scale_factor * enlarge_factor + y, col * scale_factor * enlarge_factor + x, p);
-          }
-        }
-      }
-    }
+  AGL_TRACE_SCOPE("Image::halftone", (long long) mWidth * mHeight);
+  HalftoneOptions options;
+  options.scale = 4;
+  options.cellSize = 8;
+  options.modulateRadius = false;
+  options.antialias = false;
+  int* shifts[3] = {rShift, gShift, bShift};
+  for(int c = 0; c < 3; c++){
+    options.angle[c] = 0;
+    options.offset[c][0] = -shifts[c][0];
+    options.offset[c][1] = -shifts[c][1];
   }
-  return dots.channelShift(rShift, gShift, bShift);
+  return halftone(options);
+}
+
+/**
+ * @brief Render an AM halftone screen of the image
+ * @param options Screen parameters (cell size, angle and offset per channel)
+ * @return Halftoned image of size (scale * width, scale * height)
+ */
+Image Image::halftone(const HalftoneOptions& options) const {
+  AGL_TRACE_SCOPE("Image::halftone", (long long) mWidth * mHeight);
+  HalftoneRenderer renderer(options);
+  return renderer.render(*this);
 }
 
 // Part 2: Operator 6
@@ -701,22 +893,9 @@ Image Image::halftone(int rShift[2], int gShift[2], int bShift[2]) const {
  * @return Color replaced image 
  */
 Image Image::colorReplace(const Pixel& oldColor, const Pixel& newColor, int tolerance) const {
+  AGL_TRACE_SCOPE("Image::colorReplace", (long long) mWidth * mHeight);
   Image image(mWidth, mHeight);
-  int r_diff, g_diff, b_diff, diff;
-  float alpha = 1;
-  for(int row = 0; row < mHeight; row++){
-    for(int col = 0; col < mWidth; col++){
-      Pixel p = get(row, col);
-      r_diff = abs(p.r - oldColor.r);
-      g_diff = abs(p.g - oldColor.g);
-      b_diff = abs(p.b - oldColor.b);
-      diff = sqrt(r_diff * r_diff + g_diff * g_diff + b_diff * b_diff);
-      if(diff <= tolerance){
-        p = (newColor * alpha) + (p * (1 - alpha));
-      }
-      image.set(row, col, p);
-    }
-  }
+  agl::colorReplace(view(), image.view(), oldColor, newColor, tolerance);
   return image;
 }
 
@@ -739,32 +918,17 @@ void *normalize(const Pixel& p, float *normalized){
  * @param kSize width of kernel
  */
 void Image::convolve(float *kernel, int kSize, float *out) const {
-  memset(out, 0, mWidth * mHeight * 3 * sizeof(float));
-  int padding = (kSize - 1) / 2;
-  int outWidth = (mWidth - kSize + (2 * padding)) + 1;
-  // int outHeight = (mHeight - kSize + (2 * padding)) + 1;
-  int outRow = 0;
-  int outCol = 0;
-  for(int imageRow = 0 - padding; imageRow < 0 - padding + mHeight; imageRow++){
-    for(int imageCol = 0 - padding; imageCol < 0 - padding + mWidth; imageCol++){
-      float rSum = 0;
-      float gSum = 0;
-      float bSum = 0;
-      for(int kernelRow = 0; kernelRow < kSize; kernelRow++){
-        for(int kernelCol = 0; kernelCol < kSize; kernelCol++){
-          rSum += get(imageRow + kernelRow, imageCol + kernelCol).r * kernel[kernelRow * kSize + kernelCol];
-          gSum += get(imageRow + kernelRow, imageCol + kernelCol).g * kernel[kernelRow * kSize + kernelCol];
-          bSum += get(imageRow + kernelRow, imageCol + kernelCol).b * kernel[kernelRow * kSize + kernelCol];
-        }
-      }
-      out[(outRow * outWidth * 3) + (outCol * 3) + 0] = rSum;
-      out[(outRow * outWidth * 3) + (outCol * 3) + 1] = gSum;
-      out[(outRow * outWidth * 3) + (outCol * 3) + 2] = bSum;
-      outCol++;
-    }
-    outCol = 0;
-    outRow++;
-  }
+  convolve(Kernel(kernel, kSize), out);
+}
+
+/**
+ * @brief Performs convolution on the image with a decomposed kernel and places the result in "out"
+ * @param kernel Kernel to correlate with
+ * @param out 1D array of floats to store the result of the convolution
+ */
+void Image::convolve(const Kernel& kernel, float *out) const {
+  AGL_TRACE_SCOPE("Image::convolve", (long long) mWidth * mHeight);
+  kernel.apply(view(), out);
 }
 
 /**
@@ -800,12 +964,7 @@ Image arrToImage(float *arr, int width, int height) {
    }
 
    Image newImage = Image(width, height);
-   for(int row = 0; row < newImage.height(); row++){
-      for(int col = 0; col < newImage.width(); col++){
-         Pixel p = Pixel(outChar[row*width*3 + col*3], outChar[row*width*3 + col*3 + 1], outChar[row*width*3 + col*3 + 2]);
-         newImage.set(row, col, p);
-      }
-   }
+   memcpy(newImage.data(), outChar, width * height * 3);
    return newImage;
 }
 
@@ -815,23 +974,16 @@ Image arrToImage(float *arr, int width, int height) {
  * @return Filtered image 
  */
 Image Image::sobel() const {
-  float horizontal_kernel[9] = {
-    -1,0,1,
-    -2,0,2,
-    -1,0,1
-  };
-
-  float vertical_kernel[9] = {
-    -1,-2,-1,
-    0,0,0,
-    1,2,1
-  };
+  AGL_TRACE_SCOPE("Image::sobel", (long long) mWidth * mHeight);
+  // both are rank 1; decomposed once
+  static const Kernel horizontal_kernel({1, 2, 1}, {-1, 0, 1});
+  static const Kernel vertical_kernel({-1, 0, 1}, {1, 2, 1});
 
   float *out_horizontal = new float[mWidth * mHeight * 3];
   float *out_vertical = new float[mWidth * mHeight * 3];
 
-  convolve(horizontal_kernel, 3, out_horizontal);
-  convolve(vertical_kernel, 3, out_vertical);
+  convolve(horizontal_kernel, out_horizontal);
+  convolve(vertical_kernel, out_vertical);
 
   Image horizontal_result = arrToImage(out_horizontal, mWidth, mHeight);
   Image vertical_result = arrToImage(out_vertical, mWidth, mHeight);
@@ -850,30 +1002,18 @@ Image Image::sobel() const {
  * @return Blurred image
  */
 Image Image::gaussianBlur(float sigma) const {
-  int kSize = 2 * ceil(3 * sigma) + 1;
-  float *kernel = new float[kSize * kSize];
-  float sum = 0;
-  for(int row = 0; row < kSize; row++){
-    for(int col = 0; col < kSize; col++){
-      kernel[row * kSize + col] = exp(-((row - kSize/2) * (row - kSize/2) + (col - kSize/2) * (col - kSize/2)) / (2 * sigma * sigma));
-      sum += kernel[row * kSize + col];
-    }
-  }
-  for(int row = 0; row < kSize; row++){
-    for(int col = 0; col < kSize; col++){
-      kernel[row * kSize + col] /= sum;
-    }
-  }
+  AGL_TRACE_SCOPE("Image::gaussianBlur", (long long) mWidth * mHeight);
   float *out = new float[mWidth * mHeight * 3];
-  convolve(kernel, kSize, out);
+  convolve(Kernel::gaussian(sigma), out);
   Image result = arrToImage(out, mWidth, mHeight);
-  delete[] kernel;
   delete[] out;
   return result;
 }
 
 Image Image::expandOutlines(int iterations) const {
+  AGL_TRACE_SCOPE("Image::expandOutlines", (long long) mWidth * mHeight);
   Image result(*this);
+  ImageView out = result.rawView();  // result is new, so already dirty all over
 
   for(int k = 0; k < iterations; k++){
     int nColorPixels = 0;
@@ -896,7 +1036,7 @@ Image Image::expandOutlines(int iterations) const {
         for(int colOffset = -1; colOffset <= 1; colOffset++){
           if(row + rowOffset >= 0 && row + rowOffset < mHeight && col + colOffset >= 0 && col + colOffset < mWidth){
             if(result.get(row + rowOffset, col + colOffset).r < 10 && result.get(row + rowOffset, col + colOffset).g < 10 && result.get(row + rowOffset, col + colOffset).b < 10){
-              result.set(row + rowOffset, col + colOffset, result.get(row, col));
+              memcpy(out.at(row + rowOffset, col + colOffset), out.at(row, col), 3);
             }
           }
         }
@@ -907,11 +1047,20 @@ Image Image::expandOutlines(int iterations) const {
 }
 
 Image Image::bitmap(int size) const {
+  AGL_TRACE_SCOPE("Image::bitmap", (long long) mWidth * mHeight);
   Image image(0, 0);
 
   return image;
 }
 
-void Image::fill(const Pixel& c) {}
+/**
+ * @brief Fill the image with a color
+ * @param c Fill color
+ */
+void Image::fill(const Pixel& c) {
+  AGL_TRACE_SCOPE("Image::fill", (long long) mWidth * mHeight);
+  agl::fill(rawView(), c);
+  invalidate();
+}
 
 }  // namespace agl
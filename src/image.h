@@ -10,11 +10,24 @@
 #ifndef AGL_IMAGE_H_
 #define AGL_IMAGE_H_
 
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <string>
+#include "image_view.h"
 
 namespace agl {
 
+struct HalftoneOptions;
+struct CompositeOptions;
+struct Histogram;
+class ImagePyramid;
+class Kernel;
+class Region;
+
 /**
  * @brief Holder for a RGB color
  *
@@ -29,6 +42,7 @@ class Pixel {
   Pixel operator*(const float& operand) const;
   Pixel operator/(const float& operand);
   Pixel operator+(const Pixel& other);
+  Pixel operator-(const Pixel& other);
   int *toArray();
 
   unsigned char r;
@@ -36,6 +50,49 @@ class Pixel {
   unsigned char b;
 };
 
+/**
+ * @brief One row of an Image: width() packed RGB pixels
+ *
+ * Indexing is inline and unchecked (columns are asserted in debug builds),
+ * so loops over a span compile to plain pointer arithmetic. Like a view, a
+ * span shares the image's memory. PixelSpan can write it and ConstPixelSpan
+ * only reads it (see Image::row()).
+ */
+template <class Sample>
+class BasicPixelSpan {
+ public:
+  BasicPixelSpan(Sample* data, int width) : mData(data), mWidth(width) {}
+
+  int width() const { return mWidth; }
+  Sample* data() const { return mData; }
+
+  // Samples r, g, b of the pixel at col
+  Sample* operator[](int col) const {
+    assert(col >= 0 && col < mWidth);
+    return mData + 3 * col;
+  }
+
+  Pixel get(int col) const {
+    const unsigned char* p = (*this)[col];
+    return Pixel(p[0], p[1], p[2]);
+  }
+
+  // Writable spans only
+  void set(int col, const Pixel& color) const {
+    unsigned char* p = (*this)[col];
+    p[0] = color.r;
+    p[1] = color.g;
+    p[2] = color.b;
+  }
+
+ private:
+  Sample* mData;
+  int mWidth;
+};
+
+typedef BasicPixelSpan<unsigned char> PixelSpan;
+typedef BasicPixelSpan<const unsigned char> ConstPixelSpan;
+
 /**
  * @brief Implements loading, modifying, and saving RGB images
  */
@@ -44,6 +101,8 @@ class Image {
   Image();
   Image(int width, int height);
   Image(const Image& orig);
+  Image(const ConstImageView& view);
+  Image(const ImageView& view) : Image(ConstImageView(view)) {}
   Image& operator=(const Image& orig);
 
   virtual ~Image();
@@ -57,6 +116,18 @@ class Image {
    */
   bool load(const std::string& filename, bool flip = false);
 
+  /**
+   * @brief Load the given filename resized to width x height
+   * @param filename The file to load, relative to the running directory
+   * @param width The width to resize to
+   * @param height The height to resize to
+   * @param flip Whether the file should flipped vertally when loaded
+   *
+   * JPEGs are decoded directly at 1/2, 1/4 or 1/8 size when that is still
+   * at least width x height, so only the remaining factor is resampled.
+   */
+  bool load(const std::string& filename, int width, int height, bool flip = false);
+
   /**
    * @brief Save the image to the given filename (.png)
    * @param filename The file to load, relative to the running directory
@@ -75,9 +146,95 @@ class Image {
   /**
    * @brief Return the RGB data
    *
-   * Data will have size width * height * 4 (RGB)
+   * Data will have size width * height * 4 (RGB). Writable data marks the
+   * whole image changed (see view()), so read a non-const image through a
+   * const reference.
+   */
+  unsigned char* data();
+  const unsigned char* data() const;
+
+  /**
+   * @brief Return row i as a span of pixels
+   * @param i The row (value between 0 and height - 1, asserted in debug builds)
+   *
+   * The fast path for per-pixel loops: get() and set() compute the offset
+   * and call out of line for every pixel. As with view(), the span of a
+   * non-const image marks its row changed when it is taken, and the span of
+   * a const image is for reading only.
+   */
+  PixelSpan row(int i) {
+    assert(i >= 0 && i < mHeight);
+    invalidate(Rect{0, i, mWidth, 1});
+    return PixelSpan(mData + (long) i * mWidth * 3, mWidth);
+  }
+  ConstPixelSpan row(int i) const {
+    assert(i >= 0 && i < mHeight);
+    return ConstPixelSpan(mData + (long) i * mWidth * 3, mWidth);
+  }
+
+  // Call f(p) on the r, g, b samples of every pixel in place (see agl::forEachPixel)
+  template <class F>
+  void forEachPixel(F f) {
+    agl::forEachPixel(rawView(), f);
+    invalidate();
+  }
+
+  // New image with f(in, out) run on every pixel's samples (see agl::transform)
+  template <class F>
+  Image transform(F f) const {
+    Image result(mWidth, mHeight);
+    agl::transform(view(), result.view(), f);
+    return result;
+  }
+
+  /**
+   * @brief Return a view of the whole image
+   *
+   * The view shares this image's memory and is invalidated when the image is
+   * reallocated (set(width, height, data), or a load or assignment that
+   * changes the pixel count).
+   *
+   * Taking a view of a non-const image marks every pixel changed, since it
+   * may be written; a const image gives a read-only ConstImageView, so read
+   * a non-const image through a const reference. The
+   * change is recorded when the view is taken, so writes made through it
+   * after the image has been used again (e.g. resize() rebuilt the pyramid)
+   * need their own invalidate().
+   */
+  ImageView view();
+  ConstImageView view() const;
+
+  /**
+   * @brief Return the Gaussian pyramid of this image (see pyramid.h)
+   *
+   * The pyramid is built on first use and kept until the image is modified.
+   * Copies of the image build their own.
+   */
+  std::shared_ptr<const ImagePyramid> pyramid() const;
+
+  /**
+   * @brief Drop cached data derived from the pixels and mark them all dirty
+   *
+   * Image methods and the writable accessors call this themselves; call it
+   * after writing through a view again later (see view()).
+   */
+  void invalidate();
+
+  // invalidate() after changing only the given rectangle
+  void invalidate(const Rect& region);
+
+  /**
+   * @brief Bounding box of the pixels changed since the last clearDirty()
+   *
+   * Covers set(), replace(), composite(), fill(), loads and assignment;
+   * a new image is dirty all over.
+   * Pass it to Graph::update() so only derived tiles that depend on the
+   * change are recomputed.
    */
-  unsigned char* data() const;
+  Rect dirtyRect() const;
+
+  // Start recording changes afresh
+  void clearDirty();
 
   /**
    * @brief Replace image RGB data
@@ -94,21 +251,25 @@ class Image {
    * @param row The row (value between 0 and height)
    * @param col The col (value between 0 and width)
    *
-   * Pixel colors are unsigned char, e.g. in range 0 to 255
+   * Pixel colors are unsigned char, e.g. in range 0 to 255. Only the
+   * flat index row * width + col is checked: black past either end of the
+   * data, while a column out of range reads a neighbouring row. Use row()
+   * in loops.
    */
   Pixel get(int row, int col) const;
 
+  Pixel get_rel(float yPercent, float xPercent,
+                       std::string method) const;
+
   /**
-   * @brief Set the pixel RGBA color at index (row, col)
+   * @brief Set the pixel RGB color at index (row, col)
    * @param row The row (value between 0 and height)
    * @param col The col (value between 0 and width)
    *
-   * Pixel colors are unsigned char, e.g. in range 0 to 255
+   * Pixel colors are unsigned char, e.g. in range 0 to 255. Unchecked;
+   * marks the pixel dirty, which costs little once the pixel is already
+   * inside dirtyRect(). Use row() in loops.
    */
-
-  Pixel get_rel(float yPercent, float xPercent,
-                       std::string method) const;
-
   void set(int row, int col, const Pixel& color);
 
   /**
@@ -130,6 +291,9 @@ class Image {
   // resize the image
   Image resize(int width, int height) const;
 
+  // Content-aware resize that removes low energy seams (see seam.h)
+  Image seamCarve(int width, int height, int seamsPerPass = 1) const;
+
   // flip around the horizontal midline
   Image flipHorizontal() const;
 
@@ -139,13 +303,23 @@ class Image {
   // rotate the Image 90 degrees
   Image rotate90() const;
 
-  // Return a sub-Image having the given top,left coordinate and (width, height)
-  Image subimage(int x, int y, int w, int h) const;
+  // Return a view of the region having the given top,left coordinate and (width, height)
+  // The region is clipped to the image and shares its memory; assign the
+  // result to an Image to get an independent copy. As with view(), the
+  // region of a non-const image is marked changed and that of a const image
+  // is read-only
+  ImageView subimage(int x, int y, int w, int h);
+  ConstImageView subimage(int x, int y, int w, int h) const;
 
   // Replace the portion starting at (row, col) with the given image
   // Clamps the image if it doesn't fit on this image
   void replace(const Image& image, int x, int y);
 
+  // Composite the given image onto this one with its top left corner at (x, y)
+  // using a Porter-Duff operator, optional alpha planes and mask (see composite.h)
+  // Clamps the image if it doesn't fit on this image
+  void composite(const Image& image, int x, int y, const CompositeOptions& options);
+
   // swirl the colors
   Image swirl() const;
 
@@ -188,6 +362,24 @@ class Image {
   // Apply gamma correction
   Image gammaCorrect(float gamma) const;
 
+  // Compute red, green, blue and luma histograms (see histogram.h)
+  Histogram histogram() const;
+
+  // Map the input range [black, white] to [0, 255] with the given midtone gamma
+  Image levels(int black, int white, float gamma = 1) const;
+
+  // Stretch the range so only the given fraction of pixels clip at either end
+  Image autoLevels(float clip = 0.005f, bool perChannel = false) const;
+
+  // Apply gamma correction with a gamma estimated from the mean luma
+  Image autoGamma() const;
+
+  // Equalize the luma histogram
+  Image equalize() const;
+
+  // Contrast limited adaptive histogram equalization on a tiles x tiles grid
+  Image clahe(int tiles = 8, float clipLimit = 2.0f) const;
+
   // Apply the following calculation to the pixels in
   // our image and the given image:
   //    this.pixels = this.pixels * (1-alpha) + other.pixel * alpha
@@ -200,9 +392,24 @@ class Image {
   // Convert the image to grayscale
   Image grayscale() const;
 
-  // return a bitmap version of this image
+  // Add one random color of up to size levels to every pixel
   Image colorJitter(int size) const;
 
+  // colorJitter() with the color drawn from a seed (see noise.h)
+  Image colorJitter(int size, uint64_t seed) const;
+
+  // Add independent uniform noise in [-amount, amount] to every sample (see noise.h)
+  Image pixelJitter(int amount, uint64_t seed) const;
+
+  // Add monochrome Gaussian grain, strongest in the midtones (see noise.h)
+  Image filmGrain(float strength, uint64_t seed) const;
+
+  // Reduce every channel to levels values with a Bayer matrix (see noise.h)
+  Image orderedDither(int levels) const;
+
+  // Reduce every channel to levels values by error diffusion (see noise.h)
+  Image floydSteinberg(int levels) const;
+
   // return a bitmap version of this image
   Image bitmap(int size) const;
 
@@ -215,29 +422,78 @@ class Image {
   // Emulate a halftone print with channel shifted dots
   Image halftone(int rShift[2], int gShift[2], int bShift[2]) const;
 
+  // Render an AM halftone screen (see halftone.h) without intermediate images
+  Image halftone(const HalftoneOptions& options) const;
+
   // Replace all pixels with the given color within the given tolerance
   Image colorReplace(const Pixel& oldColor, const Pixel& newColor, int tolerance) const;
 
+  // Replace only the pixels connected to (row, col) within the given tolerance
+  // of its color (see components.h)
+  Image floodFill(int row, int col, const Pixel& newColor, int tolerance) const;
+
+  // Correlate with a square kernel into width * height * 3 floats, running
+  // separable kernels as 1D passes (see kernel.h)
   void convolve(float *kernel, int kSize, float *out) const;
 
+  // convolve() with a kernel whose decomposition is already known
+  void convolve(const Kernel& kernel, float *out) const;
+
   // Apply sobel filtering to the image
   Image sobel() const;
 
   // Apply a gaussian blur to the image
   Image gaussianBlur(float sigma) const;
 
+  // Apply a median filter over a (2 * radius + 1) square window (see median.h)
+  Image median(int radius) const;
+
+  // Smooth the image while preserving edges (see bilateral.h)
+  Image bilateral(float sigmaSpatial, float sigmaRange) const;
+
+  // Minimum / maximum over a (2 * rx + 1) x (2 * ry + 1) rectangle (see morphology.h)
+  Image erode(int rx, int ry) const;
+  Image dilate(int rx, int ry) const;
+
+  // Erode then dilate / dilate then erode with the same rectangle
+  Image open(int rx, int ry) const;
+  Image close(int rx, int ry) const;
+
   // Gives every black pixel the color of the nearest non-black pixel
   Image expandOutlines(int iterations) const;
 
   // Replace all pixels with the given hue within the given tolerance
   Image hueReplace(const Pixel& hue, const Pixel& newColor, int tolerance) const;
 
+  // Pointwise operation on views, e.g. invert(src, dst) from image_view.h
+  typedef std::function<void(const ConstImageView& src, const ImageView& dst)> ViewOp;
+
+  // Operation returning a new image of the same size, e.g. median()
+  typedef std::function<Image(const Image& in)> ImageOp;
+
+  // Run a pointwise operation on the pixels of a region only, in place (see region.h)
+  void apply(const Region& region, const ViewOp& op);
+
+  // Replace the pixels of a region with op's result on that part of the image,
+  // given halo pixels of context around it
+  void apply(const Region& region, const ImageOp& op, int halo);
+
+  // Copy of this image with op applied inside a region only
+  Image within(const Region& region, const ImageOp& op, int halo = 0) const;
+
  private:
+  // Writable view that records no change, for methods that record their own
+  ImageView rawView() const { return ImageView(mData, mWidth, mHeight, mWidth * 3); }
+
   // todo
   unsigned char* mData = NULL;
-  int mWidth;
-  int mHeight;
-  int mChannels;
+  int mWidth = 0;
+  int mHeight = 0;
+  int mChannels = 3;
+  uint64_t mGeneration = 0;  // bumped whenever the pixels may have changed under mPyramid
+  mutable std::shared_ptr<const ImagePyramid> mPyramid;
+  mutable std::atomic<uint64_t> mPyramidGeneration{0};  // generation mPyramid was built from
+  Rect mDirty = {0, 0, 0, 0};
 };
 }  // namespace agl
 #endif  // AGL_IMAGE_H_
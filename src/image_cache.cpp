@@ -0,0 +1,185 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the definitions for the decoded image cache.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#include "image_cache.h"
+
+#include <sys/stat.h>
+#include "image.h"
+
+namespace agl {
+
+namespace {
+
+/**
+ * @brief Modification time of a file in nanoseconds
+ *
+ * Whole seconds alone would miss a rewrite of the same size within one
+ * second. Where stat has no sub-second field only seconds are kept.
+ */
+long long modifiedTime(const struct stat& info) {
+#if defined(__APPLE__)
+  return (long long) info.st_mtimespec.tv_sec * 1000000000 + info.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+  return (long long) info.st_mtime * 1000000000;
+#else
+  return (long long) info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+}
+
+}  // namespace
+
+/**
+ * @brief Fraction of loads served without decoding
+ * @return Hit rate in [0, 1]
+ */
+double ImageCache::Stats::hitRate() const {
+  long total = hits + misses;
+  return total > 0 ? (double) hits / total : 0.0;
+}
+
+/**
+ * @brief Create an empty cache
+ * @param budgetBytes Most decoded bytes to keep
+ */
+ImageCache::ImageCache(size_t budgetBytes)
+    : mBudget(budgetBytes), mBytes(0), mSerial(0) {}
+
+/**
+ * @brief Get the decoded image for a file, loading it on a miss
+ * @param filename Path to source file
+ * @param flip Whether to flip the image vertically
+ * @return Shared handle, or null on failure
+ */
+std::shared_ptr<const Image> ImageCache::load(const std::string& filename, bool flip) {
+  struct stat info;
+  if (stat(filename.c_str(), &info) != 0) {
+    return Handle();
+  }
+  const long long mtime = modifiedTime(info);
+  const long long size = info.st_size;
+  const std::string key = (flip ? "1:" : "0:") + filename;
+
+  std::unique_lock<std::mutex> lock(mMutex);
+  auto it = mEntries.find(key);
+  if (it != mEntries.end()) {
+    Entry& entry = it->second;
+    if (entry.mtime == mtime && entry.size == size) {
+      mStats.hits++;
+      mLru.splice(mLru.begin(), mLru, entry.lru);
+      std::shared_future<Handle> image = entry.image;
+      lock.unlock();
+      return image.get();
+    }
+    // the file changed on disk
+    mBytes -= entry.bytes;
+    mLru.erase(entry.lru);
+    mEntries.erase(it);
+  }
+
+  mStats.misses++;
+  std::promise<Handle> promise;
+  const long serial = ++mSerial;
+  mLru.push_front(key);
+  Entry& entry = mEntries[key];
+  entry.mtime = mtime;
+  entry.size = size;
+  entry.image = promise.get_future().share();
+  entry.bytes = 0;
+  entry.serial = serial;
+  entry.lru = mLru.begin();
+  lock.unlock();
+
+  // decode without holding the lock; other callers for this key wait on the future
+  std::shared_ptr<Image> image = std::make_shared<Image>();
+  Handle handle;
+  if (image->load(filename, flip)) {
+    handle = image;
+  }
+  promise.set_value(handle);
+
+  lock.lock();
+  it = mEntries.find(key);
+  if (it != mEntries.end() && it->second.serial == serial) {
+    if (handle) {
+      it->second.bytes = sizeof(Image) + (size_t) handle->width() * handle->height() * 3;
+      mBytes += it->second.bytes;
+      evict();
+    } else {
+      mLru.erase(it->second.lru);
+      mEntries.erase(it);
+    }
+  }
+  return handle;
+}
+
+/**
+ * @brief Change the byte budget
+ * @param budgetBytes Most decoded bytes to keep
+ */
+void ImageCache::setBudget(size_t budgetBytes) {
+  std::lock_guard<std::mutex> lock(mMutex);
+  mBudget = budgetBytes;
+  evict();
+}
+
+size_t ImageCache::budget() const {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mBudget;
+}
+
+size_t ImageCache::bytes() const {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mBytes;
+}
+
+/**
+ * @brief Drop every entry
+ *
+ * Loads still decoding finish and return their image without caching it.
+ */
+void ImageCache::clear() {
+  std::lock_guard<std::mutex> lock(mMutex);
+  mEntries.clear();
+  mLru.clear();
+  mBytes = 0;
+}
+
+ImageCache::Stats ImageCache::stats() const {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mStats;
+}
+
+/**
+ * @brief Get the process wide cache
+ * @return Cache with the default budget
+ */
+ImageCache& ImageCache::global() {
+  static ImageCache cache;
+  return cache;
+}
+
+/**
+ * @brief Drop least recently used entries until the budget is met (lock held)
+ *
+ * Entries still being decoded are skipped.
+ */
+void ImageCache::evict() {
+  auto it = mLru.end();
+  while (mBytes > mBudget && it != mLru.begin()) {
+    --it;
+    auto entry = mEntries.find(*it);
+    if (entry->second.bytes == 0) continue;
+    mBytes -= entry->second.bytes;
+    mEntries.erase(entry);
+    it = mLru.erase(it);
+    mStats.evictions++;
+  }
+}
+
+}  // namespace agl
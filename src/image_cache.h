@@ -0,0 +1,101 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the declarations for the decoded image cache.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#ifndef AGL_IMAGE_CACHE_H_
+#define AGL_IMAGE_CACHE_H_
+
+#include <cstddef>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace agl {
+
+class Image;
+
+/**
+ * @brief Memory budgeted cache of decoded image files
+ *
+ * Entries are keyed by path and flip flag and remember the file's
+ * modification time and size, so a file that changes on disk is decoded
+ * again. Images are handed out as shared read-only handles that stay valid
+ * after eviction. When the decoded bytes exceed the budget the least
+ * recently used entries are dropped.
+ *
+ * All methods are thread-safe. Concurrent loads of the same file decode it
+ * once; the other callers wait for that decode and count as hits.
+ */
+class ImageCache {
+ public:
+  struct Stats {
+    long hits = 0;
+    long misses = 0;
+    long evictions = 0;
+
+    // hits / (hits + misses), or 0 before the first load
+    double hitRate() const;
+  };
+
+  // Create a cache that keeps at most budgetBytes of decoded pixels
+  explicit ImageCache(size_t budgetBytes = size_t(256) << 20);
+
+  ImageCache(const ImageCache&) = delete;
+  ImageCache& operator=(const ImageCache&) = delete;
+
+  /**
+   * @brief Get the decoded image for a file, loading it on a miss
+   * @param filename The file to load, relative to the running directory
+   * @param flip Whether the file should be flipped vertically when loaded
+   * @return Shared handle, or null if the file cannot be read or decoded
+   */
+  std::shared_ptr<const Image> load(const std::string& filename, bool flip = false);
+
+  // Change the budget, evicting entries if it shrank
+  void setBudget(size_t budgetBytes);
+  size_t budget() const;
+
+  // Decoded bytes currently held
+  size_t bytes() const;
+
+  // Drop every entry (outstanding handles stay valid)
+  void clear();
+
+  Stats stats() const;
+
+  // Cache shared by the whole process
+  static ImageCache& global();
+
+ private:
+  typedef std::shared_ptr<const Image> Handle;
+
+  struct Entry {
+    long long mtime;  // nanoseconds
+    long long size;
+    std::shared_future<Handle> image;
+    size_t bytes;     // 0 while the image is still being decoded
+    long serial;      // distinguishes a reloaded entry from the one it replaced
+    std::list<std::string>::iterator lru;
+  };
+
+  void evict();
+
+  mutable std::mutex mMutex;
+  std::unordered_map<std::string, Entry> mEntries;
+  std::list<std::string> mLru;  // most recently used first
+  size_t mBudget;
+  size_t mBytes;
+  long mSerial;
+  Stats mStats;
+};
+
+}  // namespace agl
+#endif  // AGL_IMAGE_CACHE_H_
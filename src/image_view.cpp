@@ -0,0 +1,431 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the method definitions for the image views and the operators
+* that work on views.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#include "image_view.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include "fft.h"
+#include "fixed_point.h"
+#include "image.h"
+
+namespace agl {
+
+/**
+ * @brief Overlap of two rectangles
+ * @return The shared pixels, or an empty rectangle
+ */
+Rect intersect(const Rect& a, const Rect& b) {
+  int x0 = std::max(a.x, b.x), y0 = std::max(a.y, b.y);
+  int x1 = std::min(a.x + a.width, b.x + b.width), y1 = std::min(a.y + a.height, b.y + b.height);
+  if (x1 <= x0 || y1 <= y0) return Rect{0, 0, 0, 0};
+  return Rect{x0, y0, x1 - x0, y1 - y0};
+}
+
+/**
+ * @brief Bounding box of two rectangles
+ * @return Smallest rectangle holding both; empty rectangles are ignored
+ */
+Rect unite(const Rect& a, const Rect& b) {
+  if (a.empty()) return b;
+  if (b.empty()) return a;
+  int x0 = std::min(a.x, b.x), y0 = std::min(a.y, b.y);
+  int x1 = std::max(a.x + a.width, b.x + b.width), y1 = std::max(a.y + a.height, b.y + b.height);
+  return Rect{x0, y0, x1 - x0, y1 - y0};
+}
+
+/**
+ * @brief Get the pixel at a given row and column
+ * @param row The row of the pixel
+ * @param col The column of the pixel
+ * @return The pixel, or black outside the view
+ */
+template <class Sample>
+Pixel BasicImageView<Sample>::get(int row, int col) const {
+  if (row < 0 || row >= mHeight || col < 0 || col >= mWidth) {
+    return Pixel(0, 0, 0);
+  }
+  const unsigned char* p = at(row, col);
+  if (mChannels == 1) {
+    return Pixel(p[0], p[0], p[0]);
+  }
+  return Pixel(p[0], p[1], p[2]);
+}
+
+/**
+ * @brief Set the pixel at a given row and column
+ * @param row The row of the pixel
+ * @param col The column of the pixel
+ * @param color The color to set the pixel to
+ */
+template <class Sample>
+void BasicImageView<Sample>::set(int row, int col, const Pixel& color) const {
+  if (row < 0 || row >= mHeight || col < 0 || col >= mWidth) {
+    return;
+  }
+  unsigned char* p = at(row, col);
+  p[0] = color.r;
+  if (mChannels == 3) {
+    p[1] = color.g;
+    p[2] = color.b;
+  }
+}
+
+/**
+ * @brief Get a rectangle of this view without copying
+ * @param x Left column of the rectangle
+ * @param y Top row of the rectangle
+ * @param w Width of the rectangle
+ * @param h Height of the rectangle
+ * @return View of the part of the rectangle that lies inside this view
+ */
+template <class Sample>
+BasicImageView<Sample> BasicImageView<Sample>::subview(int x, int y, int w, int h) const {
+  int x0 = std::max(0, x), y0 = std::max(0, y);
+  int x1 = std::min(mWidth, x + w), y1 = std::min(mHeight, y + h);
+  if (x1 <= x0 || y1 <= y0) {
+    return BasicImageView(mData, 0, 0, mRowStride, mPixelStride, mChannels);
+  }
+  return BasicImageView(at(y0, x0), x1 - x0, y1 - y0, mRowStride, mPixelStride, mChannels);
+}
+
+/**
+ * @brief Get one channel of this view without copying
+ * @param c Channel index (0 = red, 1 = green, 2 = blue)
+ * @return Single channel view
+ */
+template <class Sample>
+BasicImageView<Sample> BasicImageView<Sample>::channel(int c) const {
+  assert(c >= 0 && c < mChannels);
+  return BasicImageView(mData + c, mWidth, mHeight, mRowStride, mPixelStride, 1);
+}
+
+template class BasicImageView<unsigned char>;
+// a read-only view has everything but set()
+template Pixel BasicImageView<const unsigned char>::get(int row, int col) const;
+template ConstImageView BasicImageView<const unsigned char>::subview(int x, int y, int w,
+                                                                     int h) const;
+template ConstImageView BasicImageView<const unsigned char>::channel(int c) const;
+
+namespace {
+
+/**
+ * @brief Apply a per-sample lookup table from src to dst
+ */
+void mapSamples(const ConstImageView& src, const ImageView& dst, const unsigned char* lut) {
+  assert(src.width() == dst.width() && src.height() == dst.height());
+  assert(src.channels() == dst.channels());
+  int n = src.width() * src.channels();
+  for (int row = 0; row < src.height(); row++) {
+    const unsigned char* in = src.row(row);
+    unsigned char* out = dst.row(row);
+    if (src.packed() && dst.packed()) {
+      for (int i = 0; i < n; i++) {
+        out[i] = lut[in[i]];
+      }
+    } else {
+      for (int col = 0; col < src.width(); col++) {
+        for (int c = 0; c < src.channels(); c++) {
+          out[col * dst.pixelStride() + c] = lut[in[col * src.pixelStride() + c]];
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @brief Apply a per-pixel function to a pair of RGB views
+ *
+ * Pixels of a or b that fall outside their view are read as black, so the
+ * inputs may be smaller than dst.
+ */
+template <typename F>
+void mapPixels(const ConstImageView& a, const ConstImageView& b, const ImageView& dst, F f) {
+  assert(a.channels() == 3 && b.channels() == 3 && dst.channels() == 3);
+  static const unsigned char black[3] = {0, 0, 0};
+  for (int row = 0; row < dst.height(); row++) {
+    const unsigned char* pa = row < a.height() ? a.row(row) : NULL;
+    const unsigned char* pb = row < b.height() ? b.row(row) : NULL;
+    int aWidth = pa ? std::min(a.width(), dst.width()) : 0;
+    int bWidth = pb ? std::min(b.width(), dst.width()) : 0;
+    unsigned char* out = dst.row(row);
+    for (int col = 0; col < dst.width(); col++) {
+      f(col < aWidth ? pa + col * a.pixelStride() : black,
+        col < bWidth ? pb + col * b.pixelStride() : black,
+        out + col * dst.pixelStride());
+    }
+  }
+}
+
+}  // namespace
+
+/**
+ * @brief Copy one view into another
+ * @param src Source view
+ * @param dst Destination view of the same size and channel count
+ */
+void copy(const ConstImageView& src, const ImageView& dst) {
+  assert(src.width() == dst.width() && src.height() == dst.height());
+  assert(src.channels() == dst.channels());
+  for (int row = 0; row < src.height(); row++) {
+    const unsigned char* in = src.row(row);
+    unsigned char* out = dst.row(row);
+    if (src.packed() && dst.packed()) {
+      memmove(out, in, src.width() * 3);
+    } else {
+      for (int col = 0; col < src.width(); col++) {
+        for (int c = 0; c < src.channels(); c++) {
+          out[col * dst.pixelStride() + c] = in[col * src.pixelStride() + c];
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @brief Fill a view with a color
+ * @param dst Destination view
+ * @param color Fill color (single channel views use the red component)
+ */
+void fill(const ImageView& dst, const Pixel& color) {
+  const unsigned char rgb[3] = {color.r, color.g, color.b};
+  for (int row = 0; row < dst.height(); row++) {
+    unsigned char* out = dst.row(row);
+    for (int col = 0; col < dst.width(); col++) {
+      for (int c = 0; c < dst.channels(); c++) {
+        out[col * dst.pixelStride() + c] = rgb[c];
+      }
+    }
+  }
+}
+
+/**
+ * @brief Invert the samples of a view
+ * @param src Source view
+ * @param dst Destination view (may be src)
+ */
+void invert(const ConstImageView& src, const ImageView& dst) {
+  unsigned char lut[256];
+  for (int i = 0; i < 256; i++) {
+    lut[i] = 255 - i;
+  }
+  mapSamples(src, dst, lut);
+}
+
+/**
+ * @brief Convert a view to grayscale using a weighted average of channels
+ * @param src Source RGB view
+ * @param dst Destination RGB view (may be src)
+ */
+void grayscale(const ConstImageView& src, const ImageView& dst) {
+  mapPixels(src, src, dst, [](const unsigned char* p, const unsigned char*, unsigned char* out) {
+    float value = 0.3 * p[0] + 0.59 * p[1] + 0.11 * p[2];
+    out[0] = out[1] = out[2] = value;
+  });
+}
+
+/**
+ * @brief Gamma correct the samples of a view
+ * @param src Source view
+ * @param dst Destination view (may be src)
+ * @param gamma Gamma value
+ */
+void gammaCorrect(const ConstImageView& src, const ImageView& dst, float gamma) {
+  unsigned char lut[256];
+  for (int i = 0; i < 256; i++) {
+    float tmp = i / 255.0;
+    tmp = std::pow(tmp, 1/gamma);
+    lut[i] = tmp * 255.0;
+  }
+  mapSamples(src, dst, lut);
+}
+
+/**
+ * @brief Replace pixels of oldColor with newColor within the given tolerance
+ * @param src Source RGB view
+ * @param dst Destination RGB view (may be src)
+ * @param oldColor Color to replace
+ * @param newColor Color to replace with
+ * @param tolerance Largest euclidean RGB distance that still matches
+ */
+void colorReplace(const ConstImageView& src, const ImageView& dst,
+                  const Pixel& oldColor, const Pixel& newColor, int tolerance) {
+  // floor(sqrt(d2)) <= tolerance  <=>  d2 < (tolerance + 1)^2
+  long limit = tolerance < 0 ? 0 : (long) (tolerance + 1) * (tolerance + 1);
+  const int old[3] = {oldColor.r, oldColor.g, oldColor.b};
+  const unsigned char repl[3] = {newColor.r, newColor.g, newColor.b};
+  mapPixels(src, src, dst, [&](const unsigned char* p, const unsigned char*, unsigned char* out) {
+    int dr = p[0] - old[0], dg = p[1] - old[1], db = p[2] - old[2];
+    const unsigned char* value = (dr * dr + dg * dg + db * db < limit) ? repl : p;
+    out[0] = value[0];
+    out[1] = value[1];
+    out[2] = value[2];
+  });
+}
+
+/**
+ * @brief Blend two views
+ * @param a First view
+ * @param b Second view
+ * @param dst Destination view (may be a or b)
+ * @param alpha Weight of b, clamped to [0, 1] and rounded to Q8.8
+ */
+void alphaBlend(const ConstImageView& a, const ConstImageView& b, const ImageView& dst,
+                float alpha) {
+  int w = fixed::toQ8(alpha);
+  mapPixels(a, b, dst, [w](const unsigned char* p1, const unsigned char* p2, unsigned char* out) {
+    for (int c = 0; c < 3; c++) {
+      out[c] = fixed::lerpQ8(p1[c], p2[c], w);
+    }
+  });
+}
+
+/**
+ * @brief Add two views, clipping at 255
+ * @param a First view
+ * @param b Second view
+ * @param dst Destination view (may be a or b)
+ */
+void add(const ConstImageView& a, const ConstImageView& b, const ImageView& dst) {
+  mapPixels(a, b, dst, [](const unsigned char* p1, const unsigned char* p2, unsigned char* out) {
+    for (int c = 0; c < 3; c++) {
+      out[c] = fixed::addSat(p1[c], p2[c]);
+    }
+  });
+}
+
+/**
+ * @brief Keep the lighter (larger RGB magnitude) of two views per pixel
+ * @param a First view
+ * @param b Second view
+ * @param dst Destination view (may be a or b)
+ */
+void lightest(const ConstImageView& a, const ConstImageView& b, const ImageView& dst) {
+  mapPixels(a, b, dst, [](const unsigned char* p1, const unsigned char* p2, unsigned char* out) {
+    int v1 = p1[0] * p1[0] + p1[1] * p1[1] + p1[2] * p1[2];
+    int v2 = p2[0] * p2[0] + p2[1] * p2[1] + p2[2] * p2[2];
+    const unsigned char* p = v2 > v1 ? p2 : p1;
+    out[0] = p[0];
+    out[1] = p[1];
+    out[2] = p[2];
+  });
+}
+
+/**
+ * @brief Keep the darker (smaller RGB magnitude) of two views per pixel
+ * @param a First view
+ * @param b Second view
+ * @param dst Destination view (may be a or b)
+ */
+void darkest(const ConstImageView& a, const ConstImageView& b, const ImageView& dst) {
+  mapPixels(a, b, dst, [](const unsigned char* p1, const unsigned char* p2, unsigned char* out) {
+    int v1 = p1[0] * p1[0] + p1[1] * p1[1] + p1[2] * p1[2];
+    int v2 = p2[0] * p2[0] + p2[1] * p2[1] + p2[2] * p2[2];
+    const unsigned char* p = v2 < v1 ? p2 : p1;
+    out[0] = p[0];
+    out[1] = p[1];
+    out[2] = p[2];
+  });
+}
+
+/**
+ * @brief Displace the color channels of a view
+ * @param src Source RGB view
+ * @param dst Destination RGB view of the same size (must not overlap src)
+ * @param rShift {x, y} offset the red channel is read from
+ * @param gShift {x, y} offset the green channel is read from
+ * @param bShift {x, y} offset the blue channel is read from
+ *
+ * Samples read from outside src are black.
+ */
+void channelShift(const ConstImageView& src, const ImageView& dst,
+                  const int rShift[2], const int gShift[2], const int bShift[2]) {
+  assert(src.width() == dst.width() && src.height() == dst.height());
+  const int* shifts[3] = {rShift, gShift, bShift};
+  for (int c = 0; c < 3; c++) {
+    ConstImageView in = src.channel(c);
+    ImageView out = dst.channel(c);
+    int dx = shifts[c][0], dy = shifts[c][1];
+    int colStart = std::max(0, -dx), colEnd = std::min(dst.width(), src.width() - dx);
+    for (int row = 0; row < dst.height(); row++) {
+      unsigned char* o = out.row(row);
+      int srcRow = row + dy;
+      if (srcRow < 0 || srcRow >= src.height() || colEnd <= colStart) {
+        for (int col = 0; col < dst.width(); col++) {
+          o[col * out.pixelStride()] = 0;
+        }
+        continue;
+      }
+      const unsigned char* i = in.row(srcRow);
+      for (int col = 0; col < colStart; col++) {
+        o[col * out.pixelStride()] = 0;
+      }
+      for (int col = colStart; col < colEnd; col++) {
+        o[col * out.pixelStride()] = i[(col + dx) * in.pixelStride()];
+      }
+      for (int col = std::max(colStart, colEnd); col < dst.width(); col++) {
+        o[col * out.pixelStride()] = 0;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Correlate a view with a square kernel, treating pixels outside the view as black
+ * @param src Source RGB view
+ * @param kernel kSize * kSize weights, row major
+ * @param kSize Width of the kernel
+ * @param out Output of src.width() * src.height() * 3 floats
+ *
+ * Picks direct summation or the FFT (see fft.h) by estimated cost.
+ */
+void convolve(const ConstImageView& src, const float* kernel, int kSize, float* out) {
+  if (preferFFT(kSize, src.width(), src.height())) {
+    convolveFFT(src, kernel, kSize, out);
+  } else {
+    convolveDirect(src, kernel, kSize, out);
+  }
+}
+
+/**
+ * @brief Correlate a view with a square kernel by direct summation
+ * @param src Source RGB view
+ * @param kernel kSize * kSize weights, row major
+ * @param kSize Width of the kernel
+ * @param out Output of src.width() * src.height() * 3 floats
+ */
+void convolveDirect(const ConstImageView& src, const float* kernel, int kSize, float* out) {
+  int w = src.width(), h = src.height();
+  int padding = (kSize - 1) / 2;
+  memset(out, 0, (long) w * h * 3 * sizeof(float));
+  for (int row = 0; row < h; row++) {
+    float* o = out + (long) row * w * 3;
+    for (int kernelRow = 0; kernelRow < kSize; kernelRow++) {
+      int srcRow = row - padding + kernelRow;
+      if (srcRow < 0 || srcRow >= h) continue;
+      const unsigned char* in = src.row(srcRow);
+      for (int kernelCol = 0; kernelCol < kSize; kernelCol++) {
+        float weight = kernel[kernelRow * kSize + kernelCol];
+        int dx = kernelCol - padding;
+        int colStart = std::max(0, -dx), colEnd = std::min(w, w - dx);
+        const unsigned char* p = in + dx * src.pixelStride();
+        for (int col = colStart; col < colEnd; col++) {
+          o[col * 3 + 0] += p[col * src.pixelStride() + 0] * weight;
+          o[col * 3 + 1] += p[col * src.pixelStride() + 1] * weight;
+          o[col * 3 + 2] += p[col * src.pixelStride() + 2] * weight;
+        }
+      }
+    }
+  }
+}
+
+}  // namespace agl
@@ -0,0 +1,226 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the declarations for ImageView and the operators that
+* work on views.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#ifndef AGL_IMAGE_VIEW_H_
+#define AGL_IMAGE_VIEW_H_
+
+#include <cassert>
+#include <cstddef>
+
+namespace agl {
+
+class Pixel;
+
+/**
+ * @brief Rectangle of pixels: columns [x, x + width), rows [y, y + height)
+ */
+struct Rect {
+  int x;
+  int y;
+  int width;
+  int height;
+
+  bool empty() const { return width <= 0 || height <= 0; }
+
+  bool contains(int col, int row) const {
+    return col >= x && col < x + width && row >= y && row < y + height;
+  }
+};
+
+// Overlap of two rectangles (empty if they do not overlap)
+Rect intersect(const Rect& a, const Rect& b);
+
+// Smallest rectangle holding both (an empty rectangle adds nothing)
+Rect unite(const Rect& a, const Rect& b);
+
+/**
+ * @brief Non-owning window onto 8-bit pixel data
+ *
+ * A view is a pointer to the first sample plus a width, height, row stride
+ * and pixel stride (both in bytes). Views of a whole Image, of a rectangle
+ * of it, or of one of its channels all share the Image's memory, so the
+ * Image must outlive every view taken from it.
+ *
+ * A view has either 3 channels (RGB) or 1 channel (e.g. the red samples of
+ * an RGB image, which have a pixel stride of 3).
+ *
+ * ImageView can write the pixels and ConstImageView only reads them; a
+ * writable view converts to a read-only one, so operators take their
+ * inputs as ConstImageView (see Image::view()).
+ */
+template <class Sample>
+class BasicImageView {
+ public:
+  BasicImageView()
+      : mData(NULL), mWidth(0), mHeight(0), mRowStride(0), mPixelStride(3), mChannels(3) {}
+
+  /**
+   * @param data Pointer to the first sample of the top left pixel
+   * @param width Width of the view in pixels
+   * @param height Height of the view in pixels
+   * @param rowStride Distance between the starts of consecutive rows in bytes
+   * @param pixelStride Distance between consecutive pixels of a row in bytes
+   * @param channels Number of samples per pixel (1 or 3)
+   */
+  BasicImageView(Sample* data, int width, int height,
+                 int rowStride, int pixelStride = 3, int channels = 3)
+      : mData(data), mWidth(width), mHeight(height), mRowStride(rowStride),
+        mPixelStride(pixelStride), mChannels(channels) {}
+
+  // Read-only view of a writable one (the copy constructor of ImageView)
+  BasicImageView(const BasicImageView<unsigned char>& other)
+      : mData(other.data()), mWidth(other.width()), mHeight(other.height()),
+        mRowStride(other.rowStride()), mPixelStride(other.pixelStride()),
+        mChannels(other.channels()) {}
+
+  int width() const { return mWidth; }
+  int height() const { return mHeight; }
+  int rowStride() const { return mRowStride; }
+  int pixelStride() const { return mPixelStride; }
+  int channels() const { return mChannels; }
+  Sample* data() const { return mData; }
+  bool empty() const { return mWidth <= 0 || mHeight <= 0; }
+
+  // True when pixels are tightly packed RGB, so a row can be copied with memcpy
+  bool packed() const { return mChannels == 3 && mPixelStride == 3; }
+
+  // Pointer to the first sample of the given row (unchecked)
+  Sample* row(int i) const { return mData + (long) i * mRowStride; }
+
+  // Pointer to the first sample of the pixel at (row, col) (unchecked)
+  Sample* at(int row, int col) const {
+    return mData + (long) row * mRowStride + (long) col * mPixelStride;
+  }
+
+  /**
+   * @brief Get the pixel at (row, col)
+   *
+   * Returns black outside the view. Single channel views return a gray pixel.
+   */
+  Pixel get(int row, int col) const;
+
+  /**
+   * @brief Set the pixel at (row, col), writable views only
+   *
+   * Writes outside the view are ignored. Single channel views store the
+   * red component.
+   */
+  void set(int row, int col, const Pixel& color) const;
+
+  // Return the given rectangle of this view, clipped to the view bounds
+  BasicImageView subview(int x, int y, int w, int h) const;
+
+  // Return a single channel view (0 = red, 1 = green, 2 = blue)
+  BasicImageView channel(int c) const;
+
+ private:
+  Sample* mData;
+  int mWidth;
+  int mHeight;
+  int mRowStride;
+  int mPixelStride;
+  int mChannels;
+};
+
+typedef BasicImageView<unsigned char> ImageView;
+typedef BasicImageView<const unsigned char> ConstImageView;
+
+// Copy src into dst (sizes and channel counts must match)
+void copy(const ConstImageView& src, const ImageView& dst);
+
+// Fill every pixel of dst with the given color
+void fill(const ImageView& dst, const Pixel& color);
+
+// dst = 255 - src for every sample
+void invert(const ConstImageView& src, const ImageView& dst);
+
+// dst = weighted average of the RGB channels of src
+void grayscale(const ConstImageView& src, const ImageView& dst);
+
+// dst = 255 * (src / 255) ^ (1 / gamma) for every sample
+void gammaCorrect(const ConstImageView& src, const ImageView& dst, float gamma);
+
+// Replace pixels of src within tolerance of oldColor by newColor
+void colorReplace(const ConstImageView& src, const ImageView& dst,
+                  const Pixel& oldColor, const Pixel& newColor, int tolerance);
+
+// Operators taking two inputs work over the size of dst and read pixels
+// outside a smaller input as black.
+
+// dst = a * (1 - alpha) + b * alpha
+void alphaBlend(const ConstImageView& a, const ConstImageView& b, const ImageView& dst,
+                float alpha);
+
+// dst = a + b, clipped at 255
+void add(const ConstImageView& a, const ConstImageView& b, const ImageView& dst);
+
+// dst = the lighter of a and b for each pixel
+void lightest(const ConstImageView& a, const ConstImageView& b, const ImageView& dst);
+
+// dst = the darker of a and b for each pixel
+void darkest(const ConstImageView& a, const ConstImageView& b, const ImageView& dst);
+
+// dst channels are read from src displaced by the given {x, y} shifts
+void channelShift(const ConstImageView& src, const ImageView& dst,
+                  const int rShift[2], const int gShift[2], const int bShift[2]);
+
+/**
+ * @brief Call f(p) for every pixel of a view, row by row
+ *
+ * p points at the pixel's samples p[0] .. p[channels() - 1], which f may
+ * change in place. The loop covers exactly the view, so nothing is bounds
+ * checked; f is inlined and packed views run with a constant pixel stride,
+ * which lets simple per-sample arithmetic auto-vectorize.
+ */
+template <class F>
+void forEachPixel(const ImageView& view, F f) {
+  int w = view.width(), stride = view.pixelStride();
+  for (int row = 0; row < view.height(); row++) {
+    unsigned char* p = view.row(row);
+    if (view.packed()) {
+      for (int col = 0; col < w; col++) f(p + 3 * col);
+    } else {
+      for (int col = 0; col < w; col++) f(p + stride * col);
+    }
+  }
+}
+
+/**
+ * @brief Call f(in, out) for every pixel of dst with the src pixel at the same place
+ *
+ * in and out point at the pixels' samples. src must be at least as large
+ * as dst and have as many channels (checked by assert only).
+ */
+template <class F>
+void transform(const ConstImageView& src, const ImageView& dst, F f) {
+  assert(src.width() >= dst.width() && src.height() >= dst.height());
+  assert(src.channels() == dst.channels());
+  int w = dst.width();
+  int inStride = src.pixelStride(), outStride = dst.pixelStride();
+  for (int row = 0; row < dst.height(); row++) {
+    const unsigned char* in = src.row(row);
+    unsigned char* out = dst.row(row);
+    if (src.packed() && dst.packed()) {
+      for (int col = 0; col < w; col++) f(in + 3 * col, out + 3 * col);
+    } else {
+      for (int col = 0; col < w; col++) f(in + inStride * col, out + outStride * col);
+    }
+  }
+}
+
+// Correlate src with a square kernel; out holds width * height * 3 floats.
+// Large kernels go through convolveFFT() (see fft.h)
+void convolve(const ConstImageView& src, const float* kernel, int kSize, float* out);
+
+// convolve() summing the kernel directly, O(kSize^2) per pixel
+void convolveDirect(const ConstImageView& src, const float* kernel, int kSize, float* out);
+
+}  // namespace agl
+#endif  // AGL_IMAGE_VIEW_H_
@@ -0,0 +1,242 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the definitions for convolution kernels that find
+* and cache their separable (low rank) decomposition.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#include "kernel.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include "fft.h"
+#include "parallel.h"
+
+namespace agl {
+
+namespace {
+
+/**
+ * @brief tmp = src correlated with weights along each row
+ *
+ * tmp holds width * height * 3 floats; pixels past the ends count as black.
+ */
+void horizontalPass(const ConstImageView& src, const std::vector<float>& weights, float* tmp) {
+  int w = src.width(), h = src.height(), k = (int) weights.size();
+  int padding = (k - 1) / 2;
+  int stride = src.pixelStride();
+  parallelFor(0, h, [&](int begin, int end) {
+    for (int row = begin; row < end; row++) {
+      const unsigned char* in = src.row(row);
+      float* o = tmp + (long) row * w * 3;
+      memset(o, 0, (long) w * 3 * sizeof(float));
+      for (int tap = 0; tap < k; tap++) {
+        float weight = weights[tap];
+        if (weight == 0) continue;
+        int dx = tap - padding;
+        int colStart = std::max(0, -dx), colEnd = std::min(w, w - dx);
+        const unsigned char* p = in + dx * stride;
+        for (int col = colStart; col < colEnd; col++) {
+          o[col * 3 + 0] += p[col * stride + 0] * weight;
+          o[col * 3 + 1] += p[col * stride + 1] * weight;
+          o[col * 3 + 2] += p[col * stride + 2] * weight;
+        }
+      }
+    }
+  }, 8);
+}
+
+/**
+ * @brief out += tmp correlated with weights along each column
+ */
+void verticalPass(const float* tmp, int w, int h, const std::vector<float>& weights, float* out) {
+  int k = (int) weights.size();
+  int padding = (k - 1) / 2;
+  long rowSize = (long) w * 3;
+  parallelFor(0, h, [&](int begin, int end) {
+    for (int row = begin; row < end; row++) {
+      float* o = out + row * rowSize;
+      for (int tap = 0; tap < k; tap++) {
+        int srcRow = row - padding + tap;
+        float weight = weights[tap];
+        if (srcRow < 0 || srcRow >= h || weight == 0) continue;
+        const float* in = tmp + srcRow * rowSize;
+        for (long i = 0; i < rowSize; i++) {
+          o[i] += in[i] * weight;
+        }
+      }
+    }
+  }, 8);
+}
+
+}  // namespace
+
+/**
+ * @brief Construct a kernel and decompose it
+ * @param weights size * size weights, row major
+ * @param size Width of the kernel
+ * @param tolerance Largest relative (Frobenius norm) error of the terms kept
+ */
+Kernel::Kernel(const float* weights, int size, float tolerance)
+    : mSize(size), mWeights(weights, weights + size * size) {
+  decompose(tolerance);
+}
+
+/**
+ * @brief Construct the rank 1 kernel column * row^T
+ * @param column Vertical weights
+ * @param row Horizontal weights, same size as column
+ */
+Kernel::Kernel(const std::vector<float>& column, const std::vector<float>& row)
+    : mSize((int) row.size()), mWeights(row.size() * row.size()) {
+  assert(column.size() == row.size());
+  for (int i = 0; i < mSize; i++) {
+    for (int j = 0; j < mSize; j++) {
+      mWeights[i * mSize + j] = column[i] * row[j];
+    }
+  }
+  mColumns.push_back(column);
+  mRows.push_back(row);
+}
+
+/**
+ * @brief Normalized Gaussian kernel
+ * @param sigma Standard deviation in pixels
+ * @return Rank 1 kernel 2 * ceil(3 * sigma) + 1 wide
+ */
+Kernel Kernel::gaussian(float sigma) {
+  int size = 2 * (int) std::ceil(3 * sigma) + 1;
+  std::vector<float> g(size);
+  float sum = 0;
+  for (int i = 0; i < size; i++) {
+    float d = (float) (i - size / 2);
+    g[i] = std::exp(-d * d / (2 * sigma * sigma));
+    sum += g[i];
+  }
+  for (float& v : g) v /= sum;
+  return Kernel(g, g);
+}
+
+/**
+ * @brief Factor the weights by one-sided Jacobi SVD
+ *
+ * Rotating pairs of columns until they are orthogonal turns the weights W
+ * into W V = U S, so W = sum_t (U S)_t V_t^T. Terms are kept from the
+ * largest singular value down until the rest hold at most tolerance of
+ * the kernel's Frobenius norm.
+ */
+void Kernel::decompose(float tolerance) {
+  int n = mSize;
+  std::vector<double> a(mWeights.begin(), mWeights.end());  // row major, becomes U S
+  std::vector<double> v(n * n, 0.0);
+  for (int i = 0; i < n; i++) v[i * n + i] = 1;
+
+  for (int sweep = 0; sweep < 60; sweep++) {
+    bool rotated = false;
+    for (int p = 0; p < n - 1; p++) {
+      for (int q = p + 1; q < n; q++) {
+        double alpha = 0, beta = 0, gamma = 0;
+        for (int i = 0; i < n; i++) {
+          alpha += a[i * n + p] * a[i * n + p];
+          beta += a[i * n + q] * a[i * n + q];
+          gamma += a[i * n + p] * a[i * n + q];
+        }
+        if (gamma == 0 || std::fabs(gamma) <= 1e-15 * std::sqrt(alpha * beta)) continue;
+        rotated = true;
+        double zeta = (beta - alpha) / (2 * gamma);
+        double t = (zeta >= 0 ? 1 : -1) / (std::fabs(zeta) + std::sqrt(1 + zeta * zeta));
+        double c = 1 / std::sqrt(1 + t * t), s = c * t;
+        for (int i = 0; i < n; i++) {
+          double ap = a[i * n + p], aq = a[i * n + q];
+          a[i * n + p] = c * ap - s * aq;
+          a[i * n + q] = s * ap + c * aq;
+          double vp = v[i * n + p], vq = v[i * n + q];
+          v[i * n + p] = c * vp - s * vq;
+          v[i * n + q] = s * vp + c * vq;
+        }
+      }
+    }
+    if (!rotated) break;
+  }
+
+  std::vector<double> energy(n, 0.0);  // squared singular values
+  for (int t = 0; t < n; t++) {
+    for (int i = 0; i < n; i++) energy[t] += a[i * n + t] * a[i * n + t];
+  }
+  std::vector<int> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](int x, int y) { return energy[x] > energy[y]; });
+
+  double total = std::accumulate(energy.begin(), energy.end(), 0.0);
+  double remaining = total;
+  double allowed = (double) tolerance * tolerance * total;
+  mColumns.clear();
+  mRows.clear();
+  for (int t : order) {
+    if (remaining <= allowed) break;
+    std::vector<float> column(n), row(n);
+    for (int i = 0; i < n; i++) {
+      column[i] = (float) a[i * n + t];
+      row[i] = (float) v[i * n + t];
+    }
+    mColumns.push_back(column);
+    mRows.push_back(row);
+    remaining -= energy[t];
+  }
+}
+
+/**
+ * @brief Whether apply() runs the separable passes on a view of this size
+ * @param width Width of the view
+ * @param height Height of the view
+ * @return true if 2 * rank 1D passes are estimated to beat both direct
+ * and FFT convolution
+ */
+bool Kernel::separable(int width, int height) const {
+  if (mSize <= 1) return false;
+  double pixels = (double) width * height;
+  // each term also pays for writing and reading the intermediate rows
+  double passes = pixels * rank() * (2 * mSize + 4);
+  double direct = pixels * std::min(mSize, width) * std::min(mSize, height);
+  return passes < std::min(direct, fftCost(mSize, width, height));
+}
+
+/**
+ * @brief Correlate a view with the kernel, pixels outside counting as black
+ * @param src Source RGB view
+ * @param out Output of src.width() * src.height() * 3 floats
+ */
+void Kernel::apply(const ConstImageView& src, float* out) const {
+  int w = src.width(), h = src.height();
+  if (!separable(w, h)) {
+    convolve(src, mWeights.data(), mSize, out);
+    return;
+  }
+  applySeparable(src, out);
+}
+
+/**
+ * @brief Correlate a view with the kernel by the separable passes
+ * @param src Source RGB view
+ * @param out Output of src.width() * src.height() * 3 floats
+ *
+ * The result depends only on the pixels each output reads, not on the
+ * size of the view, so tiles of an image match the whole image exactly.
+ */
+void Kernel::applySeparable(const ConstImageView& src, float* out) const {
+  int w = src.width(), h = src.height();
+  memset(out, 0, (long) w * h * 3 * sizeof(float));
+  std::vector<float> tmp((long) w * h * 3);
+  for (int t = 0; t < rank(); t++) {
+    horizontalPass(src, mRows[t], tmp.data());
+    verticalPass(tmp.data(), w, h, mColumns[t], out);
+  }
+}
+
+}  // namespace agl
@@ -0,0 +1,78 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the declarations for convolution kernels that find
+* and cache their separable (low rank) decomposition.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#ifndef AGL_KERNEL_H_
+#define AGL_KERNEL_H_
+
+#include <vector>
+#include "image_view.h"
+
+namespace agl {
+
+/**
+ * @brief Square convolution kernel with its separable decomposition
+ *
+ * On construction the weights are factored by singular value decomposition
+ * into a sum of outer products column_t * row_t^T, keeping only the terms
+ * needed to reproduce the kernel to within a relative tolerance. Box,
+ * Gaussian, binomial and Sobel kernels have rank 1. apply() then runs each
+ * term as a horizontal and a vertical 1D pass, 2 * rank * size taps per
+ * pixel instead of size^2, unless direct or FFT convolution (see
+ * convolve()) is estimated to be cheaper.
+ *
+ * Build a Kernel once and reuse it to keep the decomposition.
+ */
+class Kernel {
+ public:
+  /**
+   * @param weights size * size weights, row major
+   * @param size Width of the kernel
+   * @param tolerance Largest relative (Frobenius norm) error of the terms kept
+   */
+  Kernel(const float* weights, int size, float tolerance = 1e-5f);
+
+  // Rank 1 kernel column * row^T from two vectors of the same size
+  Kernel(const std::vector<float>& column, const std::vector<float>& row);
+
+  // Normalized Gaussian of the given standard deviation, 2 * ceil(3 * sigma) + 1 wide
+  static Kernel gaussian(float sigma);
+
+  int size() const { return mSize; }
+  const std::vector<float>& weights() const { return mWeights; }
+
+  // Number of separable terms kept
+  int rank() const { return (int) mColumns.size(); }
+  const std::vector<float>& column(int term) const { return mColumns[term]; }
+  const std::vector<float>& row(int term) const { return mRows[term]; }
+
+  // True if apply() on a width x height view runs the separable passes
+  bool separable(int width, int height) const;
+
+  /**
+   * @brief Correlate a view with the kernel, pixels outside counting as black
+   * @param src Source RGB view
+   * @param out Output of src.width() * src.height() * 3 floats
+   */
+  void apply(const ConstImageView& src, float* out) const;
+
+  // apply() always using the separable passes, whatever the rank
+  void applySeparable(const ConstImageView& src, float* out) const;
+
+ private:
+  void decompose(float tolerance);
+
+  int mSize;
+  std::vector<float> mWeights;
+  std::vector<std::vector<float>> mColumns;  // vertical weights, scaled by the singular value
+  std::vector<std::vector<float>> mRows;     // horizontal weights
+};
+
+}  // namespace agl
+#endif  // AGL_KERNEL_H_
@@ -0,0 +1,282 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the definitions for the median filter.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#include "median.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <utility>
+#include <vector>
+#include "image.h"
+#include "parallel.h"
+#include "trace.h"
+
+namespace agl {
+
+namespace {
+
+// Pixels evaluated together by one pass of a sorting network
+const int kLanes = 64;
+
+/**
+ * @brief Comparator network that moves the median of its inputs to one wire
+ */
+struct MedianNetwork {
+  std::vector<std::pair<int, int>> comparators;
+  int inputs;
+  int output;
+  // Constant wires after the inputs: lowPads zeros followed by highPads 255s
+  int lowPads;
+  int highPads;
+};
+
+/**
+ * @brief Devillard's 19 comparator median of 9
+ */
+const MedianNetwork& medianOf9() {
+  static const MedianNetwork network = {
+    {{1, 2}, {4, 5}, {7, 8}, {0, 1}, {3, 4}, {6, 7}, {1, 2}, {4, 5}, {7, 8},
+     {0, 3}, {5, 8}, {4, 7}, {3, 6}, {1, 4}, {2, 5}, {4, 7}, {4, 2}, {6, 4},
+     {4, 2}},
+    9, 4, 0, 0};
+  return network;
+}
+
+/**
+ * @brief Median of 25 from Batcher's odd-even merge sort of 32 wires
+ *
+ * The 25 inputs are padded with 4 zeros and 3 255s so the median lands on
+ * wire 16. Comparators that cannot influence wire 16 are dropped.
+ */
+MedianNetwork buildMedianOf25() {
+  const int n = 32;
+  std::vector<std::pair<int, int>> all;
+  for (int p = 1; p < n; p <<= 1) {
+    for (int k = p; k >= 1; k >>= 1) {
+      for (int j = k % p; j <= n - 1 - k; j += 2 * k) {
+        for (int i = 0; i <= std::min(k - 1, n - j - k - 1); i++) {
+          if ((i + j) / (2 * p) == (i + j + k) / (2 * p)) {
+            all.push_back(std::make_pair(i + j, i + j + k));
+          }
+        }
+      }
+    }
+  }
+  MedianNetwork network;
+  network.inputs = 25;
+  network.output = 16;
+  network.lowPads = 4;
+  network.highPads = 3;
+  bool needed[n] = {false};
+  needed[network.output] = true;
+  for (int i = (int) all.size() - 1; i >= 0; i--) {
+    if (needed[all[i].first] || needed[all[i].second]) {
+      needed[all[i].first] = needed[all[i].second] = true;
+      network.comparators.push_back(all[i]);
+    }
+  }
+  std::reverse(network.comparators.begin(), network.comparators.end());
+  return network;
+}
+
+const MedianNetwork& medianOf25() {
+  static const MedianNetwork network = buildMedianOf25();
+  return network;
+}
+
+inline int clampi(int v, int lo, int hi) { return v < lo ? lo : (v > hi ? hi : v); }
+
+/**
+ * @brief Sorting network median for rows [rowBegin, rowEnd) of a single channel view
+ */
+void networkRows(const ConstImageView& src, const ImageView& dst, int radius,
+                 const MedianNetwork& network, int rowBegin, int rowEnd) {
+  const int w = src.width(), h = src.height();
+  const int d = 2 * radius + 1;
+  const int paddedWidth = w + 2 * radius;
+  std::vector<unsigned char> padded(d * paddedWidth);
+  unsigned char wires[32][kLanes];
+
+  for (int row = rowBegin; row < rowEnd; row++) {
+    // window rows with the edges repeated
+    for (int dy = 0; dy < d; dy++) {
+      const unsigned char* in = src.row(clampi(row - radius + dy, 0, h - 1));
+      unsigned char* out = &padded[dy * paddedWidth];
+      for (int i = 0; i < paddedWidth; i++) {
+        out[i] = in[clampi(i - radius, 0, w - 1) * src.pixelStride()];
+      }
+    }
+    unsigned char* out = dst.row(row);
+    for (int x0 = 0; x0 < w; x0 += kLanes) {
+      int n = std::min(kLanes, w - x0);
+      for (int k = 0; k < network.inputs; k++) {
+        memcpy(wires[k], &padded[(k / d) * paddedWidth + x0 + k % d], n);
+      }
+      for (int k = 0; k < network.lowPads; k++) {
+        memset(wires[network.inputs + k], 0, kLanes);
+      }
+      for (int k = 0; k < network.highPads; k++) {
+        memset(wires[network.inputs + network.lowPads + k], 255, kLanes);
+      }
+      for (const std::pair<int, int>& c : network.comparators) {
+        // separate min/max buffers let the compiler vectorize across lanes
+        unsigned char* a = wires[c.first];
+        unsigned char* b = wires[c.second];
+        unsigned char lo[kLanes], hi[kLanes];
+        for (int l = 0; l < kLanes; l++) {
+          lo[l] = std::min(a[l], b[l]);
+          hi[l] = std::max(a[l], b[l]);
+        }
+        memcpy(a, lo, kLanes);
+        memcpy(b, hi, kLanes);
+      }
+      for (int l = 0; l < n; l++) {
+        out[(x0 + l) * dst.pixelStride()] = wires[network.output][l];
+      }
+    }
+  }
+}
+
+/**
+ * @brief Constant time histogram median for rows [rowBegin, rowEnd) of a single channel view
+ *
+ * Keeps one histogram per (edge padded) column covering the 2r+1 window
+ * rows, updated with one removal and one insertion per row. The kernel
+ * histogram slides along the row by adding the column entering the window
+ * and subtracting the one leaving it. Coarse 16 bin totals narrow the
+ * median search to one group of 16 fine bins, and only that group of the
+ * kernel's fine bins is brought up to date.
+ */
+void histogramRows(const ConstImageView& src, const ImageView& dst, int radius,
+                   int rowBegin, int rowEnd) {
+  const int w = src.width(), h = src.height();
+  const int d = 2 * radius + 1;
+  const int paddedWidth = w + 2 * radius;
+  const int rank = (d * d) / 2;
+  std::vector<unsigned short> fine(paddedWidth * 256, 0), coarse(paddedWidth * 16, 0);
+  std::vector<int> srcCol(paddedWidth);
+  for (int i = 0; i < paddedWidth; i++) {
+    srcCol[i] = clampi(i - radius, 0, w - 1) * src.pixelStride();
+  }
+
+  auto addRow = [&](int row, int delta) {
+    const unsigned char* in = src.row(clampi(row, 0, h - 1));
+    for (int i = 0; i < paddedWidth; i++) {
+      int v = in[srcCol[i]];
+      fine[i * 256 + v] += delta;
+      coarse[i * 16 + (v >> 4)] += delta;
+    }
+  };
+  for (int row = rowBegin - radius; row <= rowBegin + radius; row++) {
+    addRow(row, 1);
+  }
+
+  // The coarse kernel histogram is updated for every pixel; each group of
+  // 16 fine bins is only brought up to date when the median falls in it.
+  // fineStart[g] is the first column of the window group g currently sums.
+  unsigned short kernelFine[256], kernelCoarse[16];
+  int fineStart[16];
+  for (int row = rowBegin; row < rowEnd; row++) {
+    if (row > rowBegin) {
+      addRow(row - radius - 1, -1);
+      addRow(row + radius, 1);
+    }
+    memset(kernelCoarse, 0, sizeof(kernelCoarse));
+    for (int i = 0; i < d; i++) {
+      for (int b = 0; b < 16; b++) kernelCoarse[b] += coarse[i * 16 + b];
+    }
+    for (int g = 0; g < 16; g++) {
+      fineStart[g] = -d;
+    }
+
+    unsigned char* out = dst.row(row);
+    for (int x = 0; x < w; x++) {
+      int count = 0, group = 0;
+      while (count + kernelCoarse[group] <= rank) {
+        count += kernelCoarse[group++];
+      }
+
+      unsigned short* bins = &kernelFine[group * 16];
+      int start = fineStart[group];
+      if (x - start >= d) {
+        memset(bins, 0, 16 * sizeof(unsigned short));
+        for (int i = x; i < x + d; i++) {
+          const unsigned short* column = &fine[i * 256 + group * 16];
+          for (int b = 0; b < 16; b++) bins[b] += column[b];
+        }
+      } else {
+        for (int i = start; i < x; i++) {
+          const unsigned short* entering = &fine[(i + d) * 256 + group * 16];
+          const unsigned short* leaving = &fine[i * 256 + group * 16];
+          for (int b = 0; b < 16; b++) bins[b] += entering[b] - leaving[b];
+        }
+      }
+      fineStart[group] = x;
+
+      int bin = 0;
+      while (count + bins[bin] <= rank) {
+        count += bins[bin++];
+      }
+      out[x * dst.pixelStride()] = group * 16 + bin;
+
+      if (x + 1 < w) {
+        const unsigned short* addCoarse = &coarse[(x + d) * 16];
+        const unsigned short* subCoarse = &coarse[x * 16];
+        for (int b = 0; b < 16; b++) kernelCoarse[b] += addCoarse[b] - subCoarse[b];
+      }
+    }
+  }
+}
+
+}  // namespace
+
+/**
+ * @brief Median filter every channel of a view
+ * @param src Source view
+ * @param dst Destination view of the same size
+ * @param radius Window radius
+ */
+void medianFilter(const ConstImageView& src, const ImageView& dst, int radius) {
+  assert(src.width() == dst.width() && src.height() == dst.height());
+  assert(src.channels() == dst.channels());
+  radius = clampi(radius, 0, 127);
+  if (radius == 0 || src.empty()) {
+    copy(src, dst);
+    return;
+  }
+  int grain = std::max(16, 2 * radius + 1);
+  for (int c = 0; c < src.channels(); c++) {
+    ConstImageView in = src.channels() == 1 ? src : src.channel(c);
+    ImageView out = dst.channels() == 1 ? dst : dst.channel(c);
+    parallelFor(0, src.height(), [&](int rowBegin, int rowEnd) {
+      if (radius == 1) {
+        networkRows(in, out, radius, medianOf9(), rowBegin, rowEnd);
+      } else if (radius == 2) {
+        networkRows(in, out, radius, medianOf25(), rowBegin, rowEnd);
+      } else {
+        histogramRows(in, out, radius, rowBegin, rowEnd);
+      }
+    }, grain);
+  }
+}
+
+/**
+ * @brief Median filter the image to remove salt and pepper noise
+ * @param radius Window radius (window is 2 * radius + 1 pixels wide)
+ * @return Filtered image
+ */
+Image Image::median(int radius) const {
+  AGL_TRACE_SCOPE("Image::median", (long long) mWidth * mHeight);
+  Image result(mWidth, mHeight);
+  medianFilter(view(), result.view(), radius);
+  return result;
+}
+
+}  // namespace agl
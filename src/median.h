@@ -0,0 +1,32 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the declarations for the median (rank) filter.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#ifndef AGL_MEDIAN_H_
+#define AGL_MEDIAN_H_
+
+#include "image_view.h"
+
+namespace agl {
+
+/**
+ * @brief Median filter every channel of src over a (2r+1) x (2r+1) window
+ * @param src Source view (1 or 3 channels)
+ * @param dst Destination view of the same size; must not overlap src
+ * @param radius Window radius in [0, 127]
+ *
+ * Radius 1 and 2 use sorting networks evaluated on many pixels at once.
+ * Larger radii use the constant time histogram method of Perreault and
+ * Hebert, so the cost per pixel does not grow with the radius. Pixels
+ * beyond the edges repeat the nearest edge pixel. Rows are processed in
+ * parallel strips.
+ */
+void medianFilter(const ConstImageView& src, const ImageView& dst, int radius);
+
+}  // namespace agl
+#endif  // AGL_MEDIAN_H_
@@ -0,0 +1,338 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the definitions for image comparison and quality
+* metrics: exact diffs, PSNR, SSIM and perceptual hashes.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#include "metrics.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <vector>
+#include "bit_ops.h"
+#include "parallel.h"
+#include "trace.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define AGL_METRICS_SSE2
+#endif
+
+namespace agl {
+
+namespace {
+
+const int kWindow = 11;         // SSIM window width
+const float kWindowSigma = 1.5f;
+
+/**
+ * @brief Add the differences of n packed samples to stats
+ */
+void compareSamples(const unsigned char* a, const unsigned char* b, int n, DiffStats& stats) {
+  int i = 0;
+#ifdef AGL_METRICS_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  __m128i largest = zero;
+  while (i + 16 <= n) {
+    // a lane gains at most 4 * 255^2 per step; flush before 2^31
+    __m128i squares = zero;
+    int steps = 0;
+    for (; i + 16 <= n && steps < 4096; i += 16, steps++) {
+      __m128i x = _mm_loadu_si128((const __m128i*) (a + i));
+      __m128i y = _mm_loadu_si128((const __m128i*) (b + i));
+      __m128i d = _mm_or_si128(_mm_subs_epu8(x, y), _mm_subs_epu8(y, x));
+      largest = _mm_max_epu8(largest, d);
+      int equal = _mm_movemask_epi8(_mm_cmpeq_epi8(d, zero));
+      stats.differing += 16 - countBits(equal);
+      __m128i lo = _mm_unpacklo_epi8(d, zero), hi = _mm_unpackhi_epi8(d, zero);
+      squares = _mm_add_epi32(squares, _mm_madd_epi16(lo, lo));
+      squares = _mm_add_epi32(squares, _mm_madd_epi16(hi, hi));
+    }
+    int lanes[4];
+    _mm_storeu_si128((__m128i*) lanes, squares);
+    stats.sumSquaredError += (double) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  }
+  unsigned char maxima[16];
+  _mm_storeu_si128((__m128i*) maxima, largest);
+  for (unsigned char m : maxima) stats.maxAbsError = std::max(stats.maxAbsError, (int) m);
+#endif
+  for (; i < n; i++) {
+    int d = std::abs(a[i] - b[i]);
+    stats.differing += d != 0;
+    stats.maxAbsError = std::max(stats.maxAbsError, d);
+    stats.sumSquaredError += d * d;
+  }
+}
+
+// Luma of an RGB pixel, minus 128 to keep the SSIM second moments small
+inline float centeredLuma(const unsigned char* p) {
+  return 0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2] - 128;
+}
+
+/**
+ * @brief SSIM of one window with the given means and (co)variances
+ */
+inline double ssimTerm(double muX, double muY, double xx, double yy, double xy) {
+  const double c1 = (0.01 * 255) * (0.01 * 255), c2 = (0.03 * 255) * (0.03 * 255);
+  double varX = xx - muX * muX, varY = yy - muY * muY, cov = xy - muX * muY;
+  // the luma was centered on 128; the means enter the luminance term uncentered
+  muX += 128;
+  muY += 128;
+  return ((2 * muX * muY + c1) * (2 * cov + c2)) /
+         ((muX * muX + muY * muY + c1) * (varX + varY + c2));
+}
+
+}  // namespace
+
+/**
+ * @brief Whether two views hold exactly the same pixels
+ * @param a First view
+ * @param b Second view
+ * @return true if the sizes, channel counts and every sample match
+ */
+bool identical(const ConstImageView& a, const ConstImageView& b) {
+  if (a.width() != b.width() || a.height() != b.height() || a.channels() != b.channels()) {
+    return false;
+  }
+  for (int row = 0; row < a.height(); row++) {
+    if (a.packed() && b.packed()) {
+      if (memcmp(a.row(row), b.row(row), (size_t) a.width() * 3) != 0) return false;
+      continue;
+    }
+    for (int col = 0; col < a.width(); col++) {
+      const unsigned char* p = a.at(row, col);
+      const unsigned char* q = b.at(row, col);
+      for (int c = 0; c < a.channels(); c++) {
+        if (p[c] != q[c]) return false;
+      }
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Compare every sample of two views of the same size
+ * @param a First RGB view
+ * @param b Second RGB view, same size as a
+ * @return Count of differing samples, maximum absolute error and squared error
+ */
+DiffStats compare(const ConstImageView& a, const ConstImageView& b) {
+  AGL_TRACE_SCOPE("compare", (long long) a.width() * a.height());
+  assert(a.width() == b.width() && a.height() == b.height());
+  assert(a.channels() == 3 && b.channels() == 3);
+  DiffStats total;
+  total.samples = (long long) a.width() * a.height() * 3;
+  std::mutex mutex;
+  parallelFor(0, a.height(), [&](int begin, int end) {
+    DiffStats stats;
+    std::vector<unsigned char> x, y;
+    for (int row = begin; row < end; row++) {
+      const unsigned char* p = a.row(row);
+      const unsigned char* q = b.row(row);
+      if (!a.packed() || !b.packed()) {
+        x.resize((size_t) a.width() * 3);
+        y.resize(x.size());
+        for (int col = 0; col < a.width(); col++) {
+          memcpy(&x[col * 3], a.at(row, col), 3);
+          memcpy(&y[col * 3], b.at(row, col), 3);
+        }
+        p = x.data();
+        q = y.data();
+      }
+      compareSamples(p, q, a.width() * 3, stats);
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    total.differing += stats.differing;
+    total.maxAbsError = std::max(total.maxAbsError, stats.maxAbsError);
+    total.sumSquaredError += stats.sumSquaredError;
+  }, 16);
+  return total;
+}
+
+/**
+ * @brief Peak signal to noise ratio of b against a
+ * @return 10 log10(255^2 / MSE) in dB, infinity when the views are equal
+ */
+double psnr(const ConstImageView& a, const ConstImageView& b) {
+  double mse = compare(a, b).mse();
+  if (mse == 0) return std::numeric_limits<double>::infinity();
+  return 10 * std::log10(255.0 * 255.0 / mse);
+}
+
+/**
+ * @brief Mean structural similarity of the luma of two views
+ * @param a First RGB view
+ * @param b Second RGB view, same size as a
+ * @return Mean SSIM over all window positions
+ *
+ * Each strip of output rows keeps a ring of the last kWindow input rows
+ * after the horizontal pass of x, y, x^2, y^2 and xy, so every input row
+ * is filtered once per strip. Per-row sums are added in order, so the
+ * result does not depend on the number of threads.
+ */
+double ssim(const ConstImageView& a, const ConstImageView& b) {
+  AGL_TRACE_SCOPE("ssim", (long long) a.width() * a.height());
+  assert(a.width() == b.width() && a.height() == b.height());
+  int w = a.width(), h = a.height();
+  if (w <= 0 || h <= 0) return 1;
+
+  if (w < kWindow || h < kWindow) {
+    double sx = 0, sy = 0, sxx = 0, syy = 0, sxy = 0;
+    for (int row = 0; row < h; row++) {
+      for (int col = 0; col < w; col++) {
+        double x = centeredLuma(a.at(row, col)), y = centeredLuma(b.at(row, col));
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        syy += y * y;
+        sxy += x * y;
+      }
+    }
+    double n = (double) w * h;
+    return ssimTerm(sx / n, sy / n, sxx / n, syy / n, sxy / n);
+  }
+
+  float taps[kWindow];
+  float tapSum = 0;
+  for (int i = 0; i < kWindow; i++) {
+    float d = (float) (i - kWindow / 2);
+    taps[i] = std::exp(-d * d / (2 * kWindowSigma * kWindowSigma));
+    tapSum += taps[i];
+  }
+  for (float& t : taps) t /= tapSum;
+
+  int outW = w - kWindow + 1, outH = h - kWindow + 1;
+  std::vector<double> rowSums(outH, 0.0);
+  parallelFor(0, outH, [&](int begin, int end) {
+    // ring of the last kWindow input rows, each as five horizontally
+    // filtered planes: x, y, xx, yy, xy
+    std::vector<float> ring((size_t) kWindow * 5 * outW);
+    std::vector<float> values((size_t) 5 * w);
+    auto filterRow = [&](int row) {
+      float* x = values.data();
+      float* y = x + w;
+      for (int col = 0; col < w; col++) {
+        x[col] = centeredLuma(a.at(row, col));
+        y[col] = centeredLuma(b.at(row, col));
+        x[2 * w + col] = x[col] * x[col];
+        x[3 * w + col] = y[col] * y[col];
+        x[4 * w + col] = x[col] * y[col];
+      }
+      float* out = ring.data() + (size_t) (row % kWindow) * 5 * outW;
+      std::fill(out, out + 5 * outW, 0.0f);
+      for (int p = 0; p < 5; p++) {
+        const float* in = values.data() + (size_t) p * w;
+        float* o = out + (size_t) p * outW;
+        for (int t = 0; t < kWindow; t++) {
+          float weight = taps[t];
+          for (int col = 0; col < outW; col++) o[col] += weight * in[col + t];
+        }
+      }
+    };
+
+    for (int row = begin; row < begin + kWindow - 1; row++) filterRow(row);
+    std::vector<float> sums((size_t) 5 * outW);
+    for (int row = begin; row < end; row++) {
+      filterRow(row + kWindow - 1);
+      std::fill(sums.begin(), sums.end(), 0.0f);
+      for (int t = 0; t < kWindow; t++) {
+        const float* in = ring.data() + (size_t) ((row + t) % kWindow) * 5 * outW;
+        float weight = taps[t];
+        for (int i = 0; i < 5 * outW; i++) sums[i] += weight * in[i];
+      }
+      const float* s = sums.data();
+      double total = 0;
+      for (int col = 0; col < outW; col++) {
+        total += ssimTerm(s[col], s[outW + col], s[2 * outW + col], s[3 * outW + col],
+                          s[4 * outW + col]);
+      }
+      rowSums[row] = total;
+    }
+  }, 16);
+
+  double total = 0;
+  for (double s : rowSums) total += s;
+  return total / ((double) outW * outH);
+}
+
+/**
+ * @brief 64-bit DCT perceptual hash
+ * @param view RGB view to hash
+ * @return Bit 8 * v + u is set when DCT coefficient (u, v) is above the median
+ */
+uint64_t perceptualHash(const ConstImageView& view) {
+  AGL_TRACE_SCOPE("perceptualHash", (long long) view.width() * view.height());
+  const int n = 32, k = 8;
+  int w = view.width(), h = view.height();
+  if (w <= 0 || h <= 0) return 0;
+
+  // box average of the luma over a 32 x 32 grid of cells
+  float cells[n][n];
+  parallelFor(0, n, [&](int begin, int end) {
+    for (int cy = begin; cy < end; cy++) {
+      int y0 = cy * h / n, y1 = std::max(y0 + 1, (cy + 1) * h / n);
+      long long sums[n] = {0};
+      int counts[n] = {0};
+      for (int row = y0; row < y1; row++) {
+        for (int cx = 0; cx < n; cx++) {
+          int x0 = cx * w / n, x1 = std::max(x0 + 1, (cx + 1) * w / n);
+          for (int col = x0; col < x1; col++) {
+            const unsigned char* p = view.at(row, col);
+            sums[cx] += 77 * p[0] + 150 * p[1] + 29 * p[2];
+          }
+          counts[cx] += x1 - x0;
+        }
+      }
+      for (int cx = 0; cx < n; cx++) cells[cy][cx] = (float) sums[cx] / (256.0f * counts[cx]);
+    }
+  });
+
+  // lowest k x k DCT-II coefficients, separably
+  float basis[k][n];
+  for (int u = 0; u < k; u++) {
+    for (int x = 0; x < n; x++) basis[u][x] = std::cos((2 * x + 1) * u * 3.14159265f / (2 * n));
+  }
+  float rows[n][k];
+  for (int y = 0; y < n; y++) {
+    for (int u = 0; u < k; u++) {
+      float s = 0;
+      for (int x = 0; x < n; x++) s += cells[y][x] * basis[u][x];
+      rows[y][u] = s;
+    }
+  }
+  float coefficients[k * k];
+  for (int v = 0; v < k; v++) {
+    for (int u = 0; u < k; u++) {
+      float s = 0;
+      for (int y = 0; y < n; y++) s += basis[v][y] * rows[y][u];
+      coefficients[v * k + u] = s;
+    }
+  }
+
+  float sorted[k * k];
+  std::copy(coefficients, coefficients + k * k, sorted);
+  std::sort(sorted, sorted + k * k);
+  float median = (sorted[k * k / 2 - 1] + sorted[k * k / 2]) / 2;
+  uint64_t hash = 0;
+  for (int i = 0; i < k * k; i++) {
+    if (coefficients[i] > median) hash |= (uint64_t) 1 << i;
+  }
+  return hash;
+}
+
+/**
+ * @brief Number of bits that differ between two hashes
+ */
+int hammingDistance(uint64_t a, uint64_t b) {
+  return countBits(a ^ b);
+}
+
+}  // namespace agl
@@ -0,0 +1,77 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the declarations for image comparison and quality
+* metrics: exact diffs, PSNR, SSIM and perceptual hashes.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#ifndef AGL_METRICS_H_
+#define AGL_METRICS_H_
+
+#include <cstdint>
+#include "image_view.h"
+
+namespace agl {
+
+/**
+ * @brief Sample by sample differences between two views
+ */
+struct DiffStats {
+  long long samples = 0;       // samples compared
+  long long differing = 0;     // samples that are not equal
+  int maxAbsError = 0;         // largest |a - b|
+  double sumSquaredError = 0;  // sum of (a - b)^2
+
+  // Mean squared error per sample
+  double mse() const { return samples ? sumSquaredError / samples : 0; }
+};
+
+// True if the views have the same size and every sample is equal (stops at the first difference)
+bool identical(const ConstImageView& a, const ConstImageView& b);
+
+/**
+ * @brief Compare every sample of two views of the same size
+ * @param a First RGB view
+ * @param b Second RGB view, same size as a
+ * @return Count of differing samples, maximum absolute error and squared error
+ *
+ * Packed rows are compared 16 samples at a time with SSE2 where available.
+ * Rows are processed in parallel.
+ */
+DiffStats compare(const ConstImageView& a, const ConstImageView& b);
+
+// Peak signal to noise ratio in dB (infinity for identical views)
+double psnr(const ConstImageView& a, const ConstImageView& b);
+
+/**
+ * @brief Mean structural similarity of the luma of two views
+ * @param a First RGB view
+ * @param b Second RGB view, same size as a
+ * @return Mean SSIM in [-1, 1]; 1 for identical views
+ *
+ * Local means, variances and covariance use an 11 x 11 Gaussian window
+ * (sigma 1.5) run as separable passes, at every position where the window
+ * fits inside the views (Wang et al. 2004). Views smaller than the window
+ * are compared as one window. Rows are processed in parallel strips.
+ */
+double ssim(const ConstImageView& a, const ConstImageView& b);
+
+/**
+ * @brief 64-bit perceptual hash (DCT pHash)
+ * @param view RGB view to hash
+ * @return One bit per low frequency of the luma
+ *
+ * The luma is box averaged down to 32 x 32, transformed with a DCT, and
+ * the 8 x 8 lowest frequencies are compared against their median. Rescaled,
+ * recompressed or slightly edited copies give hashes a few bits apart.
+ */
+uint64_t perceptualHash(const ConstImageView& view);
+
+// Number of differing bits between two hashes (0 - 64)
+int hammingDistance(uint64_t a, uint64_t b);
+
+}  // namespace agl
+#endif  // AGL_METRICS_H_
@@ -0,0 +1,433 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the definitions for grayscale and binary morphology.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#include "morphology.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include "bit_ops.h"
+#include "image.h"
+#include "parallel.h"
+#include "trace.h"
+
+namespace agl {
+
+namespace {
+
+// Bytes per column strip of the vertical grayscale pass
+const int kStripBytes = 256;
+
+struct MinOp {
+  static unsigned char identity() { return 255; }
+  unsigned char operator()(unsigned char a, unsigned char b) const { return a < b ? a : b; }
+};
+
+struct MaxOp {
+  static unsigned char identity() { return 0; }
+  unsigned char operator()(unsigned char a, unsigned char b) const { return a > b ? a : b; }
+};
+
+/**
+ * @brief Length of a line padded by r on both sides and rounded up to whole blocks of 2r+1
+ */
+inline int paddedLength(int n, int r) {
+  int d = 2 * r + 1;
+  return (n + 2 * r + d - 1) / d * d;
+}
+
+/**
+ * @brief van Herk / Gil-Werman running min or max of one line
+ *
+ * The padded line is cut into blocks of d = 2r+1 samples. g holds the
+ * running result from the start of each block and h the running result
+ * to its end, so any window of d samples is h at its first sample combined
+ * with g at its last.
+ */
+template <class Op>
+void runLine(const unsigned char* in, int inStride, unsigned char* out, int outStride,
+             int n, int r, std::vector<unsigned char>& g, std::vector<unsigned char>& h) {
+  Op best;
+  const int d = 2 * r + 1;
+  const int m = paddedLength(n, r);
+  g.resize(m);
+  h.resize(m);
+  for (int j = 0; j < m; j++) {
+    unsigned char v = (j >= r && j < r + n) ? in[(j - r) * inStride] : Op::identity();
+    g[j] = (j % d == 0) ? v : best(g[j - 1], v);
+    h[j] = v;
+  }
+  for (int j = m - 2; j >= 0; j--) {
+    if (j % d != d - 1) h[j] = best(h[j + 1], h[j]);
+  }
+  for (int i = 0; i < n; i++) {
+    out[i * outStride] = best(h[i], g[i + d - 1]);
+  }
+}
+
+/**
+ * @brief Horizontal pass from src into a packed buffer of width * channels samples per row
+ */
+template <class Op>
+void horizontalPass(const ConstImageView& src, unsigned char* packed, int r) {
+  const int w = src.width(), ch = src.channels();
+  parallelFor(0, src.height(), [&](int rowBegin, int rowEnd) {
+    std::vector<unsigned char> g, h;
+    for (int row = rowBegin; row < rowEnd; row++) {
+      const unsigned char* in = src.row(row);
+      unsigned char* out = packed + (long) row * w * ch;
+      for (int c = 0; c < ch; c++) {
+        runLine<Op>(in + c, src.pixelStride(), out + c, ch, w, r, g, h);
+      }
+    }
+  }, 8);
+}
+
+/**
+ * @brief Vertical pass from a packed buffer into dst, in column strips
+ *
+ * Each strip runs the van Herk / Gil-Werman recurrences on whole rows of
+ * the strip at once, so the inner loops are contiguous.
+ */
+template <class Op>
+void verticalPass(const unsigned char* packed, const ImageView& dst, int r) {
+  Op best;
+  const int w = dst.width(), hgt = dst.height(), ch = dst.channels();
+  const int rowBytes = w * ch;
+  const int d = 2 * r + 1;
+  const int m = paddedLength(hgt, r);
+  const int strips = (rowBytes + kStripBytes - 1) / kStripBytes;
+  parallelFor(0, strips, [&](int stripBegin, int stripEnd) {
+    std::vector<unsigned char> g((long) m * kStripBytes), h((long) m * kStripBytes);
+    std::vector<unsigned char> pad(kStripBytes, Op::identity());
+    for (int s = stripBegin; s < stripEnd; s++) {
+      const int x0 = s * kStripBytes;
+      const int n = std::min(kStripBytes, rowBytes - x0);
+      auto line = [&](int j) {
+        return (j >= r && j < r + hgt) ? packed + (long) (j - r) * rowBytes + x0 : &pad[0];
+      };
+      for (int j = 0; j < m; j++) {
+        const unsigned char* v = line(j);
+        unsigned char* gj = &g[(long) j * kStripBytes];
+        if (j % d == 0) {
+          memcpy(gj, v, n);
+        } else {
+          const unsigned char* prev = gj - kStripBytes;
+          for (int i = 0; i < n; i++) gj[i] = best(prev[i], v[i]);
+        }
+      }
+      for (int j = m - 1; j >= 0; j--) {
+        const unsigned char* v = line(j);
+        unsigned char* hj = &h[(long) j * kStripBytes];
+        if (j % d == d - 1) {
+          memcpy(hj, v, n);
+        } else {
+          const unsigned char* next = hj + kStripBytes;
+          for (int i = 0; i < n; i++) hj[i] = best(next[i], v[i]);
+        }
+      }
+      for (int row = 0; row < hgt; row++) {
+        const unsigned char* a = &h[(long) row * kStripBytes];
+        const unsigned char* b = &g[(long) (row + d - 1) * kStripBytes];
+        unsigned char* out = dst.row(row);
+        for (int i = 0; i < n; i++) {
+          int x = x0 + i;
+          out[(x / ch) * dst.pixelStride() + x % ch] = best(a[i], b[i]);
+        }
+      }
+    }
+  });
+}
+
+template <class Op>
+void separable(const ConstImageView& src, const ImageView& dst, int rx, int ry) {
+  std::vector<unsigned char> packed((long) src.width() * src.height() * src.channels());
+  horizontalPass<Op>(src, &packed[0], rx);
+  verticalPass<Op>(&packed[0], dst, ry);
+}
+
+/**
+ * @brief out[p] = in[p + k] for one packed row, zero where p + k is outside the row
+ */
+void shiftRow(const uint64_t* in, uint64_t* out, int words, int k) {
+  const int q = (k >= 0 ? k : -k) / 64, b = (k >= 0 ? k : -k) % 64;
+  for (int j = 0; j < words; j++) {
+    uint64_t v = 0;
+    if (k >= 0) {
+      if (j + q < words) v = in[j + q] >> b;
+      if (b && j + q + 1 < words) v |= in[j + q + 1] << (64 - b);
+    } else {
+      if (j - q >= 0) v = in[j - q] << b;
+      if (b && j - q - 1 >= 0) v |= in[j - q - 1] >> (64 - b);
+    }
+    out[j] = v;
+  }
+}
+
+}  // namespace
+
+/**
+ * @brief Apply a morphological operator with a rectangular element
+ * @param src Source view
+ * @param dst Destination view
+ * @param op Operator
+ * @param rx Horizontal radius
+ * @param ry Vertical radius
+ */
+void morphology(const ConstImageView& src, const ImageView& dst, Morphology op,
+                int rx, int ry) {
+  assert(src.width() == dst.width() && src.height() == dst.height());
+  assert(src.channels() == dst.channels());
+  rx = std::max(0, rx);
+  ry = std::max(0, ry);
+  if (src.empty()) return;
+  switch (op) {
+    case Morphology::Erode:
+      separable<MinOp>(src, dst, rx, ry);
+      break;
+    case Morphology::Dilate:
+      separable<MaxOp>(src, dst, rx, ry);
+      break;
+    case Morphology::Open:
+      separable<MinOp>(src, dst, rx, ry);
+      separable<MaxOp>(dst, dst, rx, ry);
+      break;
+    case Morphology::Close:
+      separable<MaxOp>(src, dst, rx, ry);
+      separable<MinOp>(dst, dst, rx, ry);
+      break;
+  }
+}
+
+BitMask::BitMask() {}
+
+BitMask::BitMask(int width, int height)
+    : mWidth(width), mHeight(height), mWords((width + 63) / 64),
+      mBits((long) mWords * height, 0) {}
+
+/**
+ * @brief Build a mask from the first channel of a view
+ * @param view Source view
+ * @param level Samples at or above this level are set
+ * @return Mask of the same size
+ */
+BitMask BitMask::threshold(const ConstImageView& view, unsigned char level) {
+  BitMask mask(view.width(), view.height());
+  parallelFor(0, view.height(), [&](int rowBegin, int rowEnd) {
+    for (int row = rowBegin; row < rowEnd; row++) {
+      const unsigned char* in = view.row(row);
+      uint64_t* out = mask.row(row);
+      for (int col = 0; col < view.width(); col++, in += view.pixelStride()) {
+        if (*in >= level) out[col >> 6] |= uint64_t(1) << (col & 63);
+      }
+    }
+  }, 16);
+  return mask;
+}
+
+bool BitMask::get(int row, int col) const {
+  if (row < 0 || row >= mHeight || col < 0 || col >= mWidth) return false;
+  return (this->row(row)[col >> 6] >> (col & 63)) & 1;
+}
+
+void BitMask::set(int row, int col, bool value) {
+  if (row < 0 || row >= mHeight || col < 0 || col >= mWidth) return;
+  uint64_t bit = uint64_t(1) << (col & 63);
+  uint64_t& word = this->row(row)[col >> 6];
+  word = value ? (word | bit) : (word & ~bit);
+}
+
+long BitMask::count() const {
+  long total = 0;
+  for (uint64_t word : mBits) total += countBits(word);
+  return total;
+}
+
+/**
+ * @brief Apply a morphological operator in place
+ * @param op Operator
+ * @param rx Horizontal radius
+ * @param ry Vertical radius
+ *
+ * Erosion is computed as the dilation of the complement, so pixels beyond
+ * the edges count as set for erosion and clear for dilation.
+ */
+void BitMask::apply(Morphology op, int rx, int ry) {
+  rx = std::max(0, rx);
+  ry = std::max(0, ry);
+  if (mBits.empty()) return;
+  auto dilate = [&]() {
+    dilateRows(rx);
+    dilateColumns(ry);
+  };
+  auto erode = [&]() {
+    invert();
+    dilate();
+    invert();
+  };
+  switch (op) {
+    case Morphology::Erode:
+      erode();
+      break;
+    case Morphology::Dilate:
+      dilate();
+      break;
+    case Morphology::Open:
+      erode();
+      dilate();
+      break;
+    case Morphology::Close:
+      dilate();
+      erode();
+      break;
+  }
+}
+
+/**
+ * @brief Convert the mask to a black and white image
+ * @return Image with set pixels white
+ */
+Image BitMask::toImage() const {
+  Image result(mWidth, mHeight);
+  ImageView out = result.view();
+  parallelFor(0, mHeight, [&](int rowBegin, int rowEnd) {
+    for (int row = rowBegin; row < rowEnd; row++) {
+      const uint64_t* in = this->row(row);
+      unsigned char* p = out.row(row);
+      for (int col = 0; col < mWidth; col++, p += 3) {
+        p[0] = p[1] = p[2] = ((in[col >> 6] >> (col & 63)) & 1) ? 255 : 0;
+      }
+    }
+  }, 16);
+  return result;
+}
+
+/**
+ * @brief OR every pixel with its neighbors up to rx columns away
+ *
+ * A row that already holds the OR over radius s becomes the OR over radius
+ * s + t by ORing in copies of itself shifted t columns either way. Keeping
+ * t <= s + 1 means no window is lost off the edges of the row, and the
+ * radius still doubles with each pair of shifts.
+ */
+void BitMask::dilateRows(int rx) {
+  if (rx == 0) return;
+  const uint64_t lastMask = (mWidth % 64) ? (uint64_t(1) << (mWidth % 64)) - 1 : ~uint64_t(0);
+  parallelFor(0, mHeight, [&](int rowBegin, int rowEnd) {
+    std::vector<uint64_t> left(mWords), right(mWords);
+    for (int row = rowBegin; row < rowEnd; row++) {
+      uint64_t* bits = this->row(row);
+      for (int s = 0; s < rx;) {
+        int t = std::min(s + 1, rx - s);
+        shiftRow(bits, &left[0], mWords, -t);
+        shiftRow(bits, &right[0], mWords, t);
+        for (int j = 0; j < mWords; j++) bits[j] |= left[j] | right[j];
+        bits[mWords - 1] &= lastMask;
+        s += t;
+      }
+    }
+  }, 16);
+}
+
+/**
+ * @brief OR every pixel with its neighbors up to ry rows away
+ *
+ * van Herk / Gil-Werman on whole words, one group of word columns per task.
+ */
+void BitMask::dilateColumns(int ry) {
+  if (ry == 0) return;
+  const int d = 2 * ry + 1;
+  const int m = paddedLength(mHeight, ry);
+  parallelFor(0, mWords, [&](int wordBegin, int wordEnd) {
+    const int n = wordEnd - wordBegin;
+    std::vector<uint64_t> g((long) m * n), h((long) m * n);
+    auto value = [&](int j, int i) {
+      return (j >= ry && j < ry + mHeight) ? row(j - ry)[wordBegin + i] : uint64_t(0);
+    };
+    for (int j = 0; j < m; j++) {
+      for (int i = 0; i < n; i++) {
+        g[(long) j * n + i] = (j % d == 0) ? value(j, i) : g[(long) (j - 1) * n + i] | value(j, i);
+      }
+    }
+    for (int j = m - 1; j >= 0; j--) {
+      for (int i = 0; i < n; i++) {
+        h[(long) j * n + i] = (j % d == d - 1) ? value(j, i) : h[(long) (j + 1) * n + i] | value(j, i);
+      }
+    }
+    for (int r = 0; r < mHeight; r++) {
+      uint64_t* out = row(r) + wordBegin;
+      for (int i = 0; i < n; i++) {
+        out[i] = h[(long) r * n + i] | g[(long) (r + d - 1) * n + i];
+      }
+    }
+  });
+}
+
+void BitMask::invert() {
+  const uint64_t lastMask = (mWidth % 64) ? (uint64_t(1) << (mWidth % 64)) - 1 : ~uint64_t(0);
+  for (int r = 0; r < mHeight; r++) {
+    uint64_t* bits = row(r);
+    for (int j = 0; j < mWords; j++) bits[j] = ~bits[j];
+    bits[mWords - 1] &= lastMask;
+  }
+}
+
+/**
+ * @brief Replace every pixel with the minimum over a (2rx+1) x (2ry+1) rectangle
+ * @param rx Horizontal radius
+ * @param ry Vertical radius
+ * @return Eroded image
+ */
+Image Image::erode(int rx, int ry) const {
+  AGL_TRACE_SCOPE("Image::erode", (long long) mWidth * mHeight);
+  Image result(mWidth, mHeight);
+  morphology(view(), result.view(), Morphology::Erode, rx, ry);
+  return result;
+}
+
+/**
+ * @brief Replace every pixel with the maximum over a (2rx+1) x (2ry+1) rectangle
+ * @param rx Horizontal radius
+ * @param ry Vertical radius
+ * @return Dilated image
+ */
+Image Image::dilate(int rx, int ry) const {
+  AGL_TRACE_SCOPE("Image::dilate", (long long) mWidth * mHeight);
+  Image result(mWidth, mHeight);
+  morphology(view(), result.view(), Morphology::Dilate, rx, ry);
+  return result;
+}
+
+/**
+ * @brief Erode then dilate, removing bright details smaller than the rectangle
+ * @param rx Horizontal radius
+ * @param ry Vertical radius
+ * @return Opened image
+ */
+Image Image::open(int rx, int ry) const {
+  AGL_TRACE_SCOPE("Image::open", (long long) mWidth * mHeight);
+  Image result(mWidth, mHeight);
+  morphology(view(), result.view(), Morphology::Open, rx, ry);
+  return result;
+}
+
+/**
+ * @brief Dilate then erode, filling dark details smaller than the rectangle
+ * @param rx Horizontal radius
+ * @param ry Vertical radius
+ * @return Closed image
+ */
+Image Image::close(int rx, int ry) const {
+  AGL_TRACE_SCOPE("Image::close", (long long) mWidth * mHeight);
+  Image result(mWidth, mHeight);
+  morphology(view(), result.view(), Morphology::Close, rx, ry);
+  return result;
+}
+
+}  // namespace agl
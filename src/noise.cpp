@@ -0,0 +1,262 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the definitions for counter-based random numbers and
+* the noise and dithering operators built on them.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#include "noise.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <vector>
+#include "fixed_point.h"
+#include "image.h"
+#include "parallel.h"
+#include "trace.h"
+
+namespace agl {
+
+namespace {
+
+/**
+ * @brief Entry (x, y) of the 8x8 Bayer matrix, a permutation of 0 .. 63
+ *
+ * Interleaves the bits of x ^ y and y, most significant last.
+ */
+int bayer(int x, int y) {
+  int value = 0;
+  for (int bit = 0; bit < 3; bit++) {
+    int shift = 2 * (2 - bit);
+    value |= (((x ^ y) >> bit) & 1) << (shift + 1);
+    value |= ((y >> bit) & 1) << shift;
+  }
+  return value;
+}
+
+// Level index (of levels) to 8-bit value, rounded
+int levelValue(int index, int levels) {
+  return (2 * index * 255 + levels - 1) / (2 * (levels - 1));
+}
+
+}  // namespace
+
+/**
+ * @brief Seed for operations called without one
+ * @return A seed mixing the clock and a process wide call counter, so two
+ * calls in the same clock tick still differ
+ */
+uint64_t CounterRng::freshSeed() {
+  static std::atomic<uint64_t> calls(0);
+  uint64_t now = (uint64_t) std::chrono::system_clock::now().time_since_epoch().count();
+  return mix(now) ^ mix(++calls * kGolden);
+}
+
+/**
+ * @brief Add an independent uniform amount in [-amount, amount] to every sample
+ * @param src Source RGB view
+ * @param dst Destination RGB view of the same size (may be src)
+ * @param amount Largest change in levels
+ * @param seed Noise seed
+ * @param x Image column of the views' left edge
+ * @param y Image row of the views' top edge
+ */
+void pixelJitter(const ConstImageView& src, const ImageView& dst, int amount, uint64_t seed,
+                 int x, int y) {
+  CounterRng rng(seed);
+  int span = 2 * std::max(0, amount) + 1;
+  parallelFor(0, dst.height(), [&](int begin, int end) {
+    for (int row = begin; row < end; row++) {
+      const unsigned char* in = src.row(row);
+      unsigned char* out = dst.row(row);
+      for (int col = 0; col < dst.width(); col++) {
+        for (int c = 0; c < 3; c++) {
+          int delta = rng.below(pixelCounter(x + col, y + row, c), span) - (span - 1) / 2;
+          out[col * dst.pixelStride() + c] = fixed::saturate(in[col * src.pixelStride() + c] + delta);
+        }
+      }
+    }
+  }, 16);
+}
+
+/**
+ * @brief Add monochrome Gaussian film grain
+ * @param src Source RGB view
+ * @param dst Destination RGB view of the same size (may be src)
+ * @param strength Standard deviation of the grain in levels at mid gray
+ * @param seed Noise seed
+ * @param x Image column of the views' left edge
+ * @param y Image row of the views' top edge
+ */
+void filmGrain(const ConstImageView& src, const ImageView& dst, float strength, uint64_t seed,
+               int x, int y) {
+  CounterRng rng(seed);
+  parallelFor(0, dst.height(), [&](int begin, int end) {
+    for (int row = begin; row < end; row++) {
+      const unsigned char* in = src.row(row);
+      unsigned char* out = dst.row(row);
+      for (int col = 0; col < dst.width(); col++) {
+        const unsigned char* p = in + col * src.pixelStride();
+        float luma = (0.3f * p[0] + 0.59f * p[1] + 0.11f * p[2]) / 255;
+        float grain = rng.gaussian(pixelCounter(x + col, y + row, 0)) * strength *
+                      4 * luma * (1 - luma);
+        int delta = (int) std::floor(grain + 0.5f);
+        unsigned char* o = out + col * dst.pixelStride();
+        o[0] = fixed::saturate(p[0] + delta);
+        o[1] = fixed::saturate(p[1] + delta);
+        o[2] = fixed::saturate(p[2] + delta);
+      }
+    }
+  }, 16);
+}
+
+/**
+ * @brief Quantize every channel with an 8x8 Bayer threshold matrix
+ * @param src Source RGB view
+ * @param dst Destination RGB view of the same size (may be src)
+ * @param levels Values kept per channel, at least 2
+ * @param x Image column of the views' left edge
+ * @param y Image row of the views' top edge
+ *
+ * A sample s levels above index n rounds up where the threshold
+ * (entry + 0.5) / 64 exceeds 1 - s, i.e. on a fraction s of the matrix.
+ */
+void orderedDither(const ConstImageView& src, const ImageView& dst, int levels, int x, int y) {
+  assert(levels >= 2);
+  int matrix[64];
+  for (int i = 0; i < 64; i++) matrix[i] = bayer(i % 8, i / 8);
+  parallelFor(0, dst.height(), [&](int begin, int end) {
+    for (int row = begin; row < end; row++) {
+      const unsigned char* in = src.row(row);
+      unsigned char* out = dst.row(row);
+      const int* thresholds = matrix + ((y + row) & 7) * 8;
+      for (int col = 0; col < dst.width(); col++) {
+        int threshold = 255 * (2 * thresholds[(x + col) & 7] + 1);
+        for (int c = 0; c < 3; c++) {
+          int v = in[col * src.pixelStride() + c];
+          int index = std::min(levels - 1, (128 * v * (levels - 1) + threshold) / (255 * 128));
+          out[col * dst.pixelStride() + c] = levelValue(index, levels);
+        }
+      }
+    }
+  }, 16);
+}
+
+/**
+ * @brief Quantize every channel by Floyd-Steinberg error diffusion
+ * @param src Source RGB view
+ * @param dst Destination RGB view of the same size (may be src)
+ * @param levels Values kept per channel, at least 2
+ *
+ * acc holds, per sample, the exact sum of weight * error (errors in 1/16
+ * levels, weights 7, 3, 5, 1 out of 16), so the order in which neighbours
+ * add to it cannot change the result. Two blocks on the same anti-diagonal
+ * are at least kBlock - 2 * kBand + 2 columns apart, so they never write
+ * the same samples.
+ */
+void floydSteinberg(const ConstImageView& src, const ImageView& dst, int levels) {
+  assert(levels >= 2);
+  const int kBand = 8, kBlock = 64;
+  static_assert(kBlock >= 2 * kBand, "blocks must outrun the skew of a band");
+  int w = dst.width(), h = dst.height();
+  if (w <= 0 || h <= 0) return;
+  std::vector<int> acc((size_t) w * h * 3, 0);
+  int bands = (h + kBand - 1) / kBand;
+  int blocks = (w + 2 * (kBand - 1) + kBlock - 1) / kBlock;
+
+  auto run = [&](int band, int block) {
+    for (int i = 0; i < kBand; i++) {
+      int row = band * kBand + i;
+      if (row >= h) break;
+      int begin = std::max(0, block * kBlock - 2 * i);
+      int end = std::min(w, block * kBlock - 2 * i + kBlock);
+      const unsigned char* in = src.row(row);
+      unsigned char* out = dst.row(row);
+      int* a = acc.data() + (size_t) row * w * 3;
+      int* below = row + 1 < h ? a + (size_t) w * 3 : nullptr;
+      for (int col = begin; col < end; col++) {
+        for (int c = 0; c < 3; c++) {
+          int i3 = col * 3 + c;
+          int value = std::min(255 * 16, std::max(0, 16 * in[col * src.pixelStride() + c] +
+                                                       a[i3] / 16));
+          int index = (value * (levels - 1) + 255 * 8) / (255 * 16);
+          int quantized = levelValue(index, levels);
+          out[col * dst.pixelStride() + c] = quantized;
+          int error = value - 16 * quantized;
+          if (col + 1 < w) a[i3 + 3] += 7 * error;
+          if (below) {
+            if (col > 0) below[i3 - 3] += 3 * error;
+            below[i3] += 5 * error;
+            if (col + 1 < w) below[i3 + 3] += error;
+          }
+        }
+      }
+    }
+  };
+
+  // block k of band b runs at step k + 2b
+  for (int step = 0; step < blocks + 2 * (bands - 1); step++) {
+    int first = std::max(0, (step - blocks + 2) / 2);
+    int last = std::min(bands - 1, step / 2);
+    parallelFor(first, last + 1, [&](int begin, int end) {
+      for (int band = begin; band < end; band++) run(band, step - 2 * band);
+    });
+  }
+}
+
+/**
+ * @brief Add independent uniform noise to every sample
+ * @param amount Largest change in levels
+ * @param seed Noise seed; the same seed gives the same image
+ * @return Jittered image
+ */
+Image Image::pixelJitter(int amount, uint64_t seed) const {
+  AGL_TRACE_SCOPE("Image::pixelJitter", (long long) mWidth * mHeight);
+  Image result(mWidth, mHeight);
+  agl::pixelJitter(view(), result.view(), amount, seed);
+  return result;
+}
+
+/**
+ * @brief Add monochrome film grain, strongest in the midtones
+ * @param strength Standard deviation of the grain in levels at mid gray
+ * @param seed Noise seed; the same seed gives the same image
+ * @return Grainy image
+ */
+Image Image::filmGrain(float strength, uint64_t seed) const {
+  AGL_TRACE_SCOPE("Image::filmGrain", (long long) mWidth * mHeight);
+  Image result(mWidth, mHeight);
+  agl::filmGrain(view(), result.view(), strength, seed);
+  return result;
+}
+
+/**
+ * @brief Reduce every channel to a few levels with a Bayer matrix
+ * @param levels Values kept per channel, at least 2
+ * @return Dithered image
+ */
+Image Image::orderedDither(int levels) const {
+  AGL_TRACE_SCOPE("Image::orderedDither", (long long) mWidth * mHeight);
+  Image result(mWidth, mHeight);
+  agl::orderedDither(view(), result.view(), levels);
+  return result;
+}
+
+/**
+ * @brief Reduce every channel to a few levels by error diffusion
+ * @param levels Values kept per channel, at least 2
+ * @return Dithered image
+ */
+Image Image::floydSteinberg(int levels) const {
+  AGL_TRACE_SCOPE("Image::floydSteinberg", (long long) mWidth * mHeight);
+  Image result(mWidth, mHeight);
+  agl::floydSteinberg(view(), result.view(), levels);
+  return result;
+}
+
+}  // namespace agl
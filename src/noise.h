@@ -0,0 +1,121 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the declarations for counter-based random numbers and
+* the noise and dithering operators built on them.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#ifndef AGL_NOISE_H_
+#define AGL_NOISE_H_
+
+#include <cmath>
+#include <cstdint>
+#include "image_view.h"
+
+namespace agl {
+
+/**
+ * @brief Random numbers that are a pure function of (seed, counter)
+ *
+ * Draw n of a seed is the SplitMix64 output at position n of the stream
+ * keyed by the hashed seed. There is no state to share or advance, so
+ * pixels can draw from their own counters (e.g. pixelCounter()) in any
+ * order, on any number of threads, and the result only depends on the seed.
+ */
+class CounterRng {
+ public:
+  explicit CounterRng(uint64_t seed) : mKey(mix(seed)) {}
+
+  // 64 random bits for the given counter
+  uint64_t bits(uint64_t counter) const { return mix(mKey + (counter + 1) * kGolden); }
+
+  // Uniform in [0, 1)
+  float uniform(uint64_t counter) const { return (bits(counter) >> 40) * (1.0f / (1 << 24)); }
+
+  // Uniform integer in [0, n) (n > 0)
+  int below(uint64_t counter, int n) const { return (int) ((bits(counter) >> 32) * n >> 32); }
+
+  // Standard normal (Box-Muller on the two halves of one draw)
+  float gaussian(uint64_t counter) const {
+    uint64_t b = bits(counter);
+    float u1 = ((b >> 40) + 1) * (1.0f / (1 << 24));  // (0, 1]
+    float u2 = (b & 0xFFFFFF) * (1.0f / (1 << 24));
+    return std::sqrt(-2 * std::log(u1)) * std::cos(6.2831853f * u2);
+  }
+
+  // SplitMix64 finalizer
+  static uint64_t mix(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+  }
+
+  // Seed that differs between calls, for operations not given one
+  static uint64_t freshSeed();
+
+ private:
+  static const uint64_t kGolden = 0x9E3779B97F4A7C15ull;
+  uint64_t mKey;
+};
+
+// Counter of channel c of pixel (x, y), independent of the image width
+inline uint64_t pixelCounter(int x, int y, int c) {
+  return ((uint64_t) (uint32_t) y << 34) | ((uint64_t) (uint32_t) x << 2) | (uint64_t) c;
+}
+
+// Noise and ordered dithering are keyed to image coordinates: x and y give
+// the position of the views' top left pixel, so a tile draws exactly the
+// numbers the same pixels draw when the whole image is processed.
+
+/**
+ * @brief Add an independent uniform amount in [-amount, amount] to every sample
+ * @param src Source RGB view
+ * @param dst Destination RGB view of the same size (may be src)
+ * @param amount Largest change in levels
+ * @param seed Noise seed
+ */
+void pixelJitter(const ConstImageView& src, const ImageView& dst, int amount, uint64_t seed,
+                 int x = 0, int y = 0);
+
+/**
+ * @brief Add monochrome Gaussian film grain
+ * @param src Source RGB view
+ * @param dst Destination RGB view of the same size (may be src)
+ * @param strength Standard deviation of the grain in levels at mid gray
+ * @param seed Noise seed
+ *
+ * Every channel of a pixel gets the same amount, scaled by 4 l (1 - l)
+ * for the pixel's luma l in [0, 1], so grain fades out in black and white.
+ */
+void filmGrain(const ConstImageView& src, const ImageView& dst, float strength, uint64_t seed,
+               int x = 0, int y = 0);
+
+/**
+ * @brief Quantize every channel to levels values with an 8x8 Bayer threshold matrix
+ * @param src Source RGB view
+ * @param dst Destination RGB view of the same size (may be src)
+ * @param levels Values kept per channel, at least 2
+ */
+void orderedDither(const ConstImageView& src, const ImageView& dst, int levels,
+                   int x = 0, int y = 0);
+
+/**
+ * @brief Quantize every channel to levels values by Floyd-Steinberg error diffusion
+ * @param src Source RGB view
+ * @param dst Destination RGB view of the same size (may be src)
+ * @param levels Values kept per channel, at least 2
+ *
+ * Pixel (r, c) needs the errors of (r, c - 1) and (r - 1, c + 1), so row
+ * r may run two columns behind row r - 1. Rows are grouped into bands
+ * whose column blocks are skewed by two pixels per row; block k of band b
+ * only waits for block k + 1 of band b - 1, so the blocks on each
+ * anti-diagonal k + 2b run in parallel. Errors are kept in integer 1/16
+ * levels, so the result is the same as a serial scan.
+ */
+void floydSteinberg(const ConstImageView& src, const ImageView& dst, int levels);
+
+}  // namespace agl
+#endif  // AGL_NOISE_H_
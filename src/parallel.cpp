@@ -0,0 +1,182 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the method definitions for the worker thread pool.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace agl {
+
+namespace {
+
+thread_local bool tInWorker = false;
+
+}  // namespace
+
+/**
+ * @brief Start the worker threads
+ * @param threads Number of threads taking part in parallel loops (0 = hardware concurrency)
+ */
+ThreadPool::ThreadPool(int threads) : mStopping(false) {
+  if (threads <= 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  // the caller of parallelFor is the last thread
+  for (int i = 0; i < threads - 1; i++) {
+    mWorkers.push_back(std::thread(&ThreadPool::workerLoop, this));
+  }
+}
+
+/**
+ * @brief Finish queued tasks and join the workers
+ */
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStopping = true;
+  }
+  mWake.notify_all();
+  for (std::thread& worker : mWorkers) {
+    worker.join();
+  }
+}
+
+/**
+ * @brief Get the number of threads taking part in parallel loops
+ * @return Workers plus the calling thread
+ */
+int ThreadPool::size() const { return (int) mWorkers.size() + 1; }
+
+/**
+ * @brief Queue a task for the workers
+ * @param task Function to run
+ *
+ * A pool without workers runs the task immediately on the calling thread.
+ */
+void ThreadPool::submit(const std::function<void()>& task) {
+  if (mWorkers.empty()) {
+    task();
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mTasks.push_back(task);
+  }
+  mWake.notify_one();
+}
+
+/**
+ * @brief Run fn over [begin, end) split into chunks across the pool
+ * @param begin First index
+ * @param end One past the last index
+ * @param fn Called as fn(chunkBegin, chunkEnd)
+ * @param grain Smallest chunk size
+ */
+void ThreadPool::parallelFor(int begin, int end, const std::function<void(int, int)>& fn, int grain) {
+  int count = end - begin;
+  if (count <= 0) {
+    return;
+  }
+  grain = std::max(1, grain);
+  // a few chunks per thread keeps the load balanced
+  int chunks = std::min((count + grain - 1) / grain, size() * 4);
+  if (chunks <= 1 || mWorkers.empty() || tInWorker) {
+    fn(begin, end);
+    return;
+  }
+
+  // Helpers that start after the last chunk only touch the shared state,
+  // which stays alive through the shared_ptr they hold
+  struct Loop {
+    std::atomic<int> next;
+    std::atomic<int> done;
+    std::mutex mutex;
+    std::condition_variable finished;
+  };
+  std::shared_ptr<Loop> loop = std::make_shared<Loop>();
+  loop->next = 0;
+  loop->done = 0;
+  const std::function<void(int, int)>* body = &fn;
+  auto runChunks = [loop, body, begin, count, chunks]() {
+    int chunk;
+    while ((chunk = loop->next.fetch_add(1)) < chunks) {
+      int b = begin + (int) ((long) count * chunk / chunks);
+      int e = begin + (int) ((long) count * (chunk + 1) / chunks);
+      (*body)(b, e);
+      if (loop->done.fetch_add(1) + 1 == chunks) {
+        std::lock_guard<std::mutex> lock(loop->mutex);
+        loop->finished.notify_all();
+      }
+    }
+  };
+
+  int helpers = std::min((int) mWorkers.size(), chunks - 1);
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (int i = 0; i < helpers; i++) {
+      mTasks.push_back(runChunks);
+    }
+  }
+  mWake.notify_all();
+  runChunks();
+
+  std::unique_lock<std::mutex> lock(loop->mutex);
+  loop->finished.wait(lock, [&]() { return loop->done.load() == chunks; });
+}
+
+/**
+ * @brief Get the pool shared by all image operations
+ * @return Pool with one thread per hardware thread
+ */
+ThreadPool& ThreadPool::global() {
+  static ThreadPool pool;
+  return pool;
+}
+
+/**
+ * @brief Check whether the calling thread is a pool worker
+ * @return true inside a worker
+ */
+bool ThreadPool::inWorker() { return tInWorker; }
+
+/**
+ * @brief Run one queued task, releasing the lock while it runs
+ * @param lock Held lock on mMutex
+ * @return false when the queue was empty
+ */
+bool ThreadPool::runOne(std::unique_lock<std::mutex>& lock) {
+  if (mTasks.empty()) {
+    return false;
+  }
+  std::function<void()> task = mTasks.front();
+  mTasks.pop_front();
+  lock.unlock();
+  task();
+  lock.lock();
+  return true;
+}
+
+/**
+ * @brief Worker thread body: run tasks until the pool is destroyed
+ */
+void ThreadPool::workerLoop() {
+  tInWorker = true;
+  std::unique_lock<std::mutex> lock(mMutex);
+  while (true) {
+    mWake.wait(lock, [this]() { return mStopping || !mTasks.empty(); });
+    if (mTasks.empty() && mStopping) {
+      return;
+    }
+    runOne(lock);
+  }
+}
+
+}  // namespace agl
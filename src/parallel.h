@@ -0,0 +1,78 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the declarations for the worker thread pool used to
+* run image operations in parallel.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#ifndef AGL_PARALLEL_H_
+#define AGL_PARALLEL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace agl {
+
+/**
+ * @brief Fixed set of worker threads that run queued tasks
+ *
+ * Threads are started once and kept warm between calls. parallelFor()
+ * blocks until every chunk has run; the calling thread works on chunks too.
+ * Calls made from inside a worker run inline, so nested parallel loops
+ * cannot deadlock the pool.
+ */
+class ThreadPool {
+ public:
+  // Start the given number of workers (0 = one per hardware thread)
+  explicit ThreadPool(int threads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // Number of threads taking part in parallelFor (workers plus the caller)
+  int size() const;
+
+  // Queue a task to run on a worker thread
+  void submit(const std::function<void()>& task);
+
+  /**
+   * @brief Split [begin, end) into chunks and run fn(chunkBegin, chunkEnd) on each
+   * @param begin First index
+   * @param end One past the last index
+   * @param fn Function called once per chunk
+   * @param grain Smallest chunk worth handing to another thread
+   */
+  void parallelFor(int begin, int end, const std::function<void(int, int)>& fn, int grain = 1);
+
+  // Pool shared by all image operations
+  static ThreadPool& global();
+
+  // True when called from one of this process's pool workers
+  static bool inWorker();
+
+ private:
+  void workerLoop();
+  bool runOne(std::unique_lock<std::mutex>& lock);
+
+  std::vector<std::thread> mWorkers;
+  std::deque<std::function<void()>> mTasks;
+  std::mutex mMutex;
+  std::condition_variable mWake;
+  bool mStopping;
+};
+
+// Run fn over [begin, end) on the global pool (see ThreadPool::parallelFor)
+inline void parallelFor(int begin, int end, const std::function<void(int, int)>& fn, int grain = 1) {
+  ThreadPool::global().parallelFor(begin, end, fn, grain);
+}
+
+}  // namespace agl
+#endif  // AGL_PARALLEL_H_
@@ -0,0 +1,141 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the definitions for the asynchronous
+* decode, process and encode pipeline.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#include "pipeline.h"
+
+#include <algorithm>
+
+namespace agl {
+
+/**
+ * @brief One decoder and encoder, one processor per hardware thread
+ */
+PipelineOptions::PipelineOptions()
+    : decodeWorkers(1), processWorkers(0), encodeWorkers(1), queueCapacity(4) {}
+
+/**
+ * @brief Start the stage workers
+ * @param process Filter applied to every decoded image
+ * @param options Worker counts and queue capacity
+ */
+Pipeline::Pipeline(const Process& process, const PipelineOptions& options)
+    : mProcess(process),
+      mDecodeQueue(std::max(1, options.queueCapacity)),
+      mProcessQueue(std::max(1, options.queueCapacity)),
+      mEncodeQueue(std::max(1, options.queueCapacity)),
+      mFinished(false) {
+  int processWorkers = options.processWorkers;
+  if (processWorkers <= 0) {
+    processWorkers = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for (int i = 0; i < std::max(1, options.decodeWorkers); i++) {
+    mDecoders.push_back(std::thread(&Pipeline::decodeLoop, this));
+  }
+  for (int i = 0; i < processWorkers; i++) {
+    mProcessors.push_back(std::thread(&Pipeline::processLoop, this));
+  }
+  for (int i = 0; i < std::max(1, options.encodeWorkers); i++) {
+    mEncoders.push_back(std::thread(&Pipeline::encodeLoop, this));
+  }
+}
+
+Pipeline::~Pipeline() {
+  finish();
+}
+
+/**
+ * @brief Queue one image
+ * @param input File to load
+ * @param output File to save to
+ * @param done Optional completion callback
+ * @return Future for the outcome
+ */
+std::future<bool> Pipeline::submit(const std::string& input, const std::string& output,
+                                   const Callback& done) {
+  JobPtr job(new Job());
+  job->input = input;
+  job->output = output;
+  job->done = done;
+  std::future<bool> result = job->result.get_future();
+  if (!mDecodeQueue.push(job)) {
+    complete(*job, false);
+  }
+  return result;
+}
+
+/**
+ * @brief Drain every stage in order and join the workers
+ *
+ * Call from the thread that owns the pipeline once it is done submitting.
+ */
+void Pipeline::finish() {
+  if (mFinished) return;
+  mFinished = true;
+  mDecodeQueue.close();
+  for (std::thread& t : mDecoders) t.join();
+  mProcessQueue.close();
+  for (std::thread& t : mProcessors) t.join();
+  mEncodeQueue.close();
+  for (std::thread& t : mEncoders) t.join();
+}
+
+/**
+ * @brief Report the outcome of a job through its future and callback
+ */
+void Pipeline::complete(Job& job, bool ok) {
+  if (job.done) {
+    job.done(job.input, ok);
+  }
+  job.result.set_value(ok);
+}
+
+/**
+ * @brief Report an exception thrown while processing a job
+ */
+void Pipeline::fail(Job& job, std::exception_ptr error) {
+  if (job.done) {
+    job.done(job.input, false);
+  }
+  job.result.set_exception(error);
+}
+
+void Pipeline::decodeLoop() {
+  JobPtr job;
+  while (mDecodeQueue.pop(job)) {
+    if (job->image.load(job->input)) {
+      mProcessQueue.push(job);
+    } else {
+      complete(*job, false);
+    }
+  }
+}
+
+void Pipeline::processLoop() {
+  JobPtr job;
+  while (mProcessQueue.pop(job)) {
+    try {
+      job->image = mProcess(job->image);
+    } catch (...) {
+      // an exception leaving a worker thread would terminate the program
+      fail(*job, std::current_exception());
+      continue;
+    }
+    mEncodeQueue.push(job);
+  }
+}
+
+void Pipeline::encodeLoop() {
+  JobPtr job;
+  while (mEncodeQueue.pop(job)) {
+    complete(*job, job->image.save(job->output));
+  }
+}
+
+}  // namespace agl
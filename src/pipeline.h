@@ -0,0 +1,112 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the declarations for the asynchronous
+* decode, process and encode pipeline.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#ifndef AGL_PIPELINE_H_
+#define AGL_PIPELINE_H_
+
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bounded_queue.h"
+#include "image.h"
+
+namespace agl {
+
+/**
+ * @brief Worker counts and queue sizes for a Pipeline
+ */
+struct PipelineOptions {
+  PipelineOptions();
+
+  // Threads per stage (0 processWorkers = one per hardware thread)
+  int decodeWorkers;
+  int processWorkers;
+  int encodeWorkers;
+
+  // Images that may wait between two stages before the earlier stage blocks
+  int queueCapacity;
+};
+
+/**
+ * @brief Load, filter and save images on overlapping stages
+ *
+ * Decode, process and encode each run on their own threads, connected by
+ * bounded lock-free queues, so file I/O and codec work overlap with the
+ * filter. When a later stage falls behind its input queue fills and the
+ * stage before it (and finally submit()) blocks.
+ *
+ * The process function may itself use parallelFor(); it runs on the global
+ * ThreadPool as usual.
+ */
+class Pipeline {
+ public:
+  typedef std::function<Image(const Image&)> Process;
+  typedef std::function<void(const std::string& input, bool ok)> Callback;
+
+  explicit Pipeline(const Process& process, const PipelineOptions& options = PipelineOptions());
+
+  // Finishes outstanding work (see finish())
+  ~Pipeline();
+
+  Pipeline(const Pipeline&) = delete;
+  Pipeline& operator=(const Pipeline&) = delete;
+
+  /**
+   * @brief Queue one image
+   * @param input File to load
+   * @param output File to save the processed image to
+   * @param done Optional callback, run on an encode worker (or the decode
+   *    or process worker if the image fails there) when the image is finished
+   * @return Future that is true once the output is saved, false if the
+   *    input could not be loaded or the output could not be saved. If the
+   *    process function throws, get() rethrows its exception (and done is
+   *    told the image failed); the workers carry on with the next image.
+   *
+   * Blocks while the decode queue is full.
+   */
+  std::future<bool> submit(const std::string& input, const std::string& output,
+                           const Callback& done = Callback());
+
+  // Wait for every queued image and stop the workers; later submits fail
+  void finish();
+
+ private:
+  struct Job {
+    std::string input;
+    std::string output;
+    Callback done;
+    std::promise<bool> result;
+    Image image;
+  };
+  typedef std::unique_ptr<Job> JobPtr;
+
+  static void complete(Job& job, bool ok);
+  static void fail(Job& job, std::exception_ptr error);
+
+  void decodeLoop();
+  void processLoop();
+  void encodeLoop();
+
+  Process mProcess;
+  BoundedQueue<JobPtr> mDecodeQueue;
+  BoundedQueue<JobPtr> mProcessQueue;
+  BoundedQueue<JobPtr> mEncodeQueue;
+  std::vector<std::thread> mDecoders;
+  std::vector<std::thread> mProcessors;
+  std::vector<std::thread> mEncoders;
+  bool mFinished;
+};
+
+}  // namespace agl
+#endif  // AGL_PIPELINE_H_
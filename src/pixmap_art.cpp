@@ -1,86 +1,113 @@
 #include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "graph.h"
 #include "image.h"
+#include "image_cache.h"
+#include "metrics.h"
 using namespace std;
 using namespace agl;
 
+// With --verify the outputs are compared with the images already in art/
+// instead of overwriting them
+static bool verify = false;
+static int regressions = 0;
+
+// Shared cached decode, or an empty image if the file cannot be loaded
+static std::shared_ptr<const Image> cached(const std::string& filename)
+{
+   std::shared_ptr<const Image> image = ImageCache::global().load(filename);
+   return image ? image : std::make_shared<const Image>();
+}
+
+// Save an output as ../art/<name>.png, or with --verify compare it with the
+// image saved there. Near duplicates (SSIM of at least 0.99 and perceptual
+// hashes at most 2 bits apart) pass, to allow for floating point differences
+// between compilers.
+static void output(const Image& image, const std::string& name)
+{
+   std::string path = "../art/" + name + ".png";
+   if (!verify) {
+      image.save(path);
+      return;
+   }
+   Image loaded;
+   const Image& saved = loaded;
+   if (!loaded.load(path) || saved.width() != image.width() || saved.height() != image.height()) {
+      cout << path << ": missing or a different size" << endl;
+      regressions++;
+      return;
+   }
+   if (identical(image.view(), saved.view())) {
+      cout << path << ": identical" << endl;
+      return;
+   }
+   DiffStats diff = compare(image.view(), saved.view());
+   double similarity = ssim(image.view(), saved.view());
+   int bits = hammingDistance(perceptualHash(image.view()), perceptualHash(saved.view()));
+   bool ok = similarity >= 0.99 && bits <= 2;
+   cout << path << ": max error " << diff.maxAbsError << ", PSNR " << psnr(image.view(), saved.view())
+        << " dB, SSIM " << similarity << ", phash distance " << bits << (ok ? "" : " REGRESSED")
+        << endl;
+   if (!ok) regressions++;
+}
+
 int main(int argc, char** argv)
 {
+   verify = argc > 1 && std::string(argv[1]) == "--verify";
+
    // Image 1
-   Image haverford;
-   haverford.load("../images/haverford.jpg");
-   haverford = haverford.colorReplace(Pixel(35,64,48), Pixel(0,0,0), 80);
-   Image galaxy;
-   galaxy.load("../images/galaxy.png");
-   galaxy = galaxy.resize(haverford.width(), haverford.height());
+   Image haverford = cached("../images/haverford.jpg")->colorReplace(Pixel(35,64,48), Pixel(0,0,0), 80);
+   Image galaxy = cached("../images/galaxy.png")->resize(haverford.width(), haverford.height());
    haverford = haverford.lightest(galaxy);
-   haverford.save("../art/haverford.png");
+   output(haverford, "haverford");
 
    // Image 2
-   Image beach;
-   beach.load("../images/beach.png");
-   beach = beach.sobel();
+   Image beach = cached("../images/beach.png")->sobel();
    beach = beach.grayscale();
    beach = beach.invert();
    beach = beach.colorReplace(Pixel(0, 0, 0), Pixel(0, 0, 255), 240);
-   beach.save("../art/beach.png");
+   output(beach, "beach");
 
    // Image 3
-   Image spongebob;
-   spongebob.load("../images/spongebob.png");
    int rShift[2] = {-10, 0};
    int gShift[2] = {0, 10};
    int bShift[2] = {10, 0};
-   spongebob = spongebob.colorReplace(Pixel(126, 190, 190), Pixel(0, 0, 0), 80);
+   Image spongebob = cached("../images/spongebob.png")->colorReplace(Pixel(126, 190, 190), Pixel(0, 0, 0), 80);
    spongebob = spongebob.resize(spongebob.width() / 2, spongebob.height() / 2);
-   Image fire;
-   fire.load("../images/fire.jpg");
    spongebob = spongebob.halftone(rShift, bShift, gShift);
-   fire = fire.resize(spongebob.width(), spongebob.height());
+   Image fire = cached("../images/fire.jpg")->resize(spongebob.width(), spongebob.height());
    spongebob = spongebob.lightest(fire);
-   spongebob.save("../art/spongebob.png");
-
-   Image earth;
-   earth.load("../images/earth.png");
-
-   Image rotated;
-   rotated = earth.rotate90();
-   rotated.save("../art/rotate90.png");
-
-   Image inverted;
-   inverted = earth.invert();
-   inverted.save("../art/invert.png");
-
-   Image jittered;
-   jittered = earth.colorJitter(50);
-   jittered.save("../art/colorJitter.png");
-
-   Image channelShifted;
-   channelShifted = earth.channelShift(rShift, gShift, bShift);
-   channelShifted.save("../art/channelShift.png");
-
-   Image halftoned;
-   halftoned = earth.halftone(rShift, gShift, bShift);
-   halftoned = halftoned.resize(400, 400);
-   halftoned.save("../art/halftone2.png");
-
-   Image lightest;
-   galaxy.resize(earth.width(), earth.height());
-   lightest = earth.lightest(galaxy);
-   lightest.save("../art/lightest.png");
-
-   Image colorReplaced;
-   colorReplaced = earth.colorReplace(Pixel(0, 0, 0), Pixel(10, 50, 30), 50);
-   colorReplaced.save("../art/colorReplace.png");
-
-   Image sobeled;
-   sobeled = earth.sobel();
-   sobeled.save("../art/sobel.png");
-
-   Image blurred;
-   blurred = earth.gaussianBlur(5);
-   blurred.save("../art/gaussianBlur.png");
-
-
-   return 0;
+   output(spongebob, "spongebob");
+
+   // every earth variant comes from one tiled pass over a shared graph
+   std::shared_ptr<const Image> earth = cached("../images/earth.png");
+   galaxy = cached("../images/galaxy.png")->resize(earth->width(), earth->height());
+
+   Graph graph;
+   Graph::Node source = graph.source(earth);
+   std::vector<Graph::Node> variants = {
+      graph.rotate90(source),
+      graph.invert(source),
+      graph.colorJitter(source, 50, 2023),
+      graph.channelShift(source, rShift, gShift, bShift),
+      graph.resize(graph.halftone(source, rShift, gShift, bShift), 400, 400),
+      graph.lightest(source, graph.source(galaxy)),
+      graph.colorReplace(source, Pixel(0, 0, 0), Pixel(10, 50, 30), 50),
+      graph.sobel(source),
+      graph.gaussianBlur(source, 5)};
+   const char* names[] = {"rotate90", "invert", "colorJitter", "channelShift", "halftone2",
+                          "lightest", "colorReplace", "sobel", "gaussianBlur"};
+   std::vector<Image> rendered = graph.render(variants);
+   for (int i = 0; i < (int) rendered.size(); i++) {
+      output(rendered[i], names[i]);
+   }
+
+   ImageCache::Stats stats = ImageCache::global().stats();
+   cout << "image cache: " << stats.hits << " hits, " << stats.misses
+        << " misses (" << stats.hitRate() * 100 << "%)" << endl;
+
+   return regressions ? 1 : 0;
 }
 
@@ -0,0 +1,77 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the image server daemon and a one shot client for it.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#include <signal.h>
+#include <iostream>
+#include <string>
+#include <thread>
+#include "server.h"
+using namespace std;
+using namespace agl;
+
+static void usage()
+{
+   cout << "usage: pixmap_server [socket]\n"
+        << "         serve jobs until interrupted (default socket /tmp/pixmap.sock)\n"
+        << "       pixmap_server socket input output [op args... [| op args...]]\n"
+        << "         run one job on a local file, passing pixels in shared memory\n\n"
+        << "ops:\n" << ImageServer::ops();
+}
+
+int main(int argc, char** argv)
+{
+   if (argc == 2 && (string(argv[1]) == "-h" || string(argv[1]) == "--help")) {
+      usage();
+      return 0;
+   }
+   string socket = argc > 1 ? argv[1] : "/tmp/pixmap.sock";
+
+   if (argc > 3) {
+      string ops;
+      for (int i = 4; i < argc; i++) ops += string(i > 4 ? " " : "") + argv[i];
+      Image in, out;
+      if (!in.load(argv[2])) {
+         cerr << "Error: cannot load " << argv[2] << endl;
+         return 1;
+      }
+      ImageClient client;
+      if (!client.connect(socket)) {
+         cerr << "Error: no server on " << socket << endl;
+         return 1;
+      }
+      if (!client.run(in, ops, out)) {
+         cerr << client.error() << endl;
+         return 1;
+      }
+      return out.save(argv[3]) ? 0 : 1;
+   }
+   if (argc == 3) {
+      usage();
+      return 1;
+   }
+
+   // handle SIGINT and SIGTERM on this thread only, so the server can shut down cleanly
+   sigset_t signals;
+   sigemptyset(&signals);
+   sigaddset(&signals, SIGINT);
+   sigaddset(&signals, SIGTERM);
+   pthread_sigmask(SIG_BLOCK, &signals, NULL);
+   signal(SIGPIPE, SIG_IGN);
+
+   ImageServer server(socket);
+   if (!server.start()) return 1;
+   cout << "listening on " << socket << endl;
+   std::thread serving([&server]() { server.serve(); });
+   int received = 0;
+   sigwait(&signals, &received);
+   server.stop();
+   serving.join();
+   cout << "served " << server.jobs() << " jobs" << endl;
+   return 0;
+}
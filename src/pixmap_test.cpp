@@ -7,13 +7,923 @@
 * @version: February 2, 2023
 */
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#ifdef _WIN32
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
+#include "components.h"
+#include "composite.h"
+#include "fft.h"
+#include "fixed_point.h"
+#include "graph.h"
 #include "image.h"
+#include "image_cache.h"
+#include "halftone.h"
+#include "histogram.h"
+#include "kernel.h"
+#include "metrics.h"
+#include "morphology.h"
+#include "pipeline.h"
+#include "pyramid.h"
+#include "region.h"
+#include "seam.h"
+#include "sequence.h"
+#ifdef UNIX
+#include "server.h"
+#endif
+#include "trace.h"
 using namespace std;
 using namespace agl;
 
+namespace {
+
+// fixed_point.h is constexpr, so its edge cases are checked while compiling
+static_assert(fixed::mulDiv255(0, 0) == 0 && fixed::mulDiv255(0, 255) == 0, "mulDiv255 by 0");
+static_assert(fixed::mulDiv255(1, 255) == 1 && fixed::mulDiv255(254, 255) == 254 &&
+              fixed::mulDiv255(255, 255) == 255, "mulDiv255 by 255 is the identity");
+static_assert(fixed::mulDiv255(1, 1) == 0 && fixed::mulDiv255(1, 254) == 1 &&
+              fixed::mulDiv255(254, 254) == 253 && fixed::mulDiv255(128, 255) == 128,
+              "mulDiv255 rounds to nearest");
+static_assert(fixed::mulDiv255(127, 128) == 64 && fixed::mulDiv255(128, 128) == 64,
+              "mulDiv255 rounds 63.75 and 64.25 to 64");
+static_assert(fixed::lerpQ8(0, 255, 0) == 0 && fixed::lerpQ8(0, 255, 256) == 255 &&
+              fixed::lerpQ8(255, 0, 0) == 255 && fixed::lerpQ8(255, 0, 256) == 0,
+              "lerpQ8 endpoints");
+static_assert(fixed::lerpQ8(0, 255, 128) == 128 && fixed::lerpQ8(10, 10, 77) == 10,
+              "lerpQ8 midpoint rounds up, equal ends stay put");
+static_assert(fixed::lerpQ16(0, 255, 0) == 0 && fixed::lerpQ16(0, 255, 65536) == 255,
+              "lerpQ16 endpoints");
+static_assert(fixed::toQ8(-1.0f) == 0 && fixed::toQ8(0.5f) == 128 && fixed::toQ8(2.0f) == 256,
+              "toQ8 clamps to [0, 1]");
+static_assert(fixed::addSat(200, 55) == 255 && fixed::addSat(200, 56) == 255 &&
+              fixed::addSat(0, 0) == 0 && fixed::addSat(100, 27) == 127, "addSat clamps at 255");
+static_assert(fixed::subSat(5, 6) == 0 && fixed::subSat(6, 5) == 1 && fixed::subSat(0, 255) == 0,
+              "subSat clamps at 0");
+static_assert(fixed::saturate(-1) == 0 && fixed::saturate(0) == 0 && fixed::saturate(255) == 255 &&
+              fixed::saturate(256) == 255 && fixed::saturate(1000) == 255, "saturate clamps");
+static_assert(fixed::scaleQ16(255, fixed::toScaleQ16(1.0f)) == 255 &&
+              fixed::scaleQ16(100, fixed::toScaleQ16(0.5f)) == 50 &&
+              fixed::scaleQ16(200, fixed::toScaleQ16(2.0f)) == 255 &&
+              fixed::scaleQ16(1, fixed::toScaleQ16(1e9f)) == 255, "scaleQ16 saturates");
+
+// a const image only hands out read-only pixels, so writes cannot skip invalidate()
+static_assert(std::is_same<decltype(std::declval<const Image&>().view()), ConstImageView>::value &&
+              std::is_same<decltype(std::declval<const Image&>().subimage(0, 0, 1, 1)),
+                           ConstImageView>::value, "views of a const image are read-only");
+static_assert(std::is_convertible<ImageView, ConstImageView>::value &&
+              !std::is_convertible<ConstImageView, ImageView>::value,
+              "writable views convert to read-only ones and not back");
+
+int failures = 0;
+
+// Print the outcome of a check, counting it if it failed
+void check(const char* what, bool ok)
+{
+   cout << what << ": " << (ok ? "ok" : "FAILED") << endl;
+   if (!ok) failures++;
+}
+
+// Image of random samples (from rand(), so seed with srand())
+Image randomImage(int width, int height)
+{
+   Image image(width, height);
+   for (int i = 0; i < width * height * 3; i++) {
+      image.data()[i] = (unsigned char) (rand() % 256);
+   }
+   return image;
+}
+
+// round(a * b / 255); the odd divisor never leaves a tie
+int mulDivRef(int a, int b)
+{
+   return (a * b + 127) / 255;
+}
+
+// composite() one pixel at a time with the formulas of composite.h. Alpha
+// planes and the mask are channel 0 of their images and NULL if absent.
+void compositeReference(const Image& src, Image& dst, int x, int y, CompositeOp op,
+                        const Image* srcAlpha, Image* dstAlpha, const Image* mask, int opacity)
+{
+   for (int row = std::max(y, 0); row < std::min(y + src.height(), dst.height()); row++) {
+      for (int col = std::max(x, 0); col < std::min(x + src.width(), dst.width()); col++) {
+         int k = mask ? mulDivRef(opacity, mask->get(row - y, col - x).r) : opacity;
+         int as = srcAlpha ? mulDivRef(srcAlpha->get(row - y, col - x).r, k) : k;
+         int ad = dstAlpha ? dstAlpha->get(row, col).r : 255;
+         int fa = 255, fb = 0;
+         switch (op) {
+            case CompositeOp::Source: fa = 255;      fb = 0;        break;
+            case CompositeOp::Over:   fa = 255;      fb = 255 - as; break;
+            case CompositeOp::In:     fa = ad;       fb = 0;        break;
+            case CompositeOp::Out:    fa = 255 - ad; fb = 0;        break;
+            case CompositeOp::Atop:   fa = ad;       fb = 255 - as; break;
+            case CompositeOp::Xor:    fa = 255 - ad; fb = 255 - as; break;
+         }
+         if (dstAlpha) {
+            Pixel a = dstAlpha->get(row, col);
+            a.r = std::min(255, mulDivRef(as, fa) + mulDivRef(ad, fb));
+            dstAlpha->set(row, col, a);
+         }
+         Pixel s = src.get(row - y, col - x), d = dst.get(row, col);
+         int sf = mulDivRef(fa, k);
+         dst.set(row, col, Pixel(std::min(255, mulDivRef(s.r, sf) + mulDivRef(d.r, fb)),
+                                 std::min(255, mulDivRef(s.g, sf) + mulDivRef(d.g, fb)),
+                                 std::min(255, mulDivRef(s.b, sf) + mulDivRef(d.b, fb))));
+      }
+   }
+}
+
+// Kernel of random weights in [-1, 1]
+std::vector<float> randomKernel(int kSize)
+{
+   std::vector<float> kernel(kSize * kSize);
+   for (float& w : kernel) w = rand() / (float) RAND_MAX * 2 - 1;
+   return kernel;
+}
+
+// Largest difference between two convolution outputs, relative to the
+// largest output a kernel can produce (255 * sum |w|)
+float convolutionError(const std::vector<float>& kernel, const std::vector<float>& a,
+                       const std::vector<float>& b)
+{
+   float range = 0, error = 0;
+   for (float w : kernel) range += std::fabs(w) * 255;
+   for (size_t i = 0; i < a.size(); i++) error = std::max(error, std::fabs(a[i] - b[i]));
+   return error / range;
+}
+
+// convolveFFT() against convolveDirect() for odd and even kernels, views
+// smaller than the kernel and a strided subview
+void testConvolveFFT()
+{
+   srand(39);
+   Image image = randomImage(160, 120);
+   const int cases[][5] = {
+      // kSize, x, y, width, height of the view
+      {31, 0, 0, 97, 61}, {32, 0, 0, 97, 61}, {24, 0, 0, 15, 10}, {33, 5, 5, 1, 1},
+      {8, 0, 0, 160, 7}, {17, 13, 9, 120, 100}, {64, 20, 30, 40, 50}};
+   float worst = 0;
+   for (const int* c : cases) {
+      std::vector<float> kernel = randomKernel(c[0]);
+      ConstImageView view = static_cast<const Image&>(image).subimage(c[1], c[2], c[3], c[4]);
+      std::vector<float> fast(c[3] * c[4] * 3), direct(c[3] * c[4] * 3);
+      convolveFFT(view, kernel.data(), c[0], fast.data());
+      convolveDirect(view, kernel.data(), c[0], direct.data());
+      worst = std::max(worst, convolutionError(kernel, fast, direct));
+   }
+   cout << "convolveFFT largest relative error: " << worst << endl;
+   check("convolveFFT matches convolveDirect", worst < 1e-5f);
+}
+
+// Kernel decomposition: ranks found by the SVD, and the separable passes
+// against direct convolution, including the kernels of sobel() and
+// gaussianBlur()
+void testKernels(const Image& image)
+{
+   srand(40);
+   bool ranksOk = true;
+   float worst = 0;
+   const ConstImageView view = image.view();
+   std::vector<float> direct(view.width() * view.height() * 3);
+   std::vector<float> applied(direct.size()), separable(direct.size());
+   auto checkKernel = [&](const Kernel& kernel) {
+      kernel.apply(view, applied.data());
+      kernel.applySeparable(view, separable.data());
+      convolveDirect(view, kernel.weights().data(), kernel.size(), direct.data());
+      worst = std::max(worst, convolutionError(kernel.weights(), applied, direct));
+      worst = std::max(worst, convolutionError(kernel.weights(), separable, direct));
+   };
+   for (int size : {3, 7, 15}) {
+      std::vector<float> column = randomKernel(size), row = randomKernel(size), outer;
+      column.resize(size);
+      row.resize(size);
+      for (int i = 0; i < size * size; i++) outer.push_back(column[i / size] * row[i % size]);
+      Kernel rankOne(outer.data(), size);
+      ranksOk = ranksOk && rankOne.rank() == 1;
+      checkKernel(rankOne);
+   }
+   for (int size : {3, 5, 9}) {
+      Kernel full(randomKernel(size).data(), size);
+      ranksOk = ranksOk && full.rank() == size;
+      checkKernel(full);
+   }
+   check("kernel ranks", ranksOk);
+
+   Kernel gaussian = Kernel::gaussian(2);
+   checkKernel(gaussian);
+   cout << "separable largest relative error: " << worst << endl;
+   check("separable passes match convolveDirect", worst < 1e-4f);
+
+   // sobel's kernels, built as sobel() builds them, have small integer
+   // weights, so the separable passes are exact
+   const float sobelX[9] = {-1, 0, 1, -2, 0, 2, -1, 0, 1};
+   const float sobelY[9] = {-1, -2, -1, 0, 0, 0, 1, 2, 1};
+   bool sobelExact = true;
+   Kernel({1, 2, 1}, {-1, 0, 1}).apply(view, applied.data());
+   convolveDirect(view, sobelX, 3, direct.data());
+   sobelExact = sobelExact && applied == direct;
+   Kernel({-1, 0, 1}, {1, 2, 1}).apply(view, applied.data());
+   convolveDirect(view, sobelY, 3, direct.data());
+   sobelExact = sobelExact && applied == direct;
+   check("sobel kernels match convolveDirect exactly", sobelExact);
+
+   // gaussianBlur() scales the filtered values so the largest is 255
+   convolveDirect(view, gaussian.weights().data(), gaussian.size(), direct.data());
+   float peak = *std::max_element(direct.begin(), direct.end());
+   Image expected(view.width(), view.height());
+   unsigned char* samples = expected.data();
+   for (size_t i = 0; i < direct.size(); i++) {
+      samples[i] = (unsigned char) (255 * (direct[i] / peak));
+   }
+   DiffStats blur = compare(image.gaussianBlur(2).view(), expected.view());
+   check("gaussianBlur matches direct convolution", blur.maxAbsError <= 1);
+}
+
+// Graph outputs match their Image methods bit for bit at any tile size,
+// with shifts read as a tile halo, shifts far larger than a tile (run as
+// barriers) and the other barriers
+void testGraphTiles(const Image& image)
+{
+   int r[2] = {-150, 40}, g[2] = {0, -90}, b[2] = {210, 7};
+   int rs[2] = {-5, 3}, gs[2] = {0, -7}, bs[2] = {12, 2};
+   std::vector<Image> expected = {
+      image.rotate90(),
+      image.channelShift(r, g, b),
+      image.channelShift(r, g, b).rotate90().channelShift(b, r, g).rotate90(),
+      image.channelShift(rs, gs, bs),
+      image.channelShift(rs, gs, bs).rotate90().channelShift(bs, rs, gs).rotate90(),
+      image.sobel(),
+      image.gaussianBlur(3),
+      image.invert().sobel().rotate90()};
+   bool matches = true;
+   for (int tileSize : {8, 13, 64, 200}) {
+      Graph graph;
+      Graph::Node in = graph.source(image);
+      std::vector<Graph::Node> outputs = {
+         graph.rotate90(in),
+         graph.channelShift(in, r, g, b),
+         graph.rotate90(graph.channelShift(graph.rotate90(graph.channelShift(in, r, g, b)), b, r, g)),
+         graph.channelShift(in, rs, gs, bs),
+         graph.rotate90(graph.channelShift(graph.rotate90(graph.channelShift(in, rs, gs, bs)),
+                                           bs, rs, gs)),
+         graph.sobel(in),
+         graph.gaussianBlur(in, 3),
+         graph.rotate90(graph.sobel(graph.invert(in)))};
+      std::vector<Image> rendered = graph.render(outputs, tileSize);
+      for (size_t i = 0; i < expected.size(); i++) {
+         matches = matches && identical(rendered[i].view(), expected[i].view());
+      }
+   }
+   check("graph matches Image methods at every tile size", matches);
+}
+
+// Exhaustive checks of fixed_point.h that are too long for static_assert
+void testFixedPoint()
+{
+   int wrong = 0;
+   for (int a = 0; a < 256; a++) {
+      for (int b = 0; b < 256; b++) {
+         if (fixed::mulDiv255(a, b) != mulDivRef(a, b)) wrong++;
+      }
+      for (int w = 0; w <= 256; w++) {
+         int exact = (int) std::floor(a + (255 - 2 * a) * w / 256.0 + 0.5);
+         if (fixed::lerpQ8(a, 255 - a, w) != exact) wrong++;
+      }
+   }
+   check("fixed point exact over the whole range", wrong == 0);
+}
+
+// Every operator, with and without alpha planes and a mask, at clipped offsets
+void testComposite()
+{
+   srand(28);
+   Image src = randomImage(37, 23), srcAlpha = randomImage(37, 23), mask = randomImage(37, 23);
+   Image dst = randomImage(50, 40), dstAlpha = randomImage(50, 40);
+   const CompositeOp ops[] = {CompositeOp::Source, CompositeOp::Over, CompositeOp::In,
+                              CompositeOp::Out, CompositeOp::Atop, CompositeOp::Xor};
+   const int offsets[][2] = {{5, 4}, {-7, -5}, {30, 31}, {-20, 25}, {-100, 0}, {50, 0}};
+   int mismatches = 0;
+   for (CompositeOp op : ops) {
+      for (int planes = 0; planes < 16; planes++) {
+         bool hasSrcAlpha = planes & 1, hasDstAlpha = planes & 2, hasMask = planes & 4;
+         for (const int* offset : offsets) {
+            Image out = dst, outAlpha = dstAlpha, expected = dst, expectedAlpha = dstAlpha;
+            CompositeOptions options;
+            options.op = op;
+            options.opacity = planes & 8 ? 200 : 255;
+            if (hasSrcAlpha) options.srcAlpha = srcAlpha.view().channel(0);
+            if (hasDstAlpha) options.dstAlpha = outAlpha.view().channel(0);
+            if (hasMask) options.mask = mask.view().channel(0);
+            out.composite(src, offset[0], offset[1], options);
+            compositeReference(src, expected, offset[0], offset[1], op,
+                               hasSrcAlpha ? &srcAlpha : NULL, hasDstAlpha ? &expectedAlpha : NULL,
+                               hasMask ? &mask : NULL, options.opacity);
+            if (!identical(out.view(), expected.view()) ||
+                !identical(outAlpha.view(), expectedAlpha.view())) {
+               mismatches++;
+            }
+         }
+      }
+   }
+   check("composite matches reference", mismatches == 0);
+}
+
+// Writes through views and data() must reach resize(), which samples the
+// cached pyramid, even after the pyramid was built or copied with the image
+void testResizeAfterEdits(const Image& image)
+{
+   int w = image.width() / 2, h = image.height() / 2;
+   Image original = image;
+   Image before = original.resize(w, h);  // builds the original's pyramid
+
+   Image edited = original;
+   const Image& current = edited;
+   ImageView corner = edited.subimage(0, 0, w, h);
+   invert(corner, corner);
+   Image resized = edited.resize(w, h);
+   check("resize sees subimage edits of a copy",
+         identical(resized.view(), Image(current.view()).resize(w, h).view()) &&
+         !identical(resized.view(), before.view()));
+
+   ImageView all = edited.view();
+   invert(all, all);
+   check("resize sees view edits",
+         identical(edited.resize(w, h).view(), Image(current.view()).resize(w, h).view()));
+
+   unsigned char* samples = edited.data();
+   for (int i = 0; i < w * h * 3; i++) samples[i] = 255 - samples[i];
+   check("resize sees data() edits",
+         identical(edited.resize(w, h).view(), Image(current.view()).resize(w, h).view()));
+}
+
+// Median of every channel over a (2r+1) square window, edges repeating the
+// nearest edge pixel
+Image medianReference(const Image& image, int radius)
+{
+   Image result(image.width(), image.height());
+   std::vector<int> window;
+   for (int row = 0; row < image.height(); row++) {
+      for (int col = 0; col < image.width(); col++) {
+         unsigned char out[3];
+         for (int c = 0; c < 3; c++) {
+            window.clear();
+            for (int y = row - radius; y <= row + radius; y++) {
+               for (int x = col - radius; x <= col + radius; x++) {
+                  int cy = std::min(std::max(y, 0), image.height() - 1);
+                  int cx = std::min(std::max(x, 0), image.width() - 1);
+                  window.push_back(image.data()[(cy * image.width() + cx) * 3 + c]);
+               }
+            }
+            std::nth_element(window.begin(), window.begin() + window.size() / 2, window.end());
+            out[c] = (unsigned char) window[window.size() / 2];
+         }
+         result.set(row, col, Pixel(out[0], out[1], out[2]));
+      }
+   }
+   return result;
+}
+
+// Sorting network and histogram radii, on images smaller than the window too
+void testMedian()
+{
+   srand(30);
+   const int sizes[][2] = {{37, 23}, {5, 4}, {1, 9}};
+   bool matches = true;
+   for (const int* size : sizes) {
+      const Image image = randomImage(size[0], size[1]);
+      for (int radius : {0, 1, 2, 3, 6}) {
+         matches = matches && identical(image.median(radius).view(),
+                                        medianReference(image, radius).view());
+      }
+   }
+   check("median matches reference", matches);
+}
+
+// Bilateral filter in doubles over a window of radius ceil(2 sigma), which
+// leaves out the pixels beyond the edges
+Image bilateralReference(const Image& image, float sigmaSpatial, float sigmaRange)
+{
+   int radius = std::max(1, (int) std::ceil(2 * sigmaSpatial));
+   auto luma = [](const Pixel& p) { return (77 * p.r + 150 * p.g + 29 * p.b + 128) >> 8; };
+   Image result(image.width(), image.height());
+   for (int row = 0; row < image.height(); row++) {
+      for (int col = 0; col < image.width(); col++) {
+         int l0 = luma(image.get(row, col));
+         double sum[3] = {0, 0, 0}, total = 0;
+         for (int y = std::max(0, row - radius); y <= std::min(image.height() - 1, row + radius); y++) {
+            for (int x = std::max(0, col - radius); x <= std::min(image.width() - 1, col + radius); x++) {
+               Pixel p = image.get(y, x);
+               int dl = luma(p) - l0;
+               double weight = std::exp(-((x - col) * (x - col) + (y - row) * (y - row)) /
+                                        (2.0 * sigmaSpatial * sigmaSpatial)) *
+                               std::exp(-dl * dl / (2.0 * sigmaRange * sigmaRange));
+               sum[0] += weight * p.r;
+               sum[1] += weight * p.g;
+               sum[2] += weight * p.b;
+               total += weight;
+            }
+         }
+         result.set(row, col, Pixel((unsigned char) (sum[0] / total + 0.5),
+                                    (unsigned char) (sum[1] / total + 0.5),
+                                    (unsigned char) (sum[2] / total + 0.5)));
+      }
+   }
+   return result;
+}
+
+// The direct path against the reference, and the grid path keeping a
+// vertical edge sharp and a flat image flat
+void testBilateral()
+{
+   srand(31);
+   bool direct = true;
+   for (float sigma : {0.5f, 1.0f, 1.5f}) {
+      for (const Image& image : {randomImage(29, 17), randomImage(3, 2)}) {
+         DiffStats diff = compare(image.bilateral(sigma, 30).view(),
+                                  bilateralReference(image, sigma, 30).view());
+         direct = direct && diff.maxAbsError <= 1;
+      }
+   }
+   check("bilateral matches reference", direct);
+
+   Image step(64, 40), flat(45, 31);
+   for (int row = 0; row < step.height(); row++) {
+      for (int col = 0; col < step.width(); col++) {
+         step.set(row, col, col < 32 ? Pixel(40, 50, 60) : Pixel(200, 190, 180));
+      }
+   }
+   flat.fill(Pixel(90, 120, 30));
+   bool grid = compare(step.bilateral(4, 20).view(), step.view()).maxAbsError <= 2 &&
+               compare(flat.bilateral(3, 20).view(), flat.view()).maxAbsError <= 1;
+   check("bilateral grid keeps edges and flat areas", grid);
+}
+
+// Minimum (or maximum) of every channel over the part of a (2rx+1) x (2ry+1)
+// rectangle inside the image
+Image morphologyReference(const Image& image, bool dilate, int rx, int ry)
+{
+   Image result(image.width(), image.height());
+   for (int row = 0; row < image.height(); row++) {
+      for (int col = 0; col < image.width(); col++) {
+         Pixel best = image.get(row, col);
+         for (int y = std::max(0, row - ry); y <= std::min(image.height() - 1, row + ry); y++) {
+            for (int x = std::max(0, col - rx); x <= std::min(image.width() - 1, col + rx); x++) {
+               Pixel p = image.get(y, x);
+               auto pick = [dilate](unsigned char a, unsigned char b) {
+                  return dilate ? std::max(a, b) : std::min(a, b);
+               };
+               best = Pixel(pick(best.r, p.r), pick(best.g, p.g), pick(best.b, p.b));
+            }
+         }
+         result.set(row, col, best);
+      }
+   }
+   return result;
+}
+
+// Gray morphology against the reference, and BitMask against the same
+// reference on a thresholded image, at widths around the 64 bit words
+void testMorphology()
+{
+   srand(32);
+   const int radii[][2] = {{0, 0}, {1, 1}, {2, 0}, {0, 3}, {3, 2}, {9, 7}};
+   bool gray = true, binary = true;
+   for (int width : {5, 63, 64, 65, 130}) {
+      const Image image = randomImage(width, 19);
+      const Image bits = image.grayscale();
+      for (const int* r : radii) {
+         Image eroded = morphologyReference(image, false, r[0], r[1]);
+         Image dilated = morphologyReference(image, true, r[0], r[1]);
+         gray = gray && identical(image.erode(r[0], r[1]).view(), eroded.view()) &&
+                identical(image.dilate(r[0], r[1]).view(), dilated.view()) &&
+                identical(image.open(r[0], r[1]).view(),
+                          morphologyReference(eroded, true, r[0], r[1]).view()) &&
+                identical(image.close(r[0], r[1]).view(),
+                          morphologyReference(dilated, false, r[0], r[1]).view());
+
+         const Morphology ops[] = {Morphology::Erode, Morphology::Dilate, Morphology::Open,
+                                   Morphology::Close};
+         for (Morphology op : ops) {
+            BitMask mask = BitMask::threshold(bits.view(), 128);
+            mask.apply(op, r[0], r[1]);
+            Image expected = BitMask::threshold(bits.view(), 128).toImage();
+            if (op == Morphology::Close) expected = morphologyReference(expected, true, r[0], r[1]);
+            expected = morphologyReference(expected, op == Morphology::Dilate, r[0], r[1]);
+            if (op == Morphology::Open) expected = morphologyReference(expected, true, r[0], r[1]);
+            long set = 0;
+            for (int i = 0; i < expected.width() * expected.height(); i++) {
+               set += expected.get(i).r != 0;
+            }
+            binary = binary && identical(mask.toImage().view(), expected.view()) &&
+                     mask.count() == set;
+         }
+      }
+   }
+   check("morphology matches reference", gray);
+   check("bit mask morphology matches reference", binary);
+}
+
+// Floyd-Steinberg in one serial scan with the integer arithmetic of
+// noise.cpp: errors in 1/16 units, pushed 7/16 right and 3, 5, 1/16 below
+Image floydSteinbergReference(const Image& image, int levels)
+{
+   int w = image.width(), h = image.height();
+   std::vector<int> acc((size_t) w * h * 3, 0);
+   Image result(w, h);
+   for (int row = 0; row < h; row++) {
+      for (int col = 0; col < w; col++) {
+         for (int c = 0; c < 3; c++) {
+            int i = (row * w + col) * 3 + c;
+            int value = std::min(255 * 16, std::max(0, 16 * image.data()[i] + acc[i] / 16));
+            int index = (value * (levels - 1) + 255 * 8) / (255 * 16);
+            int quantized = (2 * index * 255 + levels - 1) / (2 * (levels - 1));
+            result.data()[i] = (unsigned char) quantized;
+            int error = value - 16 * quantized;
+            if (col + 1 < w) acc[i + 3] += 7 * error;
+            if (row + 1 < h) {
+               if (col > 0) acc[i + w * 3 - 3] += 3 * error;
+               acc[i + w * 3] += 5 * error;
+               if (col + 1 < w) acc[i + w * 3 + 3] += error;
+            }
+         }
+      }
+   }
+   return result;
+}
+
+// The wavefront of 64 column blocks and 8 row bands against the serial
+// scan, on images of several blocks and bands and on single rows and columns
+void testFloydSteinberg()
+{
+   srand(44);
+   const int sizes[][2] = {{200, 37}, {130, 17}, {64, 8}, {65, 9}, {1, 20}, {300, 1}};
+   bool matches = true;
+   for (const int* size : sizes) {
+      const Image image = randomImage(size[0], size[1]);
+      for (int levels : {2, 3, 8}) {
+         matches = matches && identical(image.floydSteinberg(levels).view(),
+                                        floydSteinbergReference(image, levels).view());
+      }
+   }
+   check("floydSteinberg matches a serial scan", matches);
+}
+
+// Neighbours of a pixel as row and column offsets: the first four are the
+// edge neighbours, the rest the corners
+const int kNeighbours[8][2] = {{-1, 0}, {0, -1}, {0, 1}, {1, 0},
+                               {-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
+
+// Breadth first labeling, one pixel at a time, numbering the components in
+// the order a row by row scan first reaches them
+std::vector<int> componentsReference(const BitMask& mask, Connectivity connectivity,
+                                     std::vector<Component>& components)
+{
+   int w = mask.width(), h = mask.height();
+   int neighbours = connectivity == Connectivity::Eight ? 8 : 4;
+   std::vector<int> labels((size_t) w * h, 0);
+   components.clear();
+   std::vector<int> queue;
+   for (int start = 0; start < w * h; start++) {
+      if (labels[start] || !mask.get(start / w, start % w)) continue;
+      components.push_back(Component());
+      Component& c = components.back();
+      int label = (int) components.size();
+      int minX = w, minY = h, maxX = -1, maxY = -1;
+      labels[start] = label;
+      queue.assign(1, start);
+      for (size_t i = 0; i < queue.size(); i++) {
+         int row = queue[i] / w, col = queue[i] % w;
+         c.area++;
+         c.centroidX += col;
+         c.centroidY += row;
+         minX = std::min(minX, col);
+         maxX = std::max(maxX, col);
+         minY = std::min(minY, row);
+         maxY = std::max(maxY, row);
+         for (int n = 0; n < neighbours; n++) {
+            int y = row + kNeighbours[n][0], x = col + kNeighbours[n][1];
+            if (y < 0 || y >= h || x < 0 || x >= w) continue;
+            if (labels[y * w + x] || !mask.get(y, x)) continue;
+            labels[y * w + x] = label;
+            queue.push_back(y * w + x);
+         }
+      }
+      c.centroidX /= c.area;
+      c.centroidY /= c.area;
+      c.bounds = {minX, minY, maxX - minX + 1, maxY - minY + 1};
+   }
+   return labels;
+}
+
+// Random mask with the given fraction of its pixels set (from rand())
+BitMask randomMask(int width, int height, int percent)
+{
+   BitMask mask(width, height);
+   for (int row = 0; row < height; row++) {
+      for (int col = 0; col < width; col++) mask.set(row, col, rand() % 100 < percent);
+   }
+   return mask;
+}
+
+// Labels and statistics against the reference, on masks spanning several
+// bands and on widths that leave padding bits in the last word of a row,
+// including masks from BitMask::apply(), which inverts whole words
+void testComponents()
+{
+   srand(49);
+   bool counts = true, labels = true, stats = true;
+   for (int width : {1, 5, 63, 64, 65, 130, 200}) {
+      for (int height : {1, 40, 100}) {
+         std::vector<BitMask> masks;
+         for (int percent : {30, 55, 80}) masks.push_back(randomMask(width, height, percent));
+         BitMask eroded = masks[1], closed = masks[0];
+         eroded.apply(Morphology::Erode, 1, 0);
+         closed.apply(Morphology::Close, 2, 1);
+         masks.push_back(eroded);
+         masks.push_back(closed);
+         masks.push_back(randomMask(width, height, 100));
+         for (const BitMask& mask : masks) {
+            for (Connectivity connectivity : {Connectivity::Four, Connectivity::Eight}) {
+               Components found(mask, connectivity);
+               std::vector<Component> expected;
+               std::vector<int> reference = componentsReference(mask, connectivity, expected);
+               counts = counts && found.count() == (int) expected.size();
+               for (int row = 0; row < height && labels; row++) {
+                  for (int col = 0; col < width; col++) {
+                     labels = labels && found.label(row, col) == reference[row * width + col];
+                  }
+               }
+               for (int i = 0; i < std::min(found.count(), (int) expected.size()); i++) {
+                  const Component& a = found.components()[i];
+                  const Component& b = expected[i];
+                  stats = stats && a.area == b.area && a.bounds.x == b.bounds.x &&
+                          a.bounds.y == b.bounds.y && a.bounds.width == b.bounds.width &&
+                          a.bounds.height == b.bounds.height &&
+                          std::fabs(a.centroidX - b.centroidX) < 1e-6 &&
+                          std::fabs(a.centroidY - b.centroidY) < 1e-6;
+               }
+            }
+         }
+      }
+   }
+   check("component count matches reference", counts);
+   check("component labels match reference", labels);
+   check("component statistics match reference", stats);
+}
+
+// Breadth first flood from a seed over the pixels within tolerance of the
+// seed color, as colorReplace() measures it
+BitMask floodReference(const Image& image, int row, int col, int tolerance,
+                       Connectivity connectivity)
+{
+   int w = image.width(), h = image.height();
+   int neighbours = connectivity == Connectivity::Eight ? 8 : 4;
+   BitMask mask(w, h);
+   Pixel seed = image.get(row, col);
+   auto near = [&](int y, int x) {
+      Pixel p = image.get(y, x);
+      int dr = p.r - seed.r, dg = p.g - seed.g, db = p.b - seed.b;
+      return (int) std::sqrt((double) (dr * dr + dg * dg + db * db)) <= tolerance;
+   };
+   std::vector<std::pair<int, int>> queue(1, std::make_pair(row, col));
+   mask.set(row, col, true);
+   for (size_t i = 0; i < queue.size(); i++) {
+      for (int n = 0; n < neighbours; n++) {
+         int y = queue[i].first + kNeighbours[n][0], x = queue[i].second + kNeighbours[n][1];
+         if (y < 0 || y >= h || x < 0 || x >= w || mask.get(y, x) || !near(y, x)) continue;
+         mask.set(y, x, true);
+         queue.push_back(std::make_pair(y, x));
+      }
+   }
+   return mask;
+}
+
+// Scanline flood fill against the reference, on patchy images where the
+// regions wind around each other, from seeds across the image
+void testFloodFill()
+{
+   srand(490);
+   const Pixel palette[3] = {Pixel(20, 30, 40), Pixel(200, 180, 40), Pixel(25, 35, 50)};
+   const int sizes[][2] = {{70, 45}, {130, 9}, {1, 30}, {64, 1}};
+   bool masks = true, fills = true;
+   for (const int* size : sizes) {
+      Image image(size[0], size[1]);
+      for (int i = 0; i < size[0] * size[1]; i++) image.set(i, palette[rand() % 3]);
+      for (int seed = 0; seed < 6; seed++) {
+         int row = rand() % size[1], col = rand() % size[0];
+         for (int tolerance : {0, 20}) {
+            for (Connectivity connectivity : {Connectivity::Four, Connectivity::Eight}) {
+               BitMask expected = floodReference(image, row, col, tolerance, connectivity);
+               BitMask found = floodMask(image.view(), row, col, tolerance, connectivity);
+               masks = masks && identical(found.toImage().view(), expected.toImage().view());
+
+               Image filled(size[0], size[1]), reference(image);
+               long count = floodFill(image.view(), filled.view(), row, col, Pixel(255, 0, 255),
+                                      tolerance, connectivity);
+               for (int y = 0; y < size[1]; y++) {
+                  for (int x = 0; x < size[0]; x++) {
+                     if (expected.get(y, x)) reference.set(y, x, Pixel(255, 0, 255));
+                  }
+               }
+               fills = fills && count == expected.count() &&
+                       identical(filled.view(), reference.view());
+            }
+         }
+      }
+   }
+   check("flood mask matches reference", masks);
+   check("flood fill matches reference", fills);
+}
+
+// Incremental cost updates against costs computed from scratch: after every
+// pass the carver must match a new carver that made the same pass on the
+// previous image, in both orientations, one seam and several per pass. The
+// blocky image has many equal costs, so ties are covered too. A size that
+// grows one side must not scale up the other.
+void testSeamCarver()
+{
+   srand(50);
+   Image blocky(48, 36);
+   const Image blocks = randomImage(12, 9);
+   for (int row = 0; row < blocky.height(); row++) {
+      for (int col = 0; col < blocky.width(); col++) {
+         blocky.set(row, col, blocks.get(row / 4, col / 4));
+      }
+   }
+   bool single = true, batch = true;
+   for (const Image& image : {randomImage(41, 29), blocky}) {
+      for (bool horizontal : {false, true}) {
+         for (int seamsPerPass : {1, 3}) {
+            SeamCarver carver(image.view(), horizontal);
+            Image previous = image;
+            for (int pass = 0; pass < 8; pass++) {
+               carver.remove(seamsPerPass, seamsPerPass);
+               SeamCarver fresh(previous.view(), horizontal);
+               fresh.remove(seamsPerPass, seamsPerPass);
+               previous = carver.image();
+               bool& matches = seamsPerPass == 1 ? single : batch;
+               matches = matches && identical(previous.view(), fresh.image().view());
+            }
+         }
+      }
+   }
+   check("seam carver matches a fresh carver after each seam", single);
+   check("seam carver matches a fresh carver after each batch", batch);
+
+   // growing one side stretches that side alone and carves the other
+   const Image small = randomImage(41, 29);
+   SeamCarver rows(small.resize(60, 29).view(), true);
+   rows.remove(9);
+   check("seam carving grows one side alone",
+         identical(small.seamCarve(60, 20).view(), rows.image().view()));
+   const Image wide = small.seamCarve(4000, 1);
+   check("seam carving to a thin strip", wide.width() == 4000 && wide.height() == 1);
+}
+
+// Set a file's modification time to the given number of seconds after the epoch
+bool setModifiedTime(const char* filename, long seconds)
+{
+   struct utimbuf times;
+   times.actime = seconds;
+   times.modtime = seconds;
+   return utime(filename, &times) == 0;
+}
+
+// Hits and misses, reloading files changed on disk (by modification time
+// alone and by size alone), least recently used eviction under the budget,
+// and concurrent loads of one file decoding it once
+void testImageCache()
+{
+   srand(34);
+   ImageCache cache;
+   const Image a = randomImage(20, 20), b = randomImage(20, 20), c = randomImage(20, 20);
+   a.save("cache-a.png");
+   b.save("cache-b.png");
+   c.save("cache-c.png");
+
+   std::shared_ptr<const Image> first = cache.load("cache-a.png");
+   std::shared_ptr<const Image> again = cache.load("cache-a.png");
+   ImageCache::Stats stats = cache.stats();
+   check("image cache hits the second load",
+         first && first == again && stats.hits == 1 && stats.misses == 1 &&
+         identical(first->view(), a.view()));
+   check("image cache misses a missing file", !cache.load("cache-missing.png"));
+
+   // same bytes, new modification time
+   setModifiedTime("cache-a.png", 1000000000);
+   std::shared_ptr<const Image> touched = cache.load("cache-a.png");
+   a.save("cache-a.png");
+   setModifiedTime("cache-a.png", 1000000000);
+   std::shared_ptr<const Image> rewritten = cache.load("cache-a.png");
+   // new size, same modification time
+   randomImage(30, 10).save("cache-a.png");
+   setModifiedTime("cache-a.png", 1000000000);
+   std::shared_ptr<const Image> resized = cache.load("cache-a.png");
+   stats = cache.stats();
+   check("image cache reloads files changed on disk",
+         touched && touched != first && identical(touched->view(), a.view()) &&
+         rewritten == touched && resized && resized != touched && resized->width() == 30 &&
+         stats.misses == 3 && first->width() == 20);
+
+   // room for two 20 x 20 images: loading a third evicts the least recently used
+   a.save("cache-a.png");
+   cache.clear();
+   size_t entry = sizeof(Image) + 20 * 20 * 3;
+   cache.setBudget(2 * entry);
+   std::shared_ptr<const Image> oldest = cache.load("cache-b.png");
+   cache.load("cache-a.png");
+   cache.load("cache-b.png");
+   cache.load("cache-c.png");
+   long misses = cache.stats().misses;
+   bool kept = cache.load("cache-b.png") && cache.stats().misses == misses;
+   bool evicted = cache.load("cache-a.png") && cache.stats().misses == misses + 1;
+   check("image cache evicts the least recently used entry",
+         kept && evicted && cache.stats().evictions == 2 && cache.bytes() == 2 * entry &&
+         identical(oldest->view(), b.view()));
+   cache.setBudget(0);
+   check("image cache empties when the budget shrinks", cache.bytes() == 0);
+
+   ImageCache shared;
+   const int kThreads = 8;
+   std::vector<std::shared_ptr<const Image>> loaded(kThreads);
+   std::vector<std::thread> threads;
+   for (int i = 0; i < kThreads; i++) {
+      threads.emplace_back([&shared, &loaded, i]() {
+         loaded[i] = shared.load("../images/earth.png");
+      });
+   }
+   for (std::thread& thread : threads) thread.join();
+   bool same = loaded[0] != NULL;
+   for (const std::shared_ptr<const Image>& image : loaded) same = same && image == loaded[0];
+   stats = shared.stats();
+   check("image cache decodes concurrent loads once",
+         same && stats.misses == 1 && stats.hits == kThreads - 1);
+}
+
+#ifdef UNIX
+// Jobs through a server running in this process: results must match the
+// same Image calls, and bad requests must get an ERR reply rather than run.
+// A carve that stretches a tiny input to a thin strip stays small; one
+// whose stretched intermediate is too large is refused.
+void testImageServer(const Image& earth)
+{
+   ImageServer server("pixmap-test.sock");
+   if (!server.start()) {
+      check("image server starts", false);
+      return;
+   }
+   std::thread serving([&server]() { server.serve(); });
+   ImageClient client;
+   bool connected = client.connect("pixmap-test.sock");
+   check("image server accepts a client", connected);
+
+   Image out;
+   bool ran = connected && client.run(earth, "median 2 | resize 200 200", out);
+   check("image server matches Image calls",
+         ran && identical(out.view(), earth.median(2).resize(200, 200).view()));
+   srand(48);
+   const Image small = randomImage(41, 29);
+   ran = connected && client.run(small, "carve 60 20", out);
+   check("image server carves like seamCarve",
+         ran && identical(out.view(), small.seamCarve(60, 20).view()));
+   ran = connected && client.run(randomImage(8, 6), "carve 40000 1", out);
+   check("image server carves a tiny input to a strip",
+         ran && out.width() == 40000 && out.height() == 1);
+
+   auto refused = [&client](const std::string& ops, const std::string& reply) {
+      return client.request("../images/earth.png server-out.png " + ops).compare(
+                0, reply.size(), reply) == 0;
+   };
+   check("image server refuses an unknown op", refused("sharpen 2", "ERR unknown op sharpen"));
+   check("image server refuses an argument out of range",
+         refused("median -1", "ERR argument 1 of median must be in"));
+   check("image server refuses an oversized resize",
+         refused("rotate90 | resize 65535 65535", "ERR bad size for resize"));
+   check("image server refuses an oversized carve",
+         refused("carve 65535 5000", "ERR bad size for carve"));
+   check("image server still runs jobs after errors",
+         connected && client.run(small, "invert", out) &&
+         identical(out.view(), small.invert().view()));
+
+   server.stop();
+   serving.join();
+}
+#endif
+
+}  // namespace
+
 int main(int argc, char** argv)
 {
+   trace::setEnabled(true);
+
    Image image;
    if (!image.load("../images/feep.png")) {
       std::cout << "ERROR: Cannot load image! Exiting...\n";
@@ -28,6 +938,9 @@ int main(int argc, char** argv)
       std::cout << std::endl;
    }
    image.save("feep-test-save.png"); // should match original
+   Image saved;
+   saved.load("feep-test-save.png");
+   check("saved feep matches", identical(saved.view(), image.view()));
    
    // should print 4 4
    cout << "loaded feep: " << image.width() << " " << image.height() << endl;
@@ -35,10 +948,12 @@ int main(int argc, char** argv)
    // test: copy constructor
    Image copy = image; 
    copy.save("feep-test-copy.png"); // should match original and load into gimp
+   check("copy matches", identical(copy.view(), image.view()));
 
    // test: assignment operator
    copy = image; 
    copy.save("feep-test-assignment.png"); // should match original and load into gimp
+   check("assignment matches", identical(copy.view(), image.view()));
 
    // should print r,g,b
    Pixel pixel = image.get(0, 3);
@@ -62,6 +977,26 @@ int main(int argc, char** argv)
    Image resize = image.resize(200,300);
    resize.save("earth-200-300.png");
 
+   // content-aware resize: seams through the black background go first
+   image.seamCarve(300, 400).save("earth-carved-300-400.png");
+   image.seamCarve(300, 300, 8).save("earth-carved-300-300.png");
+   testSeamCarver();
+
+   // thumbnails: every size after the first reuses the cached pyramid
+   image.resize(100, 100).save("earth-100-100.png");
+   image.resize(64, 48).save("earth-64-48.png");
+   cout << "pyramid levels: " << image.pyramid()->levels() << endl;
+
+   // JPEG thumbnail decoded at 1/8 size, then resampled the rest of the way
+   Image thumb;
+   thumb.load("../images/haverford.jpg", 200, 92);
+   thumb.save("haverford-thumb.png");
+
+   // laplacian pyramid: collapsing the bands reproduces the image
+   LaplacianPyramid bands(image);
+   Image collapsed = bands.collapse();
+   check("laplacian round trip exact", identical(collapsed.view(), image.view()));
+
    // grayscale
    Image grayscale = image.grayscale(); 
    grayscale.save("earth-grayscale.png");
@@ -74,6 +1009,17 @@ int main(int argc, char** argv)
    Image sub = image.subimage(200, 200, 100, 100); 
    sub.save("earth-subimage.png"); 
 
+   // views: invert a region of a copy in place, without copying it out
+   Image invertedRegion = image;
+   ImageView region = invertedRegion.subimage(100, 100, 200, 200);
+   invert(region, region);
+   invertedRegion.save("earth-invert-region.png");
+   testResizeAfterEdits(image);
+
+   // compositing: every Porter-Duff operator against a scalar reference
+   testFixedPoint();
+   testComposite();
+
    // gamma correction
    Image gamma = image.gammaCorrect(2.2f); 
    gamma.save("earth-gamma-2.2.png"); 
@@ -81,6 +1027,13 @@ int main(int argc, char** argv)
    gamma = image.gammaCorrect(0.6f);
    gamma.save("earth-gamma-0.6.png");
 
+   // histogram based tone adjustments
+   Histogram hist = image.histogram();
+   cout << "earth luma range: " << hist.min(Histogram::Luma) << " " << hist.max(Histogram::Luma) << endl;
+   image.autoLevels().save("earth-autolevels.png");
+   image.equalize().save("earth-equalize.png");
+   image.clahe(8, 2.0f).save("earth-clahe.png");
+
    // alpha blend
    Image earth;
    earth.load("../images/earth.png");
@@ -91,11 +1044,211 @@ int main(int argc, char** argv)
    Image blurredSobel = sobeled.gaussianBlur(6);
    blurredSobel.save("blurredSobel.png");
 
+   // bokeh: a 31x31 disc is large enough for convolve to take the FFT path
+   const int disc = 31;
+   float discKernel[disc * disc];
+   float discSum = 0;
+   for (int i = 0; i < disc * disc; i++) {
+      int dy = i / disc - disc / 2, dx = i % disc - disc / 2;
+      discKernel[i] = dx * dx + dy * dy <= (disc / 2) * (disc / 2) ? 1 : 0;
+      discSum += discKernel[i];
+   }
+   for (int i = 0; i < disc * disc; i++) discKernel[i] /= discSum;
+   float* bokehOut = new float[earth.width() * earth.height() * 3];
+   earth.convolve(discKernel, disc, bokehOut);
+   Image bokeh(earth.width(), earth.height());
+   for (int i = 0; i < earth.width() * earth.height() * 3; i++) {
+      bokeh.data()[i] = (unsigned char) std::min(255.0f, bokehOut[i] + 0.5f);
+   }
+   delete[] bokehOut;
+   bokeh.save("earth-bokeh.png");
+   testConvolveFFT();
+   testKernels(earth);
+
+   // median: small and large windows
+   earth.median(1).save("earth-median-1.png");
+   earth.median(8).save("earth-median-8.png");
+   testMedian();
+
+   // pipeline: decode, filter and encode overlap on separate threads
+   Pipeline pipeline([](const Image& in) { return in.median(1); });
+   std::future<bool> pipelined[2] = {
+      pipeline.submit("../images/earth.png", "earth-pipeline.png"),
+      pipeline.submit("../images/feep.png", "feep-pipeline.png")};
+   pipeline.finish();
+   bool pipelineSaved = pipelined[0].get();
+   pipelineSaved = pipelined[1].get() && pipelineSaved;
+   check("pipeline saved", pipelineSaved);
+   testImageCache();
+#ifdef UNIX
+   testImageServer(earth);
+#endif
+
+   // bilateral: grid and direct paths
+   earth.bilateral(8, 20).save("earth-bilateral-8.png");
+   earth.bilateral(1, 20).save("earth-bilateral-1.png");
+   testBilateral();
+
+   // morphology: large radius cleanup of the sobel edges, gray and binary
+   sobeled.close(6, 6).open(3, 3).save("sobeled-close-open.png");
+   BitMask edges = BitMask::threshold(sobeled.view(), 64);
+   edges.apply(Morphology::Close, 6, 6);
+   edges.apply(Morphology::Open, 3, 3);
+   edges.toImage().save("sobeled-mask.png");
+   testMorphology();
+
+   // connected components of the bright clouds, and a fill of the black space around the earth
+   Components blobs(BitMask::threshold(earth.grayscale().view(), 200));
+   int biggest = blobs.largest();
+   cout << "cloud blobs: " << blobs.count();
+   if (biggest) cout << ", largest " << blobs.component(biggest).area << " pixels";
+   cout << endl;
+   blobs.toImage().save("earth-clouds.png");
+   earth.floodFill(0, 0, Pixel(0, 0, 64), 24).save("earth-flood-fill.png");
+   testComponents();
+   testFloodFill();
+
    int rShift[2] = {-1,-1};
    int gShift[2] = {0,0};
    int bShift[2] = {1,1};
 
    Image halftoned = blurredSobel.grayscale().halftone(rShift, gShift, bShift);
    halftoned.save("halftoned.png");
-}
 
+   // halftone: AM screen rendered at the source resolution
+   HalftoneOptions screen;
+   screen.cellSize = 6;
+   Image screened = earth.halftone(screen);
+   screened.save("earth-halftone-am.png");
+
+   // seeded noise and dithering: the same seed reproduces the same pixels
+   Image grain = earth.filmGrain(12, 42);
+   Image grainAgain = earth.filmGrain(12, 42);
+   check("grain reproducible", identical(grain.view(), grainAgain.view()));
+   grain.save("earth-grain.png");
+   earth.pixelJitter(24, 7).save("earth-pixel-jitter.png");
+   earth.orderedDither(2).save("earth-bayer-2.png");
+   earth.floydSteinberg(2).save("earth-floyd-steinberg-2.png");
+   testFloydSteinberg();
+
+   // custom per-pixel filters: transform() and row spans inline the loop body
+   Image swapped = earth.transform([](const unsigned char* in, unsigned char* out) {
+      out[0] = in[2];
+      out[1] = in[1];
+      out[2] = in[0];
+   });
+   swapped.clearDirty();
+   const Image& swappedPixels = swapped;
+   long redSum = 0;
+   for (int row = 0; row < swapped.height(); row++) {
+      ConstPixelSpan pixels = swappedPixels.row(row);
+      for (int col = 0; col < pixels.width(); col++) redSum += pixels[col][0];
+   }
+   cout << "mean red after swap: " << redSum / (swapped.width() * swapped.height()) << endl;
+   swapped.save("earth-swapped.png");
+   swapped.row(7).set(3, Pixel(0, 0, 0));
+   Rect spanDirty = swapped.dirtyRect();
+   check("row spans mark only the rows written", spanDirty.x == 0 && spanDirty.y == 7 &&
+         spanDirty.width == swapped.width() && spanDirty.height == 1);
+
+   // regions: retouch one area, leaving the rest of the image untouched
+   Rect logo = {120, 140, 96, 64};
+   Image retouched = earth.within(logo, [](const Image& in) { return in.median(4); }, 4);
+   Image medianAll = earth.median(4);
+   check("region median matches",
+         identical(retouched.view().subview(logo.x, logo.y, logo.width, logo.height),
+                   medianAll.view().subview(logo.x, logo.y, logo.width, logo.height)));
+   check("region outside unchanged",
+         identical(retouched.view().subview(0, 0, 400, logo.y), earth.view().subview(0, 0, 400, logo.y)));
+   retouched.save("earth-region-median.png");
+
+   // redaction inside a soft edged circular mask, in place
+   Image circle(earth.width(), earth.height());
+   for (int row = 0; row < circle.height(); row++) {
+      for (int col = 0; col < circle.width(); col++) {
+         float d = std::sqrt((float) (row - 200) * (row - 200) + (col - 260) * (col - 260));
+         int weight = (int) std::max(0.0f, std::min(255.0f, (60 - d) * 32));
+         circle.set(row, col, Pixel(weight, weight, weight));
+      }
+   }
+   Image redacted = earth;
+   redacted.apply(Region::fromMask(circle.view().channel(0)),
+                  [](const ConstImageView&, const ImageView& dst) { fill(dst, Pixel(0, 0, 0)); });
+   redacted.save("earth-region-redacted.png");
+
+   testGraphTiles(earth);
+
+   // incremental graph: after a small edit only the tiles it reaches are redone
+   Image canvas = earth;
+   Graph graph;
+   Graph::Node canvasNode = graph.source(canvas);
+   Graph::Node softened = graph.invert(graph.convolve(canvasNode, Kernel::gaussian(3)));
+   graph.setIncremental(true);
+   graph.render(softened);
+   canvas.clearDirty();
+   const Image& reading = canvas;
+   compare(reading.view(), earth.view());
+   Image patch(16, 16);
+   patch.fill(Pixel(0, 0, 0));
+   canvas.replace(patch, 40, 40);
+   for (int col = 40; col < 56; col++) canvas.set(60, col, Pixel(255, 255, 255));
+   Rect dirty = canvas.dirtyRect();
+   check("reads leave an image clean, writes mark what they touch",
+         dirty.x == 40 && dirty.y == 40 && dirty.width == 16 && dirty.height == 21);
+   graph.update(canvasNode, canvas);
+   Image edited = graph.render(softened);
+   Graph fresh;
+   Image full = fresh.render(fresh.invert(fresh.convolve(fresh.source(canvas),
+                                                        Kernel::gaussian(3))));
+   check("incremental render matches a full render", identical(edited.view(), full.view()));
+   // the edit, grown by the kernel radius of 9, covers columns and rows 31
+   // to 64, which touch 2 x 2 of the 64 pixel tiles
+   check("incremental render redoes only the tiles the edit reaches", graph.renderedTiles() == 4);
+   edited.save("earth-incremental.png");
+
+   // frame sequence: a square moving over a static background; only the
+   // tiles it touches are recomputed after the first frame
+   for (int frame = 0; frame < 6; frame++) {
+      Image still = earth;
+      Image square(24, 24);
+      square.fill(Pixel(255, 200, 0));
+      still.replace(square, 100 + 12 * frame, 150);
+      char name[32];
+      snprintf(name, sizeof(name), "frame%02d.png", frame);
+      still.save(name);
+   }
+   FrameSequence sequence([](Graph& g, Graph::Node frame) {
+      return g.grayscale(g.convolve(frame, Kernel::gaussian(2)));
+   });
+   int frames = sequence.run("frame%02d.png", "frame%02d-soft.png", 0);
+   cout << "sequence frames: " << frames << ", changed tiles in the last: "
+        << sequence.changedTiles() << " of " << sequence.tiles() << endl;
+   Image lastFrame, lastSoft;
+   lastFrame.load("frame05.png");
+   lastSoft.load("frame05-soft.png");
+   Graph whole;
+   Image filtered = whole.render(whole.grayscale(whole.convolve(whole.source(lastFrame),
+                                                                 Kernel::gaussian(2))));
+   check("sequence output matches the last frame filtered in full",
+         identical(lastSoft.view(), filtered.view()));
+
+   // metrics: quality of lossy operations and near-duplicate detection
+   Image blurred2 = earth.gaussianBlur(2);
+   DiffStats diff = compare(earth.view(), blurred2.view());
+   cout << "blur: max error " << diff.maxAbsError << ", PSNR " << psnr(earth.view(), blurred2.view())
+        << " dB, SSIM " << ssim(earth.view(), blurred2.view()) << endl;
+   uint64_t earthHash = perceptualHash(earth.view());
+   Image thumbnail = earth.resize(123, 123);
+   int resizedDistance = hammingDistance(earthHash, perceptualHash(thumbnail.view()));
+   int invertedDistance = hammingDistance(earthHash, perceptualHash(earth.invert().view()));
+   cout << "phash distance: resized " << resizedDistance << ", inverted " << invertedDistance << endl;
+   check("identical images have SSIM 1", ssim(earth.view(), earth.view()) > 0.9999);
+   check("blur keeps SSIM high", ssim(earth.view(), blurred2.view()) > 0.5);
+   check("resized image is a near duplicate", resizedDistance <= 8);
+   check("inverted image is not a near duplicate", invertedDistance >= 16);
+
+   // tracing: open trace.json in chrome://tracing or Perfetto
+   trace::writeChromeTrace("trace.json");
+   trace::printSummary();
+   return failures ? 1 : 0;
+}
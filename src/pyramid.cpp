@@ -0,0 +1,218 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the definitions for Gaussian and Laplacian image
+* pyramids.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#include "pyramid.h"
+
+#include <algorithm>
+#include <atomic>
+#include "parallel.h"
+
+namespace agl {
+
+namespace {
+
+inline int clampi(int v, int lo, int hi) { return v < lo ? lo : (v > hi ? hi : v); }
+
+inline unsigned char clampByte(int v) { return (unsigned char) clampi(v, 0, 255); }
+
+}  // namespace
+
+/**
+ * @brief Halve a view with a fused blur and decimation
+ * @param src Source RGB view
+ * @return Half size image
+ */
+Image reduce(const ConstImageView& src) {
+  const int w = src.width(), h = src.height();
+  const int w2 = (w + 1) / 2, h2 = (h + 1) / 2;
+  Image result(w2, h2);
+  if (src.empty()) return result;
+
+  // horizontal pass: only the even columns, in units of 1/16
+  std::vector<unsigned short> rows((long) w2 * h * 3);
+  parallelFor(0, h, [&](int rowBegin, int rowEnd) {
+    for (int row = rowBegin; row < rowEnd; row++) {
+      const unsigned char* in = src.row(row);
+      unsigned short* out = &rows[(long) row * w2 * 3];
+      for (int x = 0; x < w2; x++) {
+        const unsigned char* t[5];
+        for (int i = 0; i < 5; i++) {
+          t[i] = in + clampi(2 * x + i - 2, 0, w - 1) * src.pixelStride();
+        }
+        for (int c = 0; c < 3; c++) {
+          out[x * 3 + c] = t[0][c] + 4 * t[1][c] + 6 * t[2][c] + 4 * t[3][c] + t[4][c];
+        }
+      }
+    }
+  }, 16);
+
+  // vertical pass: only the even rows
+  ImageView dst = result.view();
+  const int n = w2 * 3;
+  parallelFor(0, h2, [&](int rowBegin, int rowEnd) {
+    for (int y = rowBegin; y < rowEnd; y++) {
+      const unsigned short* t[5];
+      for (int i = 0; i < 5; i++) {
+        t[i] = &rows[(long) clampi(2 * y + i - 2, 0, h - 1) * n];
+      }
+      unsigned char* out = dst.row(y);
+      for (int i = 0; i < n; i++) {
+        out[i] = (t[0][i] + 4 * t[1][i] + 6 * t[2][i] + 4 * t[3][i] + t[4][i] + 128) >> 8;
+      }
+    }
+  }, 8);
+  return result;
+}
+
+/**
+ * @brief Double a view by interpolation
+ * @param src Source RGB view
+ * @param width Output width
+ * @param height Output height
+ * @return Expanded image
+ *
+ * Even outputs are (1, 6, 1) / 8 of the source sample and its neighbors;
+ * odd outputs are the mean of the two source samples on either side.
+ */
+Image expand(const ConstImageView& src, int width, int height) {
+  Image result(width, height);
+  const int w = src.width(), h = src.height();
+  if (src.empty() || width <= 0 || height <= 0) return result;
+
+  // horizontal pass in units of 1/8
+  std::vector<unsigned short> rows((long) width * h * 3);
+  parallelFor(0, h, [&](int rowBegin, int rowEnd) {
+    for (int row = rowBegin; row < rowEnd; row++) {
+      const unsigned char* in = src.row(row);
+      unsigned short* out = &rows[(long) row * width * 3];
+      for (int x = 0; x < width; x++) {
+        int m = x / 2;
+        const unsigned char* a = in + clampi(m - 1 + (x & 1), 0, w - 1) * src.pixelStride();
+        const unsigned char* b = in + clampi(m, 0, w - 1) * src.pixelStride();
+        const unsigned char* c = in + clampi(m + 1, 0, w - 1) * src.pixelStride();
+        for (int k = 0; k < 3; k++) {
+          out[x * 3 + k] = (x & 1) ? 4 * (b[k] + c[k]) : a[k] + 6 * b[k] + c[k];
+        }
+      }
+    }
+  }, 16);
+
+  ImageView dst = result.view();
+  const int n = width * 3;
+  parallelFor(0, height, [&](int rowBegin, int rowEnd) {
+    for (int y = rowBegin; y < rowEnd; y++) {
+      int m = y / 2;
+      const unsigned short* b = &rows[(long) clampi(m, 0, h - 1) * n];
+      const unsigned short* c = &rows[(long) clampi(m + 1, 0, h - 1) * n];
+      unsigned char* out = dst.row(y);
+      if (y & 1) {
+        for (int i = 0; i < n; i++) out[i] = (4 * (b[i] + c[i]) + 32) >> 6;
+      } else {
+        const unsigned short* a = &rows[(long) clampi(m - 1, 0, h - 1) * n];
+        for (int i = 0; i < n; i++) out[i] = (a[i] + 6 * b[i] + c[i] + 32) >> 6;
+      }
+    }
+  }, 8);
+  return result;
+}
+
+/**
+ * @brief Build every level below the source down to 1 x 1
+ * @param source Source RGB view (level 0, not kept)
+ */
+ImagePyramid::ImagePyramid(const ConstImageView& source) {
+  if (source.width() <= 1 && source.height() <= 1) return;
+  mLevels.push_back(reduce(source));
+  while (mLevels.back().width() > 1 || mLevels.back().height() > 1) {
+    mLevels.push_back(reduce(mLevels.back().view()));
+  }
+}
+
+/**
+ * @brief Find the smallest level that covers the given size
+ * @param width Target width
+ * @param height Target height
+ * @return Level index
+ */
+int ImagePyramid::nearestLevel(int width, int height) const {
+  int i = 0;
+  while (i + 1 < levels() && level(i + 1).width() >= width &&
+         level(i + 1).height() >= height) {
+    i++;
+  }
+  return i;
+}
+
+/**
+ * @brief Split an image and its Gaussian pyramid into band-pass levels
+ * @param image Source image (level 0)
+ */
+LaplacianPyramid::LaplacianPyramid(const Image& image) {
+  std::shared_ptr<const ImagePyramid> gaussian = image.pyramid();
+  mBands.resize(gaussian->levels());
+  for (int i = 0; i < gaussian->levels(); i++) {
+    const Image& level = i == 0 ? image : gaussian->level(i);
+    Band& band = mBands[i];
+    band.width = level.width();
+    band.height = level.height();
+    band.samples.assign(level.data(), level.data() + (long) band.width * band.height * 3);
+    if (i + 1 < gaussian->levels()) {
+      Image up = expand(gaussian->level(i + 1).view(), band.width, band.height);
+      const unsigned char* u = up.data();
+      for (size_t k = 0; k < band.samples.size(); k++) band.samples[k] -= u[k];
+    }
+  }
+}
+
+/**
+ * @brief Rebuild the image by expanding and adding bands from the smallest up
+ * @return Reconstructed image
+ */
+Image LaplacianPyramid::collapse() const {
+  if (mBands.empty()) return Image();
+  const Band& top = mBands.back();
+  Image result(top.width, top.height);
+  for (size_t k = 0; k < top.samples.size(); k++) {
+    result.data()[k] = clampByte(top.samples[k]);
+  }
+  for (int i = levels() - 2; i >= 0; i--) {
+    const Band& band = mBands[i];
+    result = expand(result.view(), band.width, band.height);
+    unsigned char* out = result.data();
+    for (size_t k = 0; k < band.samples.size(); k++) {
+      out[k] = clampByte(out[k] + band.samples[k]);
+    }
+  }
+  return result;
+}
+
+/**
+ * @brief Get the Gaussian pyramid of this image, building it on first use
+ * @return Shared pyramid, valid until the image is modified
+ *
+ * The pyramid is kept with the image until its generation changes, which
+ * every change to the pixels does. Several threads may ask for it at once;
+ * at worst each builds its own and one is kept. Only const calls run
+ * concurrently and they never change the generation, so every pyramid
+ * stored meanwhile is built from the same pixels.
+ */
+std::shared_ptr<const ImagePyramid> Image::pyramid() const {
+  // the generation is stored after the pointer, so read it first
+  bool current = mPyramidGeneration.load() == mGeneration;
+  std::shared_ptr<const ImagePyramid> cached = std::atomic_load(&mPyramid);
+  if (!cached || !current) {
+    cached = std::make_shared<const ImagePyramid>(view());
+    std::atomic_store(&mPyramid, cached);
+    mPyramidGeneration.store(mGeneration);
+  }
+  return cached;
+}
+
+}  // namespace agl
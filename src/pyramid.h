@@ -0,0 +1,100 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the declarations for Gaussian and Laplacian image
+* pyramids.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#ifndef AGL_PYRAMID_H_
+#define AGL_PYRAMID_H_
+
+#include <cassert>
+#include <vector>
+#include "image.h"
+
+namespace agl {
+
+/**
+ * @brief Halve a view with a fused [1 4 6 4 1] / 16 blur and 2x decimation
+ * @param src Source RGB view
+ * @return Image of size ((w + 1) / 2, (h + 1) / 2)
+ *
+ * Only the samples that survive decimation are filtered. Edges repeat the
+ * nearest edge pixel.
+ */
+Image reduce(const ConstImageView& src);
+
+/**
+ * @brief Double a view by interpolating with the [1 4 6 4 1] / 8 kernel
+ * @param src Source RGB view
+ * @param width Output width, 2 * src.width() or one less
+ * @param height Output height, 2 * src.height() or one less
+ * @return Expanded image
+ */
+Image expand(const ConstImageView& src, int width, int height);
+
+/**
+ * @brief Gaussian pyramid: the source followed by successive reduce() levels
+ *
+ * Level 0 is the source itself, which the pyramid does not copy, so only
+ * levels 1 and up can be read from it; the last level is 1 x 1. Images keep
+ * the pyramid of their pixels (see Image::pyramid()), so thumbnails of the
+ * same image share one set of levels.
+ */
+class ImagePyramid {
+ public:
+  explicit ImagePyramid(const ConstImageView& source);
+
+  // Number of levels, counting the source
+  int levels() const { return (int) mLevels.size() + 1; }
+
+  // Level i, for i in [1, levels())
+  const Image& level(int i) const {
+    assert(i >= 1 && i < levels());
+    return mLevels[i - 1];
+  }
+
+  // Smallest level that is still at least width x height (level 0 if none is)
+  int nearestLevel(int width, int height) const;
+
+ private:
+  std::vector<Image> mLevels;
+};
+
+/**
+ * @brief Laplacian pyramid: the band-pass differences between Gaussian levels
+ *
+ * Band i is level i minus expand(level i + 1), kept as signed 16-bit
+ * samples so collapse() reproduces the source exactly. The last band is
+ * the smallest Gaussian level itself.
+ */
+class LaplacianPyramid {
+ public:
+  // Bands of the image and its cached Gaussian pyramid
+  explicit LaplacianPyramid(const Image& image);
+
+  int levels() const { return (int) mBands.size(); }
+  int width(int i) const { return mBands[i].width; }
+  int height(int i) const { return mBands[i].height; }
+
+  // Interleaved RGB samples of band i
+  const std::vector<short>& band(int i) const { return mBands[i].samples; }
+  std::vector<short>& band(int i) { return mBands[i].samples; }
+
+  // Rebuild the image from the smallest band up
+  Image collapse() const;
+
+ private:
+  struct Band {
+    int width;
+    int height;
+    std::vector<short> samples;
+  };
+  std::vector<Band> mBands;
+};
+
+}  // namespace agl
+#endif  // AGL_PYRAMID_H_
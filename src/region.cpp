@@ -0,0 +1,284 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the definitions for regions of interest, and for the
+* Image methods that run an operation inside one.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#include "region.h"
+
+#include <algorithm>
+#include "fixed_point.h"
+#include "image.h"
+#include "parallel.h"
+#include "trace.h"
+
+namespace agl {
+
+namespace {
+
+using fixed::mulDiv255;
+
+/**
+ * @brief Append the parts of a that lie outside b
+ */
+void subtract(const Rect& a, const Rect& b, std::vector<Rect>& out) {
+  Rect overlap = intersect(a, b);
+  if (overlap.empty()) {
+    out.push_back(a);
+    return;
+  }
+  int aBottom = a.y + a.height, oBottom = overlap.y + overlap.height;
+  int aRight = a.x + a.width, oRight = overlap.x + overlap.width;
+  if (overlap.y > a.y) out.push_back(Rect{a.x, a.y, a.width, overlap.y - a.y});
+  if (oBottom < aBottom) out.push_back(Rect{a.x, oBottom, a.width, aBottom - oBottom});
+  if (overlap.x > a.x) out.push_back(Rect{a.x, overlap.y, overlap.x - a.x, overlap.height});
+  if (oRight < aRight) out.push_back(Rect{oRight, overlap.y, aRight - oRight, overlap.height});
+}
+
+/**
+ * @brief Rectangles of the region clipped to the image (and the mask)
+ */
+std::vector<Rect> clippedRects(const Region& region, int width, int height) {
+  Rect bounds = {0, 0, width, height};
+  if (region.hasMask()) {
+    bounds = intersect(bounds, Rect{0, 0, region.maskWidth(), region.maskHeight()});
+  }
+  std::vector<Rect> rects;
+  for (const Rect& rect : region.rects()) {
+    Rect r = intersect(rect, bounds);
+    if (!r.empty()) rects.push_back(r);
+  }
+  return rects;
+}
+
+/**
+ * @brief Call fn(i) for every rectangle, in parallel when there are several
+ *
+ * A single rectangle runs on the calling thread, so the operation inside it
+ * can use the pool itself.
+ */
+void forEachRect(int count, const std::function<void(int)>& fn) {
+  if (count == 1) {
+    fn(0);
+    return;
+  }
+  parallelFor(0, count, [&](int begin, int end) {
+    for (int i = begin; i < end; i++) fn(i);
+  });
+}
+
+/**
+ * @brief dst = original + (result - original) * weight / 255 over one rectangle
+ * @param original Pixels kept where the weight is 0
+ * @param result Pixels taken where the weight is 255
+ * @param dst Output (may alias either input)
+ * @param region Region whose mask gives the weights
+ * @param rect Image rectangle the views cover
+ */
+void blendRegion(const ConstImageView& original, const ConstImageView& result, const ImageView& dst,
+                 const Region& region, const Rect& rect) {
+  for (int row = 0; row < rect.height; row++) {
+    const unsigned char* o = original.row(row);
+    const unsigned char* r = result.row(row);
+    unsigned char* d = dst.row(row);
+    for (int col = 0; col < rect.width; col++) {
+      int w = region.weight(rect.y + row, rect.x + col);
+      for (int c = 0; c < 3; c++) {
+        int a = o[col * original.pixelStride() + c], b = r[col * result.pixelStride() + c];
+        int mixed = w == 255 ? b : w == 0 ? a
+                                          : fixed::addSat(mulDiv255(b, w), mulDiv255(a, 255 - w));
+        d[col * dst.pixelStride() + c] = (unsigned char) mixed;
+      }
+    }
+  }
+}
+
+}  // namespace
+
+Region::Region() : mMaskWidth(0), mMaskHeight(0) {}
+
+Region::Region(const Rect& rect) : mMaskWidth(0), mMaskHeight(0) {
+  add(rect);
+}
+
+Region::Region(const std::vector<Rect>& rects) : mMaskWidth(0), mMaskHeight(0) {
+  for (const Rect& rect : rects) add(rect);
+}
+
+/**
+ * @brief Region weighted by the first channel of a mask
+ * @param mask Mask view, the size of the image it will be applied to
+ * @param blockSize Size of the square blocks the mask is scanned in
+ * @return Region with one rectangle per run of nonzero blocks along a block row
+ *
+ * The mask is copied, so it need not outlive the region. Block rows are
+ * copied and scanned in parallel.
+ */
+Region Region::fromMask(const ConstImageView& mask, int blockSize) {
+  AGL_TRACE_SCOPE("Region::fromMask", (long long) mask.width() * mask.height());
+  Region region;
+  int w = mask.width(), h = mask.height();
+  blockSize = std::max(1, blockSize);
+  region.mMaskWidth = w;
+  region.mMaskHeight = h;
+  region.mMask.resize((size_t) w * h);
+  int columns = (w + blockSize - 1) / blockSize, rows = (h + blockSize - 1) / blockSize;
+  std::vector<std::vector<Rect>> runs(rows);
+  parallelFor(0, rows, [&](int begin, int end) {
+    std::vector<char> occupied(columns);
+    for (int band = begin; band < end; band++) {
+      int y0 = band * blockSize, y1 = std::min(h, y0 + blockSize);
+      std::fill(occupied.begin(), occupied.end(), 0);
+      for (int row = y0; row < y1; row++) {
+        const unsigned char* in = mask.row(row);
+        unsigned char* out = &region.mMask[(size_t) row * w];
+        for (int col = 0; col < w; col++) {
+          out[col] = in[col * mask.pixelStride()];
+          if (out[col]) occupied[col / blockSize] = 1;
+        }
+      }
+      int start = -1;
+      for (int col = 0; col <= columns; col++) {
+        bool set = col < columns && occupied[col];
+        if (set && start < 0) start = col;
+        if (!set && start >= 0) {
+          int x0 = start * blockSize;
+          runs[band].push_back(Rect{x0, y0, std::min(w, col * blockSize) - x0, y1 - y0});
+          start = -1;
+        }
+      }
+    }
+  });
+  for (const std::vector<Rect>& band : runs) {
+    region.mRects.insert(region.mRects.end(), band.begin(), band.end());
+  }
+  return region;
+}
+
+/**
+ * @brief Add a rectangle to the region
+ * @param rect Rectangle to add; the parts already covered are dropped, so
+ * the rectangles of a region never overlap
+ */
+void Region::add(const Rect& rect) {
+  if (rect.empty()) return;
+  std::vector<Rect> pieces(1, rect);
+  for (const Rect& r : mRects) {
+    std::vector<Rect> rest;
+    for (const Rect& piece : pieces) subtract(piece, r, rest);
+    pieces.swap(rest);
+    if (pieces.empty()) return;
+  }
+  mRects.insert(mRects.end(), pieces.begin(), pieces.end());
+}
+
+/**
+ * @brief Get the smallest rectangle holding every rectangle of the region
+ * @return Bounding box, empty for an empty region
+ */
+Rect Region::bounds() const {
+  Rect all = {0, 0, 0, 0};
+  for (const Rect& r : mRects) all = unite(all, r);
+  return all;
+}
+
+/**
+ * @brief Count the pixels covered by the region's rectangles
+ * @return Number of pixels
+ */
+long long Region::area() const {
+  long long total = 0;
+  for (const Rect& r : mRects) total += (long long) r.width * r.height;
+  return total;
+}
+
+/**
+ * @brief Run a pointwise view operation on the pixels of a region only
+ * @param region Pixels to change (see region.h)
+ * @param op Called as op(src, dst) once per rectangle of the region
+ *
+ * Without a mask op runs in place on views of this image (src and dst are
+ * the same view), so pixels outside the region are never touched. With a
+ * mask op writes a scratch image that is mixed back by the mask weights.
+ * Rectangles run in parallel, so op may be called from several threads.
+ */
+void Image::apply(const Region& region, const ViewOp& op) {
+  AGL_TRACE_SCOPE("Image::apply", region.area());
+  std::vector<Rect> rects = clippedRects(region, mWidth, mHeight);
+  ImageView all = rawView();
+  forEachRect((int) rects.size(), [&](int i) {
+    const Rect& r = rects[i];
+    ImageView target = all.subview(r.x, r.y, r.width, r.height);
+    if (!region.hasMask()) {
+      op(target, target);
+      return;
+    }
+    Image result(r.width, r.height);
+    op(target, result.view());
+    blendRegion(target, result.view(), target, region, r);
+  });
+  for (const Rect& r : rects) invalidate(r);
+}
+
+/**
+ * @brief Replace the pixels of a region with the result of an Image operation
+ * @param region Pixels to change (see region.h)
+ * @param op Called once per rectangle on a copy of the rectangle grown by
+ * halo pixels on each side; must return an image of the same size
+ * @param halo Pixels of context op needs around each output pixel, e.g. the
+ * radius of a filter
+ *
+ * With a halo at least as large as the operation's reach, the region matches
+ * the same operation run on the whole image, except for operations that
+ * normalize by image wide statistics (e.g. equalize(), sobel()). Every
+ * rectangle is cut from the original pixels before any are written back.
+ * Rectangles run in parallel, so op may be called from several threads.
+ */
+void Image::apply(const Region& region, const ImageOp& op, int halo) {
+  AGL_TRACE_SCOPE("Image::apply", region.area());
+  std::vector<Rect> rects = clippedRects(region, mWidth, mHeight);
+  ImageView all = rawView();
+  Rect bounds = {0, 0, mWidth, mHeight};
+  std::vector<Rect> context(rects.size());
+  std::vector<Image> results(rects.size());
+  forEachRect((int) rects.size(), [&](int i) {
+    const Rect& r = rects[i];
+    context[i] = intersect(Rect{r.x - halo, r.y - halo, r.width + 2 * halo, r.height + 2 * halo},
+                           bounds);
+    const Rect& c = context[i];
+    results[i] = op(Image(all.subview(c.x, c.y, c.width, c.height)));
+    assert(results[i].width() == c.width && results[i].height() == c.height);
+  });
+  forEachRect((int) rects.size(), [&](int i) {
+    const Rect& r = rects[i];
+    ImageView target = all.subview(r.x, r.y, r.width, r.height);
+    const Image& computed = results[i];
+    ConstImageView result = computed.view().subview(r.x - context[i].x, r.y - context[i].y,
+                                                    r.width, r.height);
+    if (region.hasMask()) {
+      blendRegion(target, result, target, region, r);
+    } else {
+      copy(result, target);
+    }
+  });
+  for (const Rect& r : rects) invalidate(r);
+}
+
+/**
+ * @brief Copy of this image with an operation applied inside a region only
+ * @param region Pixels to change (see region.h)
+ * @param op Image operation (see apply())
+ * @param halo Pixels of context op needs around each output pixel
+ * @return New image; pixels outside the region are copied unchanged
+ */
+Image Image::within(const Region& region, const ImageOp& op, int halo) const {
+  Image result(*this);
+  result.apply(region, op, halo);
+  return result;
+}
+
+}  // namespace agl
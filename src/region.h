@@ -0,0 +1,70 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the declarations for regions of interest, which limit
+* an operation to a list of rectangles or an 8-bit mask.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#ifndef AGL_REGION_H_
+#define AGL_REGION_H_
+
+#include <vector>
+#include "image_view.h"
+
+namespace agl {
+
+/**
+ * @brief The pixels an operation may change (see Image::apply)
+ *
+ * A region is a list of rectangles, optionally weighted by an 8-bit mask
+ * the size of the image: 255 takes the operation's result, 0 keeps the
+ * original pixel and values in between mix the two. A mask region's
+ * rectangles are the blocks of the mask holding a nonzero weight, so work
+ * is skipped wherever the mask is empty. An empty region changes nothing.
+ */
+class Region {
+ public:
+  Region();
+  Region(const Rect& rect);
+  Region(const std::vector<Rect>& rects);
+
+  /**
+   * @brief Region weighted by the first channel of a mask
+   * @param mask Mask view, the size of the image it will be applied to
+   * (copied, so it need not outlive the region)
+   * @param blockSize Size of the square blocks the mask is scanned in
+   */
+  static Region fromMask(const ConstImageView& mask, int blockSize = 32);
+
+  // Add a rectangle (rectangles of a mask region are still weighted by the mask)
+  void add(const Rect& rect);
+
+  const std::vector<Rect>& rects() const { return mRects; }
+  bool empty() const { return mRects.empty(); }
+  bool hasMask() const { return !mMask.empty(); }
+  int maskWidth() const { return mMaskWidth; }
+  int maskHeight() const { return mMaskHeight; }
+
+  // Smallest rectangle holding every rectangle of the region
+  Rect bounds() const;
+
+  // Number of pixels covered by the rectangles (overlaps counted once per rectangle)
+  long long area() const;
+
+  // Mask weight at (row, col), 255 without a mask (unchecked)
+  unsigned char weight(int row, int col) const {
+    return mMask.empty() ? 255 : mMask[(long) row * mMaskWidth + col];
+  }
+
+ private:
+  std::vector<Rect> mRects;
+  std::vector<unsigned char> mMask;
+  int mMaskWidth;
+  int mMaskHeight;
+};
+
+}  // namespace agl
+#endif  // AGL_REGION_H_
@@ -0,0 +1,306 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the definitions for content-aware resizing by seam
+* carving.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#include "seam.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include "parallel.h"
+#include "trace.h"
+
+namespace agl {
+
+namespace {
+
+typedef std::pair<int, int> Span;  // columns [first, second]
+
+/**
+ * @brief Sort spans and merge the ones that overlap or touch
+ */
+void mergeSpans(std::vector<Span>& spans) {
+  std::sort(spans.begin(), spans.end());
+  size_t merged = 0;
+  for (size_t i = 0; i < spans.size(); i++) {
+    if (merged && spans[i].first <= spans[merged - 1].second + 1) {
+      spans[merged - 1].second = std::max(spans[merged - 1].second, spans[i].second);
+    } else {
+      spans[merged++] = spans[i];
+    }
+  }
+  spans.resize(merged);
+}
+
+}  // namespace
+
+SeamCarver::SeamCarver(const ConstImageView& src, bool horizontal)
+    : mHorizontal(horizontal),
+      mWidth(horizontal ? src.height() : src.width()),
+      mHeight(horizontal ? src.width() : src.height()),
+      mStride(mWidth),
+      mPixels((size_t) mWidth * mHeight * 3),
+      mLuma((size_t) mWidth * mHeight),
+      mCost((size_t) mWidth * mHeight),
+      mTaken((size_t) mWidth * mHeight, 0),
+      mPass(0) {
+  parallelFor(0, mHeight, [&](int rowBegin, int rowEnd) {
+    for (int row = rowBegin; row < rowEnd; row++) {
+      unsigned char* pixels = &mPixels[(size_t) row * mStride * 3];
+      unsigned char* luma = &mLuma[(size_t) row * mStride];
+      for (int col = 0; col < mWidth; col++) {
+        const unsigned char* p = mHorizontal ? src.at(col, row) : src.at(row, col);
+        pixels[col * 3] = p[0];
+        pixels[col * 3 + 1] = p[1];
+        pixels[col * 3 + 2] = p[2];
+        luma[col] = (unsigned char) ((77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8);
+      }
+    }
+  }, 16);
+  computeCosts();
+}
+
+int SeamCarver::width() const {
+  return mHorizontal ? mHeight : mWidth;
+}
+
+int SeamCarver::height() const {
+  return mHorizontal ? mWidth : mHeight;
+}
+
+/**
+ * @brief Fused Sobel gradient of the luma at one pixel, edges replicated
+ */
+int SeamCarver::energy(int row, int col) const {
+  int left = std::max(col - 1, 0), right = std::min(col + 1, mWidth - 1);
+  const unsigned char* up = &mLuma[(size_t) std::max(row - 1, 0) * mStride];
+  const unsigned char* mid = &mLuma[(size_t) row * mStride];
+  const unsigned char* down = &mLuma[(size_t) std::min(row + 1, mHeight - 1) * mStride];
+  int gx = (up[right] + 2 * mid[right] + down[right]) - (up[left] + 2 * mid[left] + down[left]);
+  int gy = (down[left] + 2 * down[col] + down[right]) - (up[left] + 2 * up[col] + up[right]);
+  return std::abs(gx) + std::abs(gy);
+}
+
+/**
+ * @brief Cumulative cost of every pixel, top row first
+ */
+void SeamCarver::computeCosts() {
+  for (int row = 0; row < mHeight; row++) {
+    int32_t* cost = &mCost[(size_t) row * mStride];
+    const int32_t* above = row ? cost - mStride : NULL;
+    for (int col = 0; col < mWidth; col++) {
+      int best = 0;
+      if (above) {
+        best = above[col];
+        if (col > 0) best = std::min(best, above[col - 1]);
+        if (col + 1 < mWidth) best = std::min(best, above[col + 1]);
+      }
+      cost[col] = energy(row, col) + best;
+    }
+  }
+}
+
+/**
+ * @brief Trace up to count seams that share no pixels
+ * @return seams[i][row] is the column of seam i in that row
+ *
+ * Seams start from the cheapest bottom pixels and step to the cheapest
+ * untaken pixel above (the leftmost on ties). A seam that runs out of
+ * untaken pixels is dropped, so the first seam is always the optimal one.
+ */
+std::vector<std::vector<int>> SeamCarver::findSeams(int count) {
+  mPass++;
+  const int32_t* bottom = &mCost[(size_t) (mHeight - 1) * mStride];
+  std::vector<int> order(mWidth);
+  for (int col = 0; col < mWidth; col++) order[col] = col;
+  std::sort(order.begin(), order.end(), [bottom](int a, int b) {
+    return bottom[a] < bottom[b] || (bottom[a] == bottom[b] && a < b);
+  });
+
+  std::vector<std::vector<int>> seams;
+  std::vector<int> seam(mHeight);
+  for (int start : order) {
+    if ((int) seams.size() == count) break;
+    if (mTaken[(size_t) (mHeight - 1) * mStride + start] == mPass) continue;
+    int col = start, row = mHeight - 1;
+    bool complete = true;
+    for (;; row--) {
+      mTaken[(size_t) row * mStride + col] = mPass;
+      seam[row] = col;
+      if (row == 0) break;
+      const int32_t* above = &mCost[(size_t) (row - 1) * mStride];
+      const int32_t* aboveTaken = &mTaken[(size_t) (row - 1) * mStride];
+      int next = -1;
+      for (int c = std::max(col - 1, 0); c <= std::min(col + 1, mWidth - 1); c++) {
+        if (aboveTaken[c] != mPass && (next < 0 || above[c] < above[next])) next = c;
+      }
+      if (next < 0) {
+        complete = false;
+        break;
+      }
+      col = next;
+    }
+    if (complete) {
+      seams.push_back(seam);
+    } else {
+      for (int r = row; r < mHeight; r++) mTaken[(size_t) r * mStride + seam[r]] = 0;
+    }
+  }
+  return seams;
+}
+
+/**
+ * @brief Remove seams and update the costs they can affect
+ */
+void SeamCarver::removeSeams(const std::vector<std::vector<int>>& seams) {
+  int count = (int) seams.size();
+  // gaps[row * count + i]: column, after removal, where the i-th removed pixel of the row was
+  std::vector<int> gaps((size_t) mHeight * count);
+  parallelFor(0, mHeight, [&](int rowBegin, int rowEnd) {
+    std::vector<int> cols(count);
+    for (int row = rowBegin; row < rowEnd; row++) {
+      for (int i = 0; i < count; i++) cols[i] = seams[i][row];
+      std::sort(cols.begin(), cols.end());
+      unsigned char* pixels = &mPixels[(size_t) row * mStride * 3];
+      unsigned char* luma = &mLuma[(size_t) row * mStride];
+      int32_t* cost = &mCost[(size_t) row * mStride];
+      for (int i = 0; i < count; i++) {
+        int from = cols[i] + 1, to = i + 1 < count ? cols[i + 1] : mWidth;
+        int at = cols[i] - i;
+        memmove(pixels + at * 3, pixels + from * 3, (size_t) (to - from) * 3);
+        memmove(luma + at, luma + from, to - from);
+        memmove(cost + at, cost + from, (size_t) (to - from) * sizeof(int32_t));
+        gaps[(size_t) row * count + i] = at;
+      }
+    }
+  }, 16);
+  mWidth -= count;
+
+  // a cost can only change near a gap in its own or a neighbouring row, or
+  // beneath a cost that changed in the row above
+  std::vector<Span> changed, candidates, nowChanged;
+  for (int row = 0; row < mHeight; row++) {
+    candidates.clear();
+    for (int r = std::max(row - 1, 0); r <= std::min(row + 1, mHeight - 1); r++) {
+      for (int i = 0; i < count; i++) {
+        int gap = gaps[(size_t) r * count + i];
+        candidates.push_back(Span(gap - 2, gap + 1));
+      }
+    }
+    for (const Span& span : changed) candidates.push_back(Span(span.first - 1, span.second + 1));
+    mergeSpans(candidates);
+
+    nowChanged.clear();
+    int32_t* cost = &mCost[(size_t) row * mStride];
+    const int32_t* above = row ? cost - mStride : NULL;
+    for (const Span& span : candidates) {
+      for (int col = std::max(span.first, 0); col <= std::min(span.second, mWidth - 1); col++) {
+        int best = 0;
+        if (above) {
+          best = above[col];
+          if (col > 0) best = std::min(best, above[col - 1]);
+          if (col + 1 < mWidth) best = std::min(best, above[col + 1]);
+        }
+        int value = energy(row, col) + best;
+        if (value == cost[col]) continue;
+        cost[col] = value;
+        if (!nowChanged.empty() && nowChanged.back().second == col - 1) {
+          nowChanged.back().second = col;
+        } else {
+          nowChanged.push_back(Span(col, col));
+        }
+      }
+    }
+    changed.swap(nowChanged);
+  }
+}
+
+/**
+ * @brief Remove seams
+ * @param count Number of seams (clamped to all but one column or row)
+ * @param seamsPerPass Seams removed between cost updates
+ */
+void SeamCarver::remove(int count, int seamsPerPass) {
+  AGL_TRACE_SCOPE("SeamCarver::remove", (long long) mWidth * mHeight);
+  count = std::min(count, mWidth - 1);
+  seamsPerPass = std::max(seamsPerPass, 1);
+  while (count > 0) {
+    std::vector<std::vector<int>> seams = findSeams(std::min(count, seamsPerPass));
+    removeSeams(seams);
+    count -= (int) seams.size();
+  }
+}
+
+/**
+ * @brief Copy out the carved pixels
+ * @return Image of width() x height()
+ */
+Image SeamCarver::image() const {
+  Image result(width(), height());
+  ImageView out = result.view();
+  parallelFor(0, mHeight, [&](int rowBegin, int rowEnd) {
+    for (int row = rowBegin; row < rowEnd; row++) {
+      const unsigned char* pixels = &mPixels[(size_t) row * mStride * 3];
+      if (!mHorizontal) {
+        memcpy(out.row(row), pixels, (size_t) mWidth * 3);
+        continue;
+      }
+      for (int col = 0; col < mWidth; col++) {
+        unsigned char* p = out.at(col, row);
+        p[0] = pixels[col * 3];
+        p[1] = pixels[col * 3 + 1];
+        p[2] = pixels[col * 3 + 2];
+      }
+    }
+  }, 16);
+  return result;
+}
+
+/**
+ * @brief Resize by removing low energy seams, keeping the salient content
+ * @param width New width
+ * @param height New height
+ * @param seamsPerPass Seams removed between energy updates (see seam.h);
+ * more is faster, one gives the best seams
+ * @return Retargeted image
+ *
+ * Vertical seams are removed first, then horizontal ones. A size larger
+ * than the image in one direction is reached by stretching that direction
+ * alone with resize(); seams are only ever removed.
+ */
+Image Image::seamCarve(int width, int height, int seamsPerPass) const {
+  AGL_TRACE_SCOPE("Image::seamCarve", (long long) mWidth * mHeight);
+  width = std::max(width, 1);
+  height = std::max(height, 1);
+  if (mWidth <= 0 || mHeight <= 0) return *this;
+
+  // only the axes that grow are stretched, so the intermediate is never
+  // larger than the requested size
+  Image result;
+  if (width > mWidth || height > mHeight) {
+    result = resize(std::max(width, mWidth), std::max(height, mHeight));
+  } else {
+    result = *this;
+  }
+  if (result.width() > width) {
+    SeamCarver carver(result.view());
+    carver.remove(result.width() - width, seamsPerPass);
+    result = carver.image();
+  }
+  if (result.height() > height) {
+    SeamCarver carver(result.view(), true);
+    carver.remove(result.height() - height, seamsPerPass);
+    result = carver.image();
+  }
+  return result;
+}
+
+}  // namespace agl
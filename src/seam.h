@@ -0,0 +1,80 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the declarations for content-aware resizing by seam
+* carving.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#ifndef AGL_SEAM_H_
+#define AGL_SEAM_H_
+
+#include <cstdint>
+#include <vector>
+#include "image.h"
+
+namespace agl {
+
+/**
+ * @brief Removes low energy seams from an image one pass at a time
+ *
+ * A vertical seam is an 8-connected path with one pixel per row. The
+ * energy of a pixel is the fused Sobel gradient of the luma, |gx| + |gy|,
+ * computed in one 3 x 3 pass. The cumulative cost of a pixel is its energy
+ * plus the smallest cost of the three pixels above it, found by dynamic
+ * programming. The seam with the lowest cost is traced back from the
+ * bottom row.
+ *
+ * After a pass removes its seams, only the costs that can change are
+ * recomputed. These are the costs within two columns of a removed pixel,
+ * or beneath a cost that changed in the row above. Each row stops
+ * spreading as soon as its recomputed costs match the old ones. The
+ * result is the same as a full recomputation.
+ *
+ * A pass may remove several seams found on the same costs. The extra seams
+ * are traced from the next cheapest bottom pixels and skip pixels already
+ * taken. This trades some seam quality for fewer passes.
+ */
+class SeamCarver {
+ public:
+  /**
+   * @param src Image to carve (copied)
+   * @param horizontal Carve horizontal seams (removing rows) instead of vertical ones
+   */
+  explicit SeamCarver(const ConstImageView& src, bool horizontal = false);
+
+  // Current size of the image
+  int width() const;
+  int height() const;
+
+  /**
+   * @brief Remove seams
+   * @param count Number of seams (at most all but one column or row)
+   * @param seamsPerPass Seams removed between cost updates
+   */
+  void remove(int count, int seamsPerPass = 1);
+
+  // Copy of the current pixels
+  Image image() const;
+
+ private:
+  int energy(int row, int col) const;
+  void computeCosts();
+  std::vector<std::vector<int>> findSeams(int count);
+  void removeSeams(const std::vector<std::vector<int>>& seams);
+
+  bool mHorizontal;
+  int mWidth;   // of the carved (possibly transposed) image
+  int mHeight;
+  int mStride;  // width the buffers were allocated with
+  std::vector<unsigned char> mPixels;
+  std::vector<unsigned char> mLuma;
+  std::vector<int32_t> mCost;
+  std::vector<int32_t> mTaken;  // pass that took each pixel for a seam
+  int mPass;
+};
+
+}  // namespace agl
+#endif  // AGL_SEAM_H_
@@ -0,0 +1,170 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the definitions for frame sequence processing, which
+* skips the tiles of each frame that did not change since the last one.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#include "sequence.h"
+
+#include <cstdio>
+#include <cstring>
+#include "parallel.h"
+#include "trace.h"
+
+namespace agl {
+
+namespace {
+
+inline uint64_t rotl(uint64_t v, int bits) {
+  return (v << bits) | (v >> (64 - bits));
+}
+
+// One round of xxHash64 folding 8 bytes into the state
+inline uint64_t round64(uint64_t state, uint64_t input) {
+  state += input * 0xC2B2AE3D27D4EB4Full;
+  return rotl(state, 31) * 0x9E3779B185EBCA87ull;
+}
+
+/**
+ * @brief File name of frame number n
+ */
+std::string frameName(const std::string& pattern, int n) {
+  std::vector<char> name(pattern.size() + 32);
+  snprintf(name.data(), name.size(), pattern.c_str(), n);
+  return std::string(name.data());
+}
+
+}  // namespace
+
+/**
+ * @brief Hash the samples of a view
+ * @param view View to hash (any stride)
+ * @return 64-bit hash; two views of the same size that differ anywhere
+ * collide with probability about 2^-64
+ *
+ * Rows are read 8 bytes at a time with xxHash64 rounds, then the state is
+ * finished with the SplitMix64 avalanche.
+ */
+uint64_t hashView(const ConstImageView& view) {
+  uint64_t state = 0x27D4EB2F165667C5ull ^ ((uint64_t) view.width() << 32 | view.height());
+  int rowBytes = view.width() * 3;
+  for (int row = 0; row < view.height(); row++) {
+    const unsigned char* p = view.row(row);
+    if (!view.packed()) {
+      for (int col = 0; col < view.width(); col++) {
+        for (int c = 0; c < view.channels(); c++) {
+          state = round64(state, p[col * view.pixelStride() + c]);
+        }
+      }
+      continue;
+    }
+    int i = 0;
+    for (; i + 8 <= rowBytes; i += 8) {
+      uint64_t word;
+      memcpy(&word, p + i, 8);
+      state = round64(state, word);
+    }
+    for (; i < rowBytes; i++) state = round64(state, p[i]);
+  }
+  state = (state ^ (state >> 30)) * 0xBF58476D1CE4E5B9ull;
+  state = (state ^ (state >> 27)) * 0x94D049BB133111EBull;
+  return state ^ (state >> 31);
+}
+
+FrameSequence::FrameSequence(const Builder& build, int tileSize)
+    : mBuild(build), mTileSize(tileSize), mSource(0), mOutput(0),
+      mFrame(std::make_shared<Image>()), mChanged(0) {}
+
+FrameSequence::~FrameSequence() {}
+
+/**
+ * @brief Process the next frame
+ * @param frame Input pixels (copied into the sequence's frame buffer)
+ * @return Output of the graph, valid until the next frame
+ */
+const Image& FrameSequence::process(const Image& frame) {
+  *mFrame = frame;
+  return advance();
+}
+
+/**
+ * @brief Process numbered files
+ * @param inputPattern printf pattern of the input files, e.g. "frame%04d.png"
+ * @param outputPattern printf pattern of the output files
+ * @param first Number of the first frame
+ * @param last Number of the last frame; stops early at the first missing file
+ * @return Number of frames processed
+ */
+int FrameSequence::run(const std::string& inputPattern, const std::string& outputPattern,
+                       int first, int last) {
+  int done = 0;
+  for (int n = first; n <= last; n++) {
+    if (!mFrame->load(frameName(inputPattern, n))) break;
+    advance().save(frameName(outputPattern, n));
+    done++;
+    if (n == INT_MAX) break;
+  }
+  return done;
+}
+
+/**
+ * @brief Forget the previous frame
+ */
+void FrameSequence::reset() {
+  mGraph.reset();
+  mHashes.clear();
+}
+
+/**
+ * @brief Hash the tiles of mFrame, update the graph where they changed and render
+ */
+const Image& FrameSequence::advance() {
+  AGL_TRACE_SCOPE("FrameSequence::advance", (long long) mFrame->width() * mFrame->height());
+  int w = mFrame->width(), h = mFrame->height();
+  int columns = (w + mTileSize - 1) / mTileSize, rows = (h + mTileSize - 1) / mTileSize;
+  std::vector<uint64_t> hashes((size_t) columns * rows);
+  const Image& current = *mFrame;
+  ConstImageView frame = current.view();
+  parallelFor(0, columns * rows, [&](int begin, int end) {
+    for (int t = begin; t < end; t++) {
+      int x = (t % columns) * mTileSize, y = (t / columns) * mTileSize;
+      hashes[t] = hashView(frame.subview(x, y, mTileSize, mTileSize));
+    }
+  });
+
+  if (!mGraph || w != mGraph->width(mSource) || h != mGraph->height(mSource)) {
+    mGraph.reset(new Graph());
+    mSource = mGraph->source(std::shared_ptr<const Image>(mFrame));
+    mOutput = mBuild(*mGraph, mSource);
+    mGraph->setIncremental(true);
+    mChanged = (int) hashes.size();
+  } else {
+    // one rectangle per run of changed tiles along a tile row
+    std::vector<Rect> changed;
+    mChanged = 0;
+    for (int row = 0; row < rows; row++) {
+      int start = -1;
+      for (int col = 0; col <= columns; col++) {
+        int t = row * columns + col;
+        bool differs = col < columns && hashes[t] != mHashes[t];
+        if (differs) mChanged++;
+        if (differs && start < 0) start = col;
+        if (!differs && start >= 0) {
+          changed.push_back(Rect{start * mTileSize, row * mTileSize,
+                                 (col - start) * mTileSize, mTileSize});
+          start = -1;
+        }
+      }
+    }
+    mGraph->update(mSource, mFrame, changed);
+  }
+  mHashes.swap(hashes);
+  mGraph->refresh(std::vector<Graph::Node>(1, mOutput), mTileSize);
+  return mGraph->result(mOutput);
+}
+
+}  // namespace agl
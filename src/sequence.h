@@ -0,0 +1,89 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the declarations for frame sequence processing, which
+* skips the tiles of each frame that did not change since the last one.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#ifndef AGL_SEQUENCE_H_
+#define AGL_SEQUENCE_H_
+
+#include <climits>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "graph.h"
+
+namespace agl {
+
+// 64-bit hash of the samples of a view (e.g. one tile of a frame)
+uint64_t hashView(const ConstImageView& view);
+
+/**
+ * @brief Runs the same operation graph over consecutive frames
+ *
+ * The graph is built once from the first frame and kept incremental (see
+ * Graph::setIncremental). Each new frame is hashed tile by tile; only the
+ * tiles whose hash changed are passed to Graph::update(), so output tiles
+ * that depend on static background alone are reused from the previous
+ * frame. The input frame, the graph and the output keep their buffers from
+ * frame to frame: frames are loaded or copied into one image, and the
+ * output is redrawn in place (see Graph::refresh). A frame of a different
+ * size starts over.
+ */
+class FrameSequence {
+ public:
+  // Build the per-frame graph on a source node and return the output node
+  typedef std::function<Graph::Node(Graph& graph, Graph::Node frame)> Builder;
+
+  /**
+   * @param build Called once per frame size to build the graph
+   * @param tileSize Size of the tiles hashed and rendered
+   */
+  explicit FrameSequence(const Builder& build, int tileSize = 64);
+  ~FrameSequence();
+
+  FrameSequence(const FrameSequence&) = delete;
+  FrameSequence& operator=(const FrameSequence&) = delete;
+
+  // Process the next frame; the result is valid until the next frame
+  const Image& process(const Image& frame);
+
+  /**
+   * @brief Process numbered files
+   * @param inputPattern printf pattern of the input files, e.g. "frame%04d.png"
+   * @param outputPattern printf pattern of the output files
+   * @param first Number of the first frame
+   * @param last Number of the last frame; stops early at the first missing file
+   * @return Number of frames processed
+   */
+  int run(const std::string& inputPattern, const std::string& outputPattern,
+          int first, int last = INT_MAX);
+
+  // Forget the previous frame, so the next one is processed in full
+  void reset();
+
+  // Tiles of the last frame that differed from the frame before, out of tiles()
+  int changedTiles() const { return mChanged; }
+  int tiles() const { return (int) mHashes.size(); }
+
+ private:
+  const Image& advance();
+
+  Builder mBuild;
+  int mTileSize;
+  std::unique_ptr<Graph> mGraph;
+  Graph::Node mSource;
+  Graph::Node mOutput;
+  std::shared_ptr<Image> mFrame;  // read in place by the graph
+  std::vector<uint64_t> mHashes;  // of the previous frame's tiles
+  int mChanged;
+};
+
+}  // namespace agl
+#endif  // AGL_SEQUENCE_H_
@@ -0,0 +1,687 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the definitions for the image server, which runs
+* jobs sent over a Unix domain socket with pixels in shared memory, and
+* for its client.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#include "server.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <csetjmp>
+#include <csignal>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <sstream>
+#include <utility>
+#include <vector>
+#include "image_cache.h"
+#include "trace.h"
+
+namespace agl {
+
+namespace {
+
+#ifdef MSG_NOSIGNAL
+const int kSendFlags = MSG_NOSIGNAL;
+#else
+const int kSendFlags = 0;
+#endif
+
+const size_t kMaxLine = 4096;             // longest request accepted
+const long long kMaxPixels = 1LL << 28;   // largest image a request may make
+const double kMaxArgument = 65535;
+const int kMaxSegments = 32;              // shared memory objects kept mapped
+
+/**
+ * @brief A named operation a request may use
+ *
+ * Every argument must lie in [min, max] before the op runs, so a request
+ * cannot reach the library's own asserts (or divide by zero without them).
+ */
+struct Op {
+  const char* name;
+  int args;
+  const char* usage;
+  double min[3];
+  double max[3];
+  Image (*run)(const Image& in, const double* a);
+};
+
+// smallest sigma or gamma accepted where the library divides by it
+const double kMinPositive = 0.01;
+
+const Op kOps[] = {
+    {"invert", 0, "", {}, {}, [](const Image& in, const double*) { return in.invert(); }},
+    {"grayscale", 0, "", {}, {}, [](const Image& in, const double*) { return in.grayscale(); }},
+    {"fliph", 0, "", {}, {},
+     [](const Image& in, const double*) { return in.flipHorizontal(); }},
+    {"flipv", 0, "", {}, {}, [](const Image& in, const double*) { return in.flipVertical(); }},
+    {"rotate90", 0, "", {}, {}, [](const Image& in, const double*) { return in.rotate90(); }},
+    {"resize", 2, "width height", {1, 1}, {kMaxArgument, kMaxArgument},
+     [](const Image& in, const double* a) { return in.resize((int) a[0], (int) a[1]); }},
+    {"carve", 2, "width height", {1, 1}, {kMaxArgument, kMaxArgument},
+     [](const Image& in, const double* a) { return in.seamCarve((int) a[0], (int) a[1]); }},
+    {"gamma", 1, "gamma", {kMinPositive}, {kMaxArgument},
+     [](const Image& in, const double* a) { return in.gammaCorrect((float) a[0]); }},
+    {"levels", 3, "black white gamma", {0, 0, kMinPositive}, {255, 255, kMaxArgument},
+     [](const Image& in, const double* a) {
+       return in.levels((int) a[0], (int) a[1], (float) a[2]);
+     }},
+    {"autolevels", 0, "", {}, {}, [](const Image& in, const double*) { return in.autoLevels(); }},
+    {"autogamma", 0, "", {}, {}, [](const Image& in, const double*) { return in.autoGamma(); }},
+    {"equalize", 0, "", {}, {}, [](const Image& in, const double*) { return in.equalize(); }},
+    // a lookup table per tile, so tiles is kept small
+    {"clahe", 2, "tiles clip", {1, 0}, {64, kMaxArgument},
+     [](const Image& in, const double* a) { return in.clahe((int) a[0], (float) a[1]); }},
+    {"blur", 1, "sigma", {kMinPositive}, {kMaxArgument},
+     [](const Image& in, const double* a) { return in.gaussianBlur((float) a[0]); }},
+    {"median", 1, "radius", {0}, {kMaxArgument},
+     [](const Image& in, const double* a) { return in.median((int) a[0]); }},
+    {"bilateral", 2, "sigmaSpatial sigmaRange", {kMinPositive, kMinPositive},
+     {kMaxArgument, kMaxArgument},
+     [](const Image& in, const double* a) { return in.bilateral((float) a[0], (float) a[1]); }},
+    {"sobel", 0, "", {}, {}, [](const Image& in, const double*) { return in.sobel(); }},
+    {"erode", 2, "rx ry", {0, 0}, {kMaxArgument, kMaxArgument},
+     [](const Image& in, const double* a) { return in.erode((int) a[0], (int) a[1]); }},
+    {"dilate", 2, "rx ry", {0, 0}, {kMaxArgument, kMaxArgument},
+     [](const Image& in, const double* a) { return in.dilate((int) a[0], (int) a[1]); }},
+    {"open", 2, "rx ry", {0, 0}, {kMaxArgument, kMaxArgument},
+     [](const Image& in, const double* a) { return in.open((int) a[0], (int) a[1]); }},
+    {"close", 2, "rx ry", {0, 0}, {kMaxArgument, kMaxArgument},
+     [](const Image& in, const double* a) { return in.close((int) a[0], (int) a[1]); }},
+    {"jitter", 2, "amount seed", {0, 0}, {255, kMaxArgument}, [](const Image& in, const double* a) {
+       return in.pixelJitter((int) a[0], (uint64_t) a[1]);
+     }},
+    {"grain", 2, "strength seed", {0, 0}, {255, kMaxArgument},
+     [](const Image& in, const double* a) {
+       return in.filmGrain((float) a[0], (uint64_t) a[1]);
+     }},
+    // quantizing needs at least black and white
+    {"dither", 1, "levels", {2}, {256},
+     [](const Image& in, const double* a) { return in.orderedDither((int) a[0]); }},
+    {"floyd", 1, "levels", {2}, {256},
+     [](const Image& in, const double* a) { return in.floydSteinberg((int) a[0]); }},
+};
+
+const Op* findOp(const std::string& name) {
+  for (const Op& op : kOps) {
+    if (name == op.name) return &op;
+  }
+  return NULL;
+}
+
+/**
+ * @brief One op of a request with its arguments
+ */
+struct Step {
+  const Op* op;
+  double args[3];
+};
+
+/**
+ * @brief Find the first step that would allocate an image over kMaxPixels
+ * @param steps Steps of a request
+ * @param width Width of the input
+ * @param height Height of the input
+ * @return The step, or NULL if every image stays in bounds
+ *
+ * Sizes are followed through the steps, so the check covers what each op
+ * allocates rather than its arguments: carve also stretches the input to
+ * the grown size before removing seams.
+ */
+const Step* largeStep(const std::vector<Step>& steps, int width, int height) {
+  for (const Step& step : steps) {
+    long long largest = 0;
+    if (!strcmp(step.op->name, "resize") || !strcmp(step.op->name, "carve")) {
+      int w = (int) step.args[0], h = (int) step.args[1];
+      if (!strcmp(step.op->name, "carve")) {
+        largest = (long long) std::max(w, width) * std::max(h, height);
+      }
+      width = w;
+      height = h;
+    } else if (!strcmp(step.op->name, "rotate90")) {
+      std::swap(width, height);
+    }
+    if (std::max(largest, (long long) width * height) > kMaxPixels) return &step;
+  }
+  return NULL;
+}
+
+/**
+ * @brief Write all of data to a socket
+ */
+bool sendAll(int fd, const std::string& data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t n = send(fd, data.data() + sent, data.size() - sent, kSendFlags);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    sent += n;
+  }
+  return true;
+}
+
+/**
+ * @brief Read from a socket until buffer holds a full line
+ * @return The line without its newline; false on end of stream, error or
+ * a line longer than kMaxLine
+ */
+bool readLine(int fd, std::string& buffer, std::string& line) {
+  char chunk[4096];
+  size_t newline;
+  while ((newline = buffer.find('\n')) == std::string::npos) {
+    if (buffer.size() > kMaxLine) return false;
+    ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    buffer.append(chunk, n);
+  }
+  line = buffer.substr(0, newline);
+  buffer.erase(0, newline + 1);
+  if (!line.empty() && line.back() == '\r') line.pop_back();
+  return true;
+}
+
+/**
+ * @brief Check a POSIX shared memory name: "/" followed by one path component
+ */
+bool validShmName(const std::string& name) {
+  return name.size() > 1 && name.size() < 250 && name[0] == '/' &&
+         name.find('/', 1) == std::string::npos;
+}
+
+bool fillAddress(const std::string& path, sockaddr_un& address) {
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(address.sun_path)) return false;
+  memcpy(address.sun_path, path.c_str(), path.size() + 1);
+  return true;
+}
+
+void noSigPipe(int fd) {
+#ifdef SO_NOSIGPIPE
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#else
+  (void) fd;
+#endif
+}
+
+// where a SIGBUS on this thread resumes, while it copies a client's pages
+thread_local sigjmp_buf* volatile tFault = NULL;
+struct sigaction gPreviousBus;
+
+void onBusError(int signal, siginfo_t* info, void* context) {
+  if (tFault) siglongjmp(*tFault, 1);
+  // not from a guarded copy: hand the fault to whoever handled it before
+  sigaction(SIGBUS, &gPreviousBus, NULL);
+  (void) signal;
+  (void) info;
+  (void) context;
+}
+
+/**
+ * @brief Copy to or from the mapping of a client's shared memory object
+ * @return False if the object shrank under the copy
+ *
+ * The client owns the object and can ftruncate it at any time; touching a
+ * page past its new end raises SIGBUS, which would kill the server and
+ * every other client's jobs. The copy runs with a per-thread jump target
+ * for that signal instead. Only memcpy runs in between, so nothing is left
+ * half done but the destination bytes.
+ */
+bool guardedCopy(void* dst, const void* src, size_t bytes) {
+  static const bool installed = [] {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = onBusError;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+    return sigaction(SIGBUS, &action, &gPreviousBus) == 0;
+  }();
+  (void) installed;
+  sigjmp_buf target;
+  if (sigsetjmp(target, 1)) {
+    tFault = NULL;
+    return false;
+  }
+  tFault = &target;
+  memcpy(dst, src, bytes);
+  tFault = NULL;
+  return true;
+}
+
+}  // namespace
+
+/**
+ * @brief A mapped shared memory object
+ */
+struct ImageServer::Segment {
+  unsigned char* data = NULL;
+  size_t size = 0;
+  dev_t device = 0;
+  ino_t inode = 0;
+
+  ~Segment() {
+    if (data) munmap(data, size);
+  }
+};
+
+ImageServer::ImageServer(const std::string& socketPath)
+    : mPath(socketPath), mListen(-1), mStopping(false), mJobs(0), mNextId(0) {
+  mWake[0] = mWake[1] = -1;
+}
+
+ImageServer::~ImageServer() {
+  stop();
+  if (mListen >= 0) {
+    close(mListen);
+    unlink(mPath.c_str());
+  }
+  if (mWake[0] >= 0) close(mWake[0]);
+  if (mWake[1] >= 0) close(mWake[1]);
+}
+
+/**
+ * @brief Create the socket and start listening
+ * @return False if the socket cannot be created, or another server is
+ * already listening on the path
+ *
+ * A stale socket left by a server that exited without cleaning up is
+ * replaced. The socket is bound with a 0077 umask, so only its owner can
+ * connect.
+ */
+bool ImageServer::start() {
+  sockaddr_un address;
+  if (!fillAddress(mPath, address)) {
+    std::cerr << "Error: socket path \"" << mPath << "\" is too long" << std::endl;
+    return false;
+  }
+  struct stat st;
+  if (lstat(mPath.c_str(), &st) == 0) {
+    if (!S_ISSOCK(st.st_mode)) {
+      std::cerr << "Error: " << mPath << " exists and is not a socket" << std::endl;
+      return false;
+    }
+    ImageClient probe;
+    if (probe.connect(mPath)) {
+      std::cerr << "Error: a server is already listening on " << mPath << std::endl;
+      return false;
+    }
+    unlink(mPath.c_str());
+  }
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    std::cerr << "Error: socket: " << strerror(errno) << std::endl;
+    return false;
+  }
+  mode_t mask = umask(0077);
+  int bound = bind(fd, (const sockaddr*) &address, sizeof(address));
+  umask(mask);
+  if (bound != 0 || listen(fd, SOMAXCONN) != 0 || pipe(mWake) != 0) {
+    std::cerr << "Error: cannot listen on " << mPath << ": " << strerror(errno) << std::endl;
+    close(fd);
+    return false;
+  }
+  mListen = fd;
+  return true;
+}
+
+/**
+ * @brief Accept connections and serve each on its own thread until stop()
+ *
+ * Returns once every connection has been closed and its thread joined.
+ */
+void ImageServer::serve() {
+  if (mListen < 0) return;
+  pollfd fds[2] = {{mListen, POLLIN, 0}, {mWake[0], POLLIN, 0}};
+  while (!mStopping) {
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    if (fds[1].revents) break;
+    if (!(fds[0].revents & POLLIN)) continue;
+    int fd = accept(mListen, NULL, NULL);
+    if (fd < 0) continue;
+    noSigPipe(fd);
+    reap();
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mStopping) {
+      close(fd);
+      break;
+    }
+    long id = mNextId++;
+    mSockets[id] = fd;
+    mConnections[id] = std::thread(&ImageServer::connection, this, fd, id);
+  }
+
+  std::map<long, std::thread> threads;
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (const auto& socket : mSockets) shutdown(socket.second, SHUT_RDWR);
+    threads.swap(mConnections);
+    mFinished.clear();
+  }
+  for (auto& thread : threads) thread.second.join();
+}
+
+/**
+ * @brief Make serve() return; connections are closed after their current job
+ */
+void ImageServer::stop() {
+  bool wasStopping = mStopping.exchange(true);
+  if (wasStopping || mWake[1] < 0) return;
+  char wake = 1;
+  ssize_t written = write(mWake[1], &wake, 1);
+  (void) written;
+  std::lock_guard<std::mutex> lock(mMutex);
+  for (const auto& socket : mSockets) shutdown(socket.second, SHUT_RDWR);
+}
+
+/**
+ * @brief Join the threads of connections that have closed
+ */
+void ImageServer::reap() {
+  std::vector<std::thread> done;
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (long id : mFinished) {
+      auto found = mConnections.find(id);
+      if (found == mConnections.end()) continue;
+      done.push_back(std::move(found->second));
+      mConnections.erase(found);
+    }
+    mFinished.clear();
+  }
+  for (std::thread& thread : done) thread.join();
+}
+
+/**
+ * @brief Serve the requests of one connection until it closes
+ */
+void ImageServer::connection(int fd, long id) {
+  std::string buffer, line;
+  while (!mStopping && readLine(fd, buffer, line)) {
+    if (line.empty()) continue;
+    if (!sendAll(fd, handle(line) + "\n")) break;
+  }
+  if (buffer.size() > kMaxLine) sendAll(fd, "ERR request too long\n");
+  std::lock_guard<std::mutex> lock(mMutex);
+  mSockets.erase(id);
+  close(fd);
+  mFinished.push_back(id);
+}
+
+/**
+ * @brief Map a shared memory object, reusing the mapping of a recent request
+ * @param name Object name ("/name")
+ * @param bytes Bytes needed
+ * @param grow Whether to enlarge a smaller object (for outputs) rather than fail
+ * @return Mapping of at least bytes, or null
+ *
+ * Mappings are kept for the kMaxSegments most recently used names and
+ * replaced when the object was resized or recreated under the same name.
+ */
+std::shared_ptr<ImageServer::Segment> ImageServer::segment(const std::string& name,
+                                                           size_t bytes, bool grow) {
+  if (!validShmName(name)) return NULL;
+  int fd = shm_open(name.c_str(), O_RDWR, 0);
+  if (fd < 0) return NULL;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || ((size_t) st.st_size < bytes &&
+                              (!grow || ftruncate(fd, (off_t) bytes) != 0 || fstat(fd, &st) != 0))) {
+    close(fd);
+    return NULL;
+  }
+  size_t size = (size_t) st.st_size;
+
+  std::lock_guard<std::mutex> lock(mMutex);
+  for (auto it = mSegments.begin(); it != mSegments.end(); ++it) {
+    if (it->first != name) continue;
+    std::shared_ptr<Segment> found = it->second;
+    mSegments.erase(it);
+    if (found->size == size && found->device == st.st_dev && found->inode == st.st_ino) {
+      mSegments.emplace_front(name, found);
+      close(fd);
+      return found;
+    }
+    break;
+  }
+  std::shared_ptr<Segment> mapped;
+  if (size > 0) {
+    void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data != MAP_FAILED) {
+      mapped = std::make_shared<Segment>();
+      mapped->data = (unsigned char*) data;
+      mapped->size = size;
+      mapped->device = st.st_dev;
+      mapped->inode = st.st_ino;
+      mSegments.emplace_front(name, mapped);
+      if ((int) mSegments.size() > kMaxSegments) mSegments.pop_back();
+    }
+  }
+  close(fd);
+  return mapped;
+}
+
+/**
+ * @brief Run one job
+ * @param request Request line (see the class comment)
+ * @return "OK width height", or "ERR" and the reason
+ */
+std::string ImageServer::handle(const std::string& request) {
+  AGL_TRACE_SCOPE("ImageServer::handle", 0);
+  mJobs++;
+  std::istringstream words(request);
+  std::string input, output, word;
+  if (!(words >> input >> output)) return "ERR expected an input and an output";
+
+  std::vector<Step> steps;
+  while (words >> word) {
+    if (word == "|") continue;
+    Step step = {findOp(word), {0, 0, 0}};
+    if (!step.op) return "ERR unknown op " + word;
+    for (int i = 0; i < step.op->args; i++) {
+      double& a = step.args[i];
+      if (!(words >> a)) return "ERR " + word + " expects: " + step.op->usage;
+      if (!std::isfinite(a) || a < step.op->min[i] || a > step.op->max[i]) {
+        std::ostringstream range;
+        range << "ERR argument " << i + 1 << " of " << word << " must be in ["
+              << step.op->min[i] << ", " << step.op->max[i] << "]";
+        return range.str();
+      }
+    }
+    steps.push_back(step);
+  }
+
+  // each connection thread keeps its input buffer from job to job
+  static thread_local Image tInput;
+  std::shared_ptr<const Image> cached;
+  const Image* current = &tInput;
+  try {
+    if (input.compare(0, 4, "shm:") == 0) {
+      size_t colon = input.rfind(':');
+      int width = 0, height = 0;
+      char extra;
+      if (colon <= 4 ||
+          sscanf(input.c_str() + colon + 1, "%dx%d%c", &width, &height, &extra) != 2 ||
+          width < 1 || height < 1 || (long long) width * height > kMaxPixels) {
+        return "ERR bad input " + input;
+      }
+      std::shared_ptr<Segment> in =
+          segment(input.substr(4, colon - 4), (size_t) width * height * 3, false);
+      if (!in) return "ERR cannot map input " + input;
+      if (tInput.width() != width || tInput.height() != height) tInput = Image(width, height);
+      bool copied = guardedCopy(tInput.data(), in->data, (size_t) width * height * 3);
+      tInput.invalidate();
+      if (!copied) return "ERR input " + input + " shrank while being read";
+    } else {
+      cached = ImageCache::global().load(input);
+      if (!cached) return "ERR cannot load " + input;
+      current = cached.get();
+    }
+    const Step* oversized = largeStep(steps, current->width(), current->height());
+    if (oversized) return std::string("ERR bad size for ") + oversized->op->name;
+
+    Image result;
+    for (const Step& step : steps) {
+      result = step.op->run(*current, step.args);
+      current = &result;
+    }
+
+    int width = current->width(), height = current->height();
+    if (output.compare(0, 4, "shm:") == 0) {
+      std::shared_ptr<Segment> out = segment(output.substr(4), (size_t) width * height * 3, true);
+      if (!out) return "ERR cannot map output " + output;
+      if (!guardedCopy(out->data, current->data(), (size_t) width * height * 3)) {
+        return "ERR output " + output + " shrank while being written";
+      }
+    } else if (!current->save(output)) {
+      return "ERR cannot save " + output;
+    }
+    return "OK " + std::to_string(width) + " " + std::to_string(height);
+  } catch (const std::exception& e) {
+    return std::string("ERR ") + e.what();
+  }
+}
+
+/**
+ * @brief List the ops a request may use
+ * @return One "name args..." line per op
+ */
+std::string ImageServer::ops() {
+  std::string list;
+  for (const Op& op : kOps) {
+    list += op.name;
+    if (op.args) list += std::string(" ") + op.usage;
+    list += "\n";
+  }
+  return list;
+}
+
+ImageClient::ImageClient() : mSocket(-1), mData(NULL), mSize(0) {}
+
+ImageClient::~ImageClient() {
+  if (mData) munmap(mData, mSize);
+  if (!mName.empty()) shm_unlink(mName.c_str());
+  if (mSocket >= 0) close(mSocket);
+}
+
+/**
+ * @brief Connect to a server
+ * @param socketPath Path the server listens on
+ * @return False if no server accepts the connection
+ */
+bool ImageClient::connect(const std::string& socketPath) {
+  sockaddr_un address;
+  if (mSocket >= 0 || !fillAddress(socketPath, address)) return false;
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) return false;
+  if (::connect(fd, (const sockaddr*) &address, sizeof(address)) != 0) {
+    close(fd);
+    return false;
+  }
+  noSigPipe(fd);
+  mSocket = fd;
+  return true;
+}
+
+/**
+ * @brief Send one request line and wait for its reply
+ * @param line Request without the newline
+ * @return Reply without the newline, or an ERR reply if the connection failed
+ */
+std::string ImageClient::request(const std::string& line) {
+  std::string reply;
+  if (mSocket < 0 || !sendAll(mSocket, line + "\n") || !readLine(mSocket, mBuffer, reply)) {
+    return "ERR connection lost";
+  }
+  return reply;
+}
+
+/**
+ * @brief Create or remap the client's shared memory object
+ * @param bytes Bytes needed
+ * @param grow Whether to enlarge the object if it is smaller
+ * @return False if the object cannot be created or mapped
+ */
+bool ImageClient::map(size_t bytes, bool grow) {
+  static std::atomic<int> counter(0);
+  int fd;
+  if (mName.empty()) {
+    std::string name = "/agl-" + std::to_string(getpid()) + "-" + std::to_string(counter++);
+    fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0) mName = name;
+  } else {
+    fd = shm_open(mName.c_str(), O_RDWR, 0);
+  }
+  if (fd < 0) return false;
+  struct stat st;
+  bool ok = fstat(fd, &st) == 0;
+  if (ok && grow && (size_t) st.st_size < bytes) {
+    ok = ftruncate(fd, (off_t) bytes) == 0 && fstat(fd, &st) == 0;
+  }
+  if (ok && (size_t) st.st_size != mSize) {
+    if (mData) munmap(mData, mSize);
+    mData = NULL;
+    mSize = 0;
+    if (st.st_size > 0) {
+      void* data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if (data != MAP_FAILED) {
+        mData = (unsigned char*) data;
+        mSize = st.st_size;
+      }
+    }
+  }
+  close(fd);
+  return ok && mSize >= bytes;
+}
+
+/**
+ * @brief Run ops on an image through the server
+ * @param in Input pixels, copied into the client's shared memory object
+ * @param ops Ops as in a request, e.g. "median 2 | resize 200 200"
+ * @param out Result (its buffer is reused when the size is unchanged)
+ * @return False if the server replied with an error (see error())
+ */
+bool ImageClient::run(const Image& in, const std::string& ops, Image& out) {
+  int width = in.width(), height = in.height();
+  if (!map((size_t) width * height * 3, true)) {
+    mError = "ERR cannot create shared memory";
+    return false;
+  }
+  copy(in.view(), ImageView(mData, width, height, width * 3));
+  std::string reply = request("shm:" + mName + ":" + std::to_string(width) + "x" +
+                              std::to_string(height) + " shm:" + mName +
+                              (ops.empty() ? "" : " " + ops));
+  if (sscanf(reply.c_str(), "OK %d %d", &width, &height) != 2 ||
+      !map((size_t) width * height * 3, false)) {
+    mError = reply;
+    return false;
+  }
+  if (out.width() != width || out.height() != height) out = Image(width, height);
+  copy(ImageView(mData, width, height, width * 3), out.view());
+  out.invalidate();
+  return true;
+}
+
+}  // namespace agl
@@ -0,0 +1,147 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the declarations for the image server, which runs
+* jobs sent over a Unix domain socket with pixels in shared memory, and
+* for its client.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#ifndef AGL_SERVER_H_
+#define AGL_SERVER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "image.h"
+
+namespace agl {
+
+/**
+ * @brief Long running image service on a Unix domain socket (POSIX only)
+ *
+ * Each connection sends one job per line and gets one reply line back:
+ *
+ *     request  = input " " output [ " " op { " " arg } { " | " op { " " arg } } ] "\n"
+ *     input    = "shm:" name ":" width "x" height  |  path
+ *     output   = "shm:" name  |  path
+ *     reply    = "OK " width " " height "\n"  |  "ERR " message "\n"
+ *
+ * A shm name is a POSIX shared memory object ("/name") holding packed RGB
+ * rows from offset 0. The result is written back the same way, growing the
+ * output object if it is too small (so input and output may be the same
+ * object). File inputs are decoded through ImageCache::global() and file
+ * outputs saved by extension; paths may not contain spaces. The ops are
+ * listed by ImageServer::ops(), e.g. "median 2 | resize 200 200"; without
+ * ops the input is just decoded or encoded.
+ *
+ * An object truncated by its client while the server copies it fails that
+ * job with an ERR reply. The copies catch the SIGBUS this raises, so the
+ * first shm job installs a SIGBUS handler that passes other faults on to
+ * the handler it replaced.
+ *
+ * The process stays up between jobs, so the thread pool, the decoded image
+ * cache and the mappings of recently used shared memory objects are reused.
+ * Connections are served on their own threads; keep a few open rather than
+ * connecting once per job. The socket is created with owner-only access.
+ */
+class ImageServer {
+ public:
+  explicit ImageServer(const std::string& socketPath);
+
+  // Stops and removes the socket
+  ~ImageServer();
+
+  ImageServer(const ImageServer&) = delete;
+  ImageServer& operator=(const ImageServer&) = delete;
+
+  // Bind and listen on the socket; false (with a message on stderr) on failure
+  bool start();
+
+  // Accept connections until stop() is called
+  void serve();
+
+  // Make serve() return and close every connection (thread-safe)
+  void stop();
+
+  // Run one request line and return its reply line, without the newline
+  std::string handle(const std::string& request);
+
+  // Jobs run so far, including failed ones
+  long jobs() const { return mJobs; }
+
+  // Names and arguments of the supported ops, one per line
+  static std::string ops();
+
+ private:
+  struct Segment;
+
+  void connection(int fd, long id);
+  std::shared_ptr<Segment> segment(const std::string& name, size_t bytes, bool grow);
+  void reap();
+
+  std::string mPath;
+  int mListen;
+  int mWake[2];  // pipe that interrupts serve()
+  std::atomic<bool> mStopping;
+  std::atomic<long> mJobs;
+
+  std::mutex mMutex;
+  std::map<long, std::thread> mConnections;
+  std::map<long, int> mSockets;
+  std::list<long> mFinished;  // connections whose threads can be joined
+  long mNextId;
+  std::list<std::pair<std::string, std::shared_ptr<Segment>>> mSegments;  // most recent first
+};
+
+/**
+ * @brief Sends jobs to an ImageServer through its own shared memory object
+ */
+class ImageClient {
+ public:
+  ImageClient();
+
+  // Closes the connection and removes the shared memory object
+  ~ImageClient();
+
+  ImageClient(const ImageClient&) = delete;
+  ImageClient& operator=(const ImageClient&) = delete;
+
+  // Connect to a server's socket; false on failure
+  bool connect(const std::string& socketPath);
+
+  /**
+   * @brief Run ops on an image
+   * @param in Input pixels, copied into shared memory
+   * @param ops Ops as in a request, e.g. "median 2 | resize 200 200"
+   * @param out Result (its buffer is reused when the size allows)
+   * @return False if the server replied with an error (see error())
+   */
+  bool run(const Image& in, const std::string& ops, Image& out);
+
+  // Send one raw request line and return the reply line
+  std::string request(const std::string& line);
+
+  // Reply of the last failed run()
+  const std::string& error() const { return mError; }
+
+ private:
+  bool map(size_t bytes, bool grow);
+
+  int mSocket;
+  std::string mName;
+  unsigned char* mData;
+  size_t mSize;
+  std::string mBuffer;  // received bytes not yet returned
+  std::string mError;
+};
+
+}  // namespace agl
+#endif  // AGL_SERVER_H_
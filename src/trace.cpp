@@ -0,0 +1,222 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the definitions for operation tracing.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace agl {
+namespace trace {
+
+#ifndef AGL_NO_TRACE
+
+namespace {
+
+struct Event {
+  const char* name;
+  double start;     // microseconds since the first event
+  double duration;  // microseconds
+  long long pixels;
+  long long bytes;
+  int tid;
+};
+
+/**
+ * @brief Events recorded by one thread
+ *
+ * Only its own thread appends, so the mutex is uncontended except while
+ * the trace is being read.
+ */
+struct ThreadLog {
+  int tid;
+  std::mutex mutex;
+  std::vector<Event> events;
+};
+
+/**
+ * @brief Every thread's log, kept after the thread exits
+ *
+ * Never destroyed, so pool threads still running at exit can record safely.
+ */
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::shared_ptr<ThreadLog>> logs;
+  int nextTid = 1;
+};
+
+Registry& registry() {
+  static Registry* instance = new Registry();
+  return *instance;
+}
+
+thread_local std::shared_ptr<ThreadLog> tLog;
+thread_local Scope* tCurrent = NULL;
+
+double now() {
+  typedef std::chrono::steady_clock Clock;
+  static const Clock::time_point epoch = Clock::now();
+  return std::chrono::duration<double, std::micro>(Clock::now() - epoch).count();
+}
+
+ThreadLog& threadLog() {
+  if (!tLog) {
+    tLog = std::make_shared<ThreadLog>();
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    tLog->tid = r.nextTid++;
+    r.logs.push_back(tLog);
+  }
+  return *tLog;
+}
+
+std::vector<Event> snapshot() {
+  std::vector<Event> events;
+  Registry& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  for (const std::shared_ptr<ThreadLog>& log : r.logs) {
+    std::lock_guard<std::mutex> logLock(log->mutex);
+    events.insert(events.end(), log->events.begin(), log->events.end());
+  }
+  return events;
+}
+
+}  // namespace
+
+namespace detail {
+
+std::atomic<bool> gEnabled(false);
+
+void recordAllocation(size_t bytes) {
+  if (tCurrent) tCurrent->addBytes(bytes);
+}
+
+}  // namespace detail
+
+/**
+ * @brief Turn recording on or off
+ * @param enabled New state
+ *
+ * Scopes already open when recording is turned on are not recorded.
+ */
+void setEnabled(bool enabled) {
+  now();  // start the clock
+  detail::gEnabled.store(enabled);
+}
+
+/**
+ * @brief Drop every recorded event
+ */
+void clear() {
+  Registry& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  for (const std::shared_ptr<ThreadLog>& log : r.logs) {
+    std::lock_guard<std::mutex> logLock(log->mutex);
+    log->events.clear();
+  }
+}
+
+void Scope::begin(const char* name, long long pixels) {
+  mName = name;
+  mPixels = pixels;
+  mParent = tCurrent;
+  tCurrent = this;
+  mStart = now();
+}
+
+void Scope::end() {
+  double finish = now();
+  tCurrent = mParent;
+  ThreadLog& log = threadLog();
+  Event event = {mName, mStart, finish - mStart, mPixels, mBytes, log.tid};
+  std::lock_guard<std::mutex> lock(log.mutex);
+  log.events.push_back(event);
+}
+
+#endif  // AGL_NO_TRACE
+
+/**
+ * @brief Write the recorded events in Chrome trace event format
+ * @param filename Destination JSON file
+ * @return true if the file was written
+ */
+bool writeChromeTrace(const std::string& filename) {
+  std::ofstream out(filename.c_str());
+  if (!out) return false;
+  out << "{\"traceEvents\":[";
+#ifndef AGL_NO_TRACE
+  std::vector<Event> events = snapshot();
+  out << std::fixed << std::setprecision(3);
+  for (size_t i = 0; i < events.size(); i++) {
+    const Event& e = events[i];
+    out << (i ? ",\n" : "\n") << "{\"name\":\"" << e.name
+        << "\",\"cat\":\"agl\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.tid
+        << ",\"ts\":" << e.start << ",\"dur\":" << e.duration
+        << ",\"args\":{\"pixels\":" << e.pixels << ",\"bytes\":" << e.bytes << "}}";
+  }
+#endif
+  out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+  return (bool) out;
+}
+
+/**
+ * @brief Total the recorded events by operation name
+ * @return One entry per name, largest total time first
+ */
+std::vector<OpSummary> summary() {
+  std::vector<OpSummary> result;
+#ifndef AGL_NO_TRACE
+  std::map<std::string, OpSummary> byName;
+  for (const Event& e : snapshot()) {
+    OpSummary& op = byName[e.name];
+    op.name = e.name;
+    op.count++;
+    op.totalMs += e.duration / 1000;
+    op.maxMs = std::max(op.maxMs, e.duration / 1000);
+    op.pixels += e.pixels;
+    op.bytes += e.bytes;
+  }
+  for (const auto& entry : byName) result.push_back(entry.second);
+  std::sort(result.begin(), result.end(), [](const OpSummary& a, const OpSummary& b) {
+    return a.totalMs > b.totalMs;
+  });
+#endif
+  return result;
+}
+
+/**
+ * @brief Print the per operation totals
+ * @param out Stream to print to
+ */
+void printSummary(std::ostream& out) {
+  std::ios::fmtflags flags = out.flags();
+  std::streamsize precision = out.precision();
+  out << std::left << std::setw(28) << "operation" << std::right
+      << std::setw(8) << "calls" << std::setw(12) << "total ms" << std::setw(10) << "mean ms"
+      << std::setw(10) << "max ms" << std::setw(10) << "Mpx/s" << std::setw(12) << "MB alloc"
+      << "\n";
+  out << std::fixed << std::setprecision(2);
+  for (const OpSummary& op : summary()) {
+    double rate = op.totalMs > 0 ? op.pixels / (op.totalMs * 1000) : 0;
+    out << std::left << std::setw(28) << op.name << std::right
+        << std::setw(8) << op.count << std::setw(12) << op.totalMs
+        << std::setw(10) << op.totalMs / op.count << std::setw(10) << op.maxMs
+        << std::setw(10) << rate << std::setw(12) << op.bytes / 1e6 << "\n";
+  }
+  out.flags(flags);
+  out.precision(precision);
+}
+
+}  // namespace trace
+}  // namespace agl
@@ -0,0 +1,134 @@
+// Copyright 2021, Aline Normoyle, alinen
+
+/**
+* This file contains the declarations for operation tracing: scoped timers
+* with pixel and allocation counts, Chrome trace export and a summary.
+*
+* @author: Isaac Wasserman
+* @version: October 18, 2026
+*/
+
+#ifndef AGL_TRACE_H_
+#define AGL_TRACE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace agl {
+namespace trace {
+
+/**
+ * @brief Totals for one operation name
+ */
+struct OpSummary {
+  std::string name;
+  long count = 0;
+  double totalMs = 0;
+  double maxMs = 0;
+  long long pixels = 0;
+  long long bytes = 0;
+};
+
+#ifndef AGL_NO_TRACE
+
+namespace detail {
+extern std::atomic<bool> gEnabled;
+void recordAllocation(size_t bytes);
+}  // namespace detail
+
+// Turn recording on or off at runtime (off by default)
+void setEnabled(bool enabled);
+inline bool enabled() { return detail::gEnabled.load(std::memory_order_relaxed); }
+
+// Drop every recorded event
+void clear();
+
+// Count bytes allocated by the innermost open scope on this thread
+inline void recordAllocation(size_t bytes) {
+  if (enabled()) detail::recordAllocation(bytes);
+}
+
+/**
+ * @brief Times the enclosing block as one event
+ *
+ * Records the name, thread, start time, duration, the pixel count given
+ * and the bytes reported through recordAllocation() while the scope is the
+ * innermost one on its thread. When tracing is disabled the constructor
+ * only reads one flag.
+ */
+class Scope {
+ public:
+  // name must outlive the trace (string literals do)
+  Scope(const char* name, long long pixels = 0) : mName(NULL) {
+    if (enabled()) begin(name, pixels);
+  }
+  ~Scope() {
+    if (mName) end();
+  }
+
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+
+  void addBytes(size_t bytes) { mBytes += bytes; }
+
+  // Set the pixel count once it is known (e.g. after decoding a file)
+  void setPixels(long long pixels) { mPixels = pixels; }
+
+ private:
+  void begin(const char* name, long long pixels);
+  void end();
+
+  const char* mName;
+  long long mPixels = 0;
+  long long mBytes = 0;
+  double mStart = 0;
+  Scope* mParent = NULL;
+};
+
+#else  // AGL_NO_TRACE
+
+inline void setEnabled(bool) {}
+inline bool enabled() { return false; }
+inline void clear() {}
+inline void recordAllocation(size_t) {}
+
+class Scope {
+ public:
+  Scope(const char*, long long = 0) {}
+  void addBytes(size_t) {}
+  void setPixels(long long) {}
+};
+
+#endif  // AGL_NO_TRACE
+
+/**
+ * @brief Write the recorded events in Chrome trace event format
+ * @param filename JSON file to write (open with chrome://tracing or Perfetto)
+ * @return false if the file cannot be written
+ */
+bool writeChromeTrace(const std::string& filename);
+
+// Per operation totals, slowest total first
+std::vector<OpSummary> summary();
+
+// Print summary() as a table
+void printSummary(std::ostream& out = std::cout);
+
+}  // namespace trace
+}  // namespace agl
+
+#define AGL_TRACE_CONCAT_(a, b) a##b
+#define AGL_TRACE_CONCAT(a, b) AGL_TRACE_CONCAT_(a, b)
+
+// Time the rest of the enclosing block as an event named name covering pixels pixels
+#ifndef AGL_NO_TRACE
+#define AGL_TRACE_SCOPE(name, pixels) \
+  ::agl::trace::Scope AGL_TRACE_CONCAT(aglTraceScope, __LINE__)(name, pixels)
+#else
+#define AGL_TRACE_SCOPE(name, pixels) do {} while (0)
+#endif
+
+#endif  // AGL_TRACE_H_